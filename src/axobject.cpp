@@ -9,9 +9,16 @@
 #include <QRegExp>
 #include <QDebug>
 #include <QWaitCondition>
+#include <QElapsedTimer>
 
 #include "OleAuto.h"
 
+// request results produced by the caller side of the worker thread
+static const HRESULT AX_E_TIMEOUT = HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+static const HRESULT AX_E_CANCELED = HRESULT_FROM_WIN32(ERROR_CANCELLED);
+static const HRESULT AX_E_POISONED = RPC_E_DISCONNECTED;
+static const HRESULT AX_E_STALE = RPC_E_SERVER_DIED_DNE;
+
 static QList<SAFEARRAY *> safearray_garbage;
 
 
@@ -204,11 +211,13 @@ void AxObject::QVariantList_to_2D_VARIANT(const QVariantList &list, int dimx, in
     HRESULT hr = SafeArrayAccessData(psaData, (void HUGEP * FAR *)&pData);    
     if (SUCCEEDED(hr))
     {        
-        for (int i = 0; i < list.count(); ++i,++pData)
+        // list is row-major, safearray memory is column-major (row index fastest)
+        for (int i = 0; i < list.count(); ++i)
         {            
             if(i >= (dimx*dimy) ) break;
-            ::VariantInit(pData);            
-            QVariant_to_VARIANT(list[i], *pData);            
+            VARIANT *pItem = pData + (i % dimx)*dimy + i / dimx;
+            ::VariantInit(pItem);
+            QVariant_to_VARIANT(list[i], *pItem);
             //pData->vt = VT_BSTR;
             //pData->bstrVal = SysAllocString((const OLECHAR*)l[i].utf16());
         }        
@@ -234,11 +243,13 @@ void AxObject::QStringList_to_2D_VARIANT(const QStringList &list, int dimx, int
     HRESULT hr = SafeArrayAccessData(psaData, (void HUGEP * FAR *)&pData);
     if (SUCCEEDED(hr))
     {
-        for (short i = 0; i < list.count(); ++i,++pData)
+        // list is row-major, safearray memory is column-major (row index fastest)
+        for (int i = 0; i < list.count() && i < dimx*dimy; ++i)
         {
-            ::VariantInit(pData);
-            pData->vt = VT_BSTR;
-            pData->bstrVal = SysAllocString((const OLECHAR*)list[i].utf16());
+            VARIANT *pItem = pData + (i % dimx)*dimy + i / dimx;
+            ::VariantInit(pItem);
+            pItem->vt = VT_BSTR;
+            pItem->bstrVal = SysAllocString((const OLECHAR*)list[i].utf16());
         }
 
         SafeArrayUnaccessData(psaData);
@@ -252,6 +263,26 @@ void AxObject::QStringList_to_2D_VARIANT(const QStringList &list, int dimx, int
 
 
 
+void AxObject::QVector_to_VARIANT(const QVector<double> &vector, VARIANT &arg)
+{
+    SAFEARRAY * psaData = SafeArrayCreateVector(VT_R8, 1, vector.size());
+
+    double HUGEP * pData = NULL;
+    HRESULT hr = SafeArrayAccessData(psaData, (void HUGEP * FAR *)&pData);
+    if (SUCCEEDED(hr))
+    {
+        memcpy(pData, vector.constData(), vector.size()*sizeof(double));
+        SafeArrayUnaccessData(psaData);
+    }
+
+    arg.vt = VT_ARRAY | VT_R8;
+    arg.parray = psaData;
+    safearray_garbage.append(psaData);
+}
+
+
+
+
 void AxObject::clearVARIANT(VARIANT *var)
 {
     if (var->vt & VT_BYREF)
@@ -524,19 +555,62 @@ HRESULT AxObject::AxRequest(int autoType
                             , int cArgs )
 {
 
+    if(mp_cancel && mp_cancel->isCanceled())
+    {
+        m_last_hr = AX_E_CANCELED;
+        return AX_E_CANCELED;
+    }
+    // call which triggered recycle fails as a whole, handles of recycled
+    // server are never used again
+    if(m_replayPending || (pDisp && m_stale.contains((Class)pDisp)))
+    {
+        m_last_hr = AX_E_STALE;
+        return AX_E_STALE;
+    }
+
     if(m_use_thread)
     {
+        // worker still owns Request and Args of the abandoned call
+        if(m_poisoned)
+        {
+            m_last_hr = AX_E_POISONED;
+            return AX_E_POISONED;
+        }
+
         Request.autoType = autoType;
         Request.pvResult = pvResult;
         Request.pDisp  = pDisp;
         Request.name = name;
         Request.cArgs = cArgs;
+
+        QElapsedTimer timer;
+        timer.start();
+        HRESULT hr = 0;
         m_trig = true;
 #ifdef USE_WAITCONDITION
         request.wakeAll();
 #endif
-        while(m_trig);
-        return Request.result;
+        while(m_trig)
+        {
+            if(mp_cancel && mp_cancel->isCanceled()) {
+                hr = AX_E_CANCELED;
+                break;
+            }
+            if(m_timeout > 0 && timer.elapsed() > m_timeout) {
+                hr = AX_E_TIMEOUT;
+                break;
+            }
+        }
+        if(!m_trig) return Request.result;
+
+        m_poisoned = true;
+        callerError(hr, QString("Request %1 %2 after %3 ms")
+                    .arg(name)
+                    .arg(hr == AX_E_TIMEOUT ? "timed out" : "canceled")
+                    .arg(timer.elapsed()));
+        if(m_autoRecycle) recycle();
+        m_last_hr = hr;
+        return hr;
     }
     else
     {
@@ -726,8 +800,164 @@ IDispatch * AxObject::CreateObject(const QString &app_name)
 
 
 
+/****************************************************************************
+    * @function name:  queryServerProcess()
+    * @description: remembers process id of the automation server, used to
+    *               kill a server which does not return from Invoke
+    ****************************************************************************/
+void AxObject::queryServerProcess()
+{
+    m_server_pid = 0;
+    IDispatch *pDisp = (IDispatch *)mp_object;
+    if(!pDisp) return;
+
+    DISPID dispID;
+    LPOLESTR item = (LPOLESTR)L"Hwnd";
+    // not every server has main window, skip silently
+    if(FAILED(pDisp->GetIDsOfNames(IID_NULL, &item, 1, LOCALE_USER_DEFAULT, &dispID))) return;
+
+    DISPPARAMS dp = { NULL, NULL, 0, 0};
+    VARIANT hwnd;
+    VariantInit(&hwnd);
+    if(SUCCEEDED(pDisp->Invoke(dispID, IID_NULL, LOCALE_SYSTEM_DEFAULT, DISPATCH_PROPERTYGET, &dp, &hwnd, NULL, NULL)))
+    {
+        DWORD pid = 0;
+        GetWindowThreadProcessId((HWND)(LONG_PTR)hwnd.lVal, &pid);
+        m_server_pid = pid;
+    }
+    VariantClear(&hwnd);
+}
+
+bool AxObject::serverAlive() const
+{
+    if(mp_object == 0) return false;
+    if(m_server_pid == 0) return true;
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, m_server_pid);
+    if(!process) return false;
+    const bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return alive;
+}
+
+void AxObject::killServer()
+{
+    if(m_server_pid == 0) return;
+    HANDLE process = OpenProcess(PROCESS_TERMINATE, FALSE, m_server_pid);
+    if(process){
+        TerminateProcess(process, 1);
+        CloseHandle(process);
+    }
+    m_server_pid = 0;
+}
+
+
+/****************************************************************************
+    * @function name:  recycle()
+    * @description: Watchdog action for a hung server. Server process is
+    *               killed first, so Invoke of the worker returns with
+    *               RPC_E_SERVER_DIED and the worker leaves its loop. Thread
+    *               is terminated only when it does not finish in time. New
+    *               instance is started then. All object handles become
+    *               invalid and are rejected, owners are notified with queued
+    *               signal_recycled() to rebuild their state once the
+    *               current call has returned.
+    * @return: ( bool) new server is valid
+    ****************************************************************************/
+bool AxObject::recycle()
+{
+    if(!m_use_thread) return false;
+
+    m_finish = true;
+    killServer();
+    // idle worker waits for a request, wake it to see m_finish
+    m_trig = true;
+#ifdef USE_WAITCONDITION
+    request.wakeAll();
+#endif
+    if(!wait(RecycleWait))
+    {
+        // server unknown or not dying, last resort
+        callerError(AX_E_TIMEOUT, "Worker does not finish, terminated");
+        terminate();
+        if(!wait(RecycleWait)) return false;
+    }
+
+    // handles belong to dead server, nothing to Release
+    foreach(Class obj, obj_garbage) m_stale.insert(obj);
+    foreach(Class obj, obj_bagConst) if(obj) m_stale.insert(obj);
+    if(mp_object) m_stale.insert(mp_object);
+    obj_bag.clear();
+    obj_bagConst.clear();
+    obj_garbage.clear();
+    m_shadow.clear();
+    ClearSafeArrayGarbage();
+    CleanUpArgs();
+
+    mp_object = 0;
+    m_poisoned = false;
+    m_state = AxObject::Normal;
+    m_finish = false;
+    m_trig = true;
+    start(QThread::NormalPriority);
+    QElapsedTimer timer;
+    timer.start();
+    while(m_trig)
+    {
+        if(timer.elapsed() > RecycleWait)
+        {
+            callerError(AX_E_TIMEOUT, "New server does not start");
+            return false;
+        }
+    }
+
+    m_recycles++;
+    // owner replays state after the failing call has unwound
+    m_replayPending = true;
+    QMetaObject::invokeMethod(this, "slot_notifyRecycled", Qt::QueuedConnection);
+    return isValid();
+}
+
+void AxObject::slot_notifyRecycled()
+{
+    if(!m_replayPending) return;
+    m_replayPending = false;
+    emit signal_recycled();
+}
+
+void AxObject::setWatchdogInterval(int msec)
+{
+    if(msec > 0 && m_use_thread) m_watchdog.start(msec);
+    else m_watchdog.stop();
+}
+
+/****************************************************************************
+    * @function name:  slot_watchdog()
+    * @description: runs between requests, a poisoned worker or a server
+    *               process which is gone (crashed, closed by user) is
+    *               recycled without waiting for the next call to time out
+    ****************************************************************************/
+void AxObject::slot_watchdog()
+{
+    if(m_trig || m_replayPending) return;
+    if(!m_poisoned && serverAlive()) return;
+    callerError(AX_E_POISONED, "Server does not respond, recycled");
+    recycle();
+}
+
+// errors found in calling thread, blocking signal_error would dead lock
+void AxObject::callerError(HRESULT hr, const QString &text)
+{
+    int op = Normal;
+    const QString message = m_errorInfo + "\n" + "Object :" + m_object_name + "\n" + text;
+    if(m_use_thread) emit signal_callerError(message, &op);
+    else emit signal_error(message, &op);
+    m_last_hr = hr;
+}
+
+
 void AxObject::release()
 { 
+    m_shadow.clear();
     foreach(Class obj_release, obj_garbage){
         while(((IDispatch*)obj_release)->Release()>0);
     }
@@ -790,7 +1020,7 @@ void AxObject::run()
         m_trig = false;
         ClearSafeArrayGarbage();
     }
-    exec();
+    // loop left on m_finish only, thread ends so recycle() can restart it
 }
 
 
@@ -833,6 +1063,20 @@ AxObject::AxObject(const QString &app_name, bool use_thread, bool log_errors)
     m_state = AxObject::Normal;
     m_use_thread = use_thread;
     m_app_name = app_name;
+    m_poisoned = false;
+    m_timeout = 0;
+    m_autoRecycle = false;
+    m_recycles = 0;
+    mp_cancel = 0;
+    m_server_pid = 0;
+    m_last_hr = 0;
+    m_shadowEnabled = true;
+    mp_overlap = 0;
+    m_shadowHits = 0;
+    m_shadowMisses = 0;
+    m_replayPending = false;
+    m_watchdog.setSingleShot(false);
+    connect(&m_watchdog, SIGNAL(timeout()), this, SLOT(slot_watchdog()));
 
     if(use_thread){
         m_trig = true;
@@ -848,7 +1092,9 @@ AxObject::AxObject(const QString &app_name, bool use_thread, bool log_errors)
 AxObject::~AxObject()
 {        
     ClearSafeArrayGarbage();
-    release();
+    // hung server would block on Release as well
+    if(m_poisoned) killServer();
+    else release();
     m_finish = true;
     m_trig = true;
 
@@ -862,6 +1108,7 @@ void AxObject::Start()
 {
     CoInitialize(0);
     mp_object = (Class)CreateObject(m_app_name);    
+    queryServerProcess();
     // check if valid means !=0and add to constatnt table
     obj_bagConst[genSpecialKey("Application",id())] = 0;
 }
@@ -1014,6 +1261,10 @@ bool AxObject::setProperty(Class parent, const QString &prop_path, const QVarian
     if(parent==0) pobj= mp_object;
     else pobj = parent;
 
+    // uncached put makes shadow value stale
+    if(!m_shadow.isEmpty() && m_shadow.contains(pobj))
+        m_shadow[pobj].remove(prop_path);
+
     do{
 
         QStringList l = QString(prop_path).split('.');
@@ -1039,6 +1290,86 @@ bool AxObject::setProperty(Class parent, const QString &prop_path, const QVarian
     return result;
 }
 
+/****************************************************************************
+    * @function name:  setPropertyCached()
+    * @param:
+    *       Class parent - object, 0 - application
+    *       const QString &prop_path - property path relative to parent
+    *       const QVariant &v - value
+    * @description: write-through put. Last value put on (parent,prop_path)
+    *               is kept, equal put is skipped without server round trip.
+    *               Other paths of parent may address the same cells, e.g.
+    *               Range("A1:B2") and Range("A1"), values of paths that
+    *               overlap the put (see setShadowOverlap) are dropped.
+    * @return: (bool) success or skipped
+    ****************************************************************************/
+bool AxObject::setPropertyCached(Class parent, const QString &prop_path, const QVariant &v)
+{
+    if(!m_shadowEnabled) return setProperty(parent, prop_path, v);
+
+    Class pobj = parent ? parent : mp_object;
+    QHash<QString, QVariant> &values = m_shadow[pobj];
+    QHash<QString, QVariant>::const_iterator it = values.constFind(prop_path);
+    if(it != values.constEnd() && it.value() == v)
+    {
+        m_shadowHits++;
+        return true;
+    }
+    m_shadowMisses++;
+
+    bool result = setProperty(pobj, prop_path, v);
+    invalidateShadow(pobj, prop_path);
+    if(result) m_shadow[pobj].insert(prop_path, v);
+    return result;
+}
+
+bool AxObject::shadowOverlaps(const QString &a, const QString &b) const
+{
+    if(mp_overlap) return mp_overlap(a, b);
+    const QString property = a.section('.', -2);
+    return !property.isEmpty() && property == b.section('.', -2);
+}
+
+void AxObject::setShadowEnabled(bool on)
+{
+    m_shadowEnabled = on;
+    if(!on) m_shadow.clear();
+}
+
+void AxObject::invalidateShadow(Class parent)
+{
+    m_shadow.remove(parent ? parent : mp_object);
+}
+
+void AxObject::invalidateShadow(Class parent, const QString &prop_path)
+{
+    QHash<Class, QHash<QString, QVariant> >::iterator values = m_shadow.find(parent ? parent : mp_object);
+    if(values == m_shadow.end()) return;
+    QHash<QString, QVariant>::iterator i = values->begin();
+    while(i != values->end())
+    {
+        if(i.key() == prop_path || shadowOverlaps(i.key(), prop_path)) i = values->erase(i);
+        else ++i;
+    }
+}
+
+void AxObject::clearShadow()
+{
+    m_shadow.clear();
+}
+
+double AxObject::shadowHitRate() const
+{
+    const int total = m_shadowHits + m_shadowMisses;
+    return total ? double(m_shadowHits)/total : 0.0;
+}
+
+void AxObject::resetShadowStats()
+{
+    m_shadowHits = 0;
+    m_shadowMisses = 0;
+}
+
 bool AxObject::property_put_variant(AxObject::Class pobj, const QString &prop, const VARIANT &v)
 {
     bool result = false;
@@ -1107,6 +1438,21 @@ bool AxObject::setPropertyVariant(AxObject::Class pobj, const QString &prop_path
     return result;
 }
 
+bool AxObject::setPropertyBlock(AxObject::Class pobj, const QString &prop_path, const QVariantList &list
+                                , int dimx, int dimy)
+{
+    VARIANT v;
+    QVariantList_to_2D_VARIANT(list, dimx, dimy, v);
+    return setPropertyVariant(pobj, prop_path, v);
+}
+
+bool AxObject::setPropertyVector(AxObject::Class pobj, const QString &prop_path, const QVector<double> &vector)
+{
+    VARIANT v;
+    QVector_to_VARIANT(vector, v);
+    return setPropertyVariant(pobj, prop_path, v);
+}
+
 /****************************************************************************
     * @function name:  AxPropertyPut()
     * @param:
@@ -1332,6 +1678,7 @@ void AxObject::setErrorSlot(QObject *pobj, const char *slot)
     }
     else{
         connect(this, SIGNAL(signal_error(QString,int*)),pobj,slot,Qt::BlockingQueuedConnection);
+        connect(this, SIGNAL(signal_callerError(QString,int*)),pobj,slot,Qt::DirectConnection);
     }
 }
 
@@ -1350,6 +1697,7 @@ void AxObject::releaseObject(const QString &obj_name, AxObject::Class parent_id)
         ((IDispatch*)obj)->Release();
         obj_bag.remove(genSpecialKey(obj_name,parent_id));
         obj_garbage.removeAll(obj);
+        m_shadow.remove(obj);
     }
 }
 
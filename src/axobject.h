@@ -1,19 +1,29 @@
 #ifndef AXOBJECT_H
 #define AXOBJECT_H
 
+#include <QtGlobal>
+// ActiveX is windows only, elsewhere every object is invalid (axobject_none.cpp)
+#ifdef Q_OS_WIN
 //#ifdef RICC
     #include "WinSock2.h"
     #include <Windows.h>
 //#else
 //    #include <Windows.h>
 //#endif
+#endif
 
 
 
 #include <QString>
 #include <QVariant>
+#include <QHash>
+#include <QVector>
+#ifdef Q_OS_WIN
 #include "qaxtypes.h"
+#endif
 #include <QThread>
+#include <QTimer>
+#include <QSet>
 #include <QDebug>
 
 
@@ -21,6 +31,23 @@
 
 
 
+//*********************************************************************
+//                              CLASS
+//
+//          Cancellation token shared between caller and requests
+//*********************************************************************
+class AxCancelToken
+{
+public:
+    AxCancelToken() {m_canceled = false;}
+    void cancel() {m_canceled = true;}
+    void reset() {m_canceled = false;}
+    bool isCanceled() const {return m_canceled;}
+
+private:
+    volatile bool m_canceled;
+};
+
 
 //*********************************************************************
 //                              CLASS
@@ -33,7 +60,10 @@ class AxObject :public QThread
 
 public:
     enum {Normal, Ignore, Abort, Retry};
+    enum {RecycleWait = 5000}; // msec for worker to stop or start in recycle()
     typedef int Class;
+    // shadowed paths a and b may name the same property of the same cells
+    typedef bool (*ShadowOverlap)(const QString &a, const QString &b);
 
 
 
@@ -56,9 +86,32 @@ public:
 
     bool setProperty(Class parent, const QString &prop_path, const QVariant &v);
 
+#ifdef Q_OS_WIN
     bool property_put_variant(Class parent, const QString &prop,const VARIANT &v);
 
     bool setPropertyVariant(Class parent, const QString &prop_path, const VARIANT &v);
+#endif
+    // list is row-major, put as one dimx x dimy array
+    bool setPropertyBlock(Class parent, const QString &prop_path, const QVariantList &list, int dimx, int dimy);
+    // numeric series as one vector of doubles
+    bool setPropertyVector(Class parent, const QString &prop_path, const QVector<double> &vector);
+
+    // put skipped when the value equals the last value put on (parent,prop_path)
+    bool setPropertyCached(Class parent, const QString &prop_path, const QVariant &v);
+    void setShadowEnabled(bool on);
+    bool shadowEnabled() const {return m_shadowEnabled;}
+    /* put on a path drops shadowed paths it overlaps, default compares the
+       last two path segments only */
+    void setShadowOverlap(ShadowOverlap overlap) {mp_overlap = overlap;}
+    // forget values put on object, e.g. sheet was removed
+    void invalidateShadow(Class parent);
+    // forget values of paths overlapping prop_path
+    void invalidateShadow(Class parent, const QString &prop_path);
+    void clearShadow();
+    int shadowHits() const {return m_shadowHits;}
+    int shadowMisses() const {return m_shadowMisses;}
+    double shadowHitRate() const;
+    void resetShadowStats();
 
     bool property_get(Class parent, const QString &prop, QVariant *pvalue);
 
@@ -99,26 +152,56 @@ public:
     void releaseObject(const QString &obj_name, Class parent_id=0 );
     void clearBag();
 
+#ifdef Q_OS_WIN
     void error(HRESULT hr, const QString &text, const QString &object_name =QString());
+#endif
 
     Class findCachedObject(const QString &obj_name,Class parent_id=0) ;
 
     QString name() const { return m_object_name; }
     void run();
 
+#ifdef Q_OS_WIN
     static void QVariant_to_VARIANT(const QVariant &var,VARIANT &arg);    
     static void VARIANT_to_QVariant(const VARIANT &arg,QVariant &var);
     static void clearVARIANT(VARIANT *var);
 
     static void QVariantList_to_2D_VARIANT(const QVariantList &list, int dimx,int dimy, VARIANT &arg);
     static void QStringList_to_2D_VARIANT(const QStringList &list, int dimx, int dimy, VARIANT &arg);
+    // numeric series as one VT_ARRAY|VT_R8 vector
+    static void QVector_to_VARIANT(const QVector<double> &vector, VARIANT &arg);
+#endif
 
     int state() const { return m_state;}
     void finish() {m_finish=1;}
 
+    // request deadline in msec, 0 - wait forever (thread mode only)
+    void setRequestTimeout(int msec) {m_timeout = msec;}
+    int requestTimeout() const {return m_timeout;}
+    // token checked before and during every request, 0 - none
+    void setCancelToken(AxCancelToken *ptoken) {mp_cancel = ptoken;}
+    // restart server automatically when a request times out
+    void setAutoRecycle(bool on) {m_autoRecycle = on;}
+    bool autoRecycle() const {return m_autoRecycle;}
+    // worker thread is stuck inside Invoke, requests are rejected
+    bool isPoisoned() const {return m_poisoned;}
+    /* server is restarted, handles of old server are rejected from now on.
+       signal_recycled() is queued, owners replay their state after the
+       call which triggered recycle has failed */
+    bool recycle();
+    int recycleCount() const {return m_recycles;}
+    // idle check of server process in msec, dead or hung server is recycled, 0 - off
+    void setWatchdogInterval(int msec);
+    int watchdogInterval() const {return m_watchdog.isActive() ? m_watchdog.interval() : 0;}
+#ifdef Q_OS_WIN
+    HRESULT lastResult() const {return m_last_hr;}
+#endif
+
 
 protected:
+#ifdef Q_OS_WIN
     HRESULT m_last_hr;
+#endif
 
     bool m_use_thread;
     QString m_errorInfo;
@@ -126,6 +209,7 @@ protected:
     volatile bool m_finish;
     volatile bool m_trig;
 
+#ifdef Q_OS_WIN
     struct{
         int autoType;
         VARIANT *pvResult;
@@ -139,13 +223,21 @@ protected:
         QString app_name;
         IDispatch *result;
     }Create;
+#endif
 
 signals:
     void signal_error(QString err_text, int *operation);
+    // errors found in caller thread: timeouts, failed recycle
+    void signal_callerError(QString err_text, int *operation);
+    void signal_recycled();
 
-private:
+private slots:
+    void slot_watchdog();
+    void slot_notifyRecycled();
 
+private:
 
+#ifdef Q_OS_WIN
     HRESULT AxRequest_Wk(int autoType
                              , VARIANT *pvResult
                              , IDispatch * pDisp
@@ -153,6 +245,10 @@ private:
                              , int cArgs =0);
 
     IDispatch *CreateObject(const QString &app_name);
+    void queryServerProcess();
+    void killServer();
+    bool serverAlive() const;
+    void callerError(HRESULT hr, const QString &text);
 
 
 
@@ -161,6 +257,7 @@ private:
                              , IDispatch * pDisp
                              , const QString &name
                              , int cArgs =0);
+#endif
 
 
     QString genSpecialKey(const QString &obj_name, int parent_id) const;
@@ -168,6 +265,18 @@ private:
 
     volatile bool m_ignore;
     volatile int m_state;
+    volatile bool m_poisoned;
+
+    int m_timeout;
+    bool m_autoRecycle;
+    int m_recycles;
+    AxCancelToken *mp_cancel;
+#ifdef Q_OS_WIN
+    DWORD m_server_pid;
+#endif
+    QTimer m_watchdog;
+    QSet<Class> m_stale;    // handles of recycled servers
+    volatile bool m_replayPending;  // recycled, owners not notified yet
 
 
     Class mp_object;
@@ -180,13 +289,22 @@ private:
 
     QList<Class> obj_garbage;
 
-    void addToObjectList(Class obj);
-    void CleanUpArgs();
+    // last known property values, parent -> (prop_path -> value)
+    QHash<Class, QHash<QString, QVariant> > m_shadow;
+    bool m_shadowEnabled;
+    ShadowOverlap mp_overlap;
+    int m_shadowHits;
+    int m_shadowMisses;
 
+    bool shadowOverlaps(const QString &a, const QString &b) const;
+    void addToObjectList(Class obj);
 
+#ifdef Q_OS_WIN
+    void CleanUpArgs();
 
     VARIANT res;
     VARIANT Args[10];
+#endif
 };
 
 
@@ -0,0 +1,218 @@
+/**
+ * @file:axobject_none.cpp   -
+ * @description: AxObject on platforms without ActiveX. No server is
+ *               created, the object is invalid and every request fails,
+ *               so Excel builds everywhere and only its xlsx backend works.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#include "axobject.h"
+
+
+AxObject::AxObject(const QString &app_name, bool use_thread, bool log_errors)
+{
+    Q_UNUSED(log_errors);
+    m_state = AxObject::Normal;
+    m_use_thread = use_thread;
+    m_app_name = app_name;
+    m_object_name = app_name;
+    m_finish = true;
+    m_trig = false;
+    m_ignore = false;
+    m_poisoned = false;
+    m_timeout = 0;
+    m_autoRecycle = false;
+    m_recycles = 0;
+    mp_cancel = 0;
+    m_shadowEnabled = true;
+    mp_overlap = 0;
+    m_shadowHits = 0;
+    m_shadowMisses = 0;
+    m_replayPending = false;
+    mp_object = 0;
+}
+
+AxObject::~AxObject()
+{
+}
+
+void AxObject::Start()
+{
+}
+
+void AxObject::run()
+{
+}
+
+AxObject::Class AxObject::queryObject(Class parent, const QString &obj_pathname)
+{
+    Q_UNUSED(obj_pathname);
+    // like a failed path, caller compares with parent
+    return parent;
+}
+
+AxObject::Class AxObject::property_get_class(Class parent, const QString &obj_name)
+{
+    Q_UNUSED(parent); Q_UNUSED(obj_name);
+    return 0;
+}
+
+bool AxObject::property_put(Class parent, const QString &prop, const QVariant &v)
+{
+    Q_UNUSED(parent); Q_UNUSED(prop); Q_UNUSED(v);
+    return false;
+}
+
+bool AxObject::setProperty(Class parent, const QString &prop_path, const QVariant &v)
+{
+    Q_UNUSED(parent); Q_UNUSED(prop_path); Q_UNUSED(v);
+    return false;
+}
+
+bool AxObject::setPropertyBlock(Class parent, const QString &prop_path, const QVariantList &list, int dimx, int dimy)
+{
+    Q_UNUSED(parent); Q_UNUSED(prop_path); Q_UNUSED(list); Q_UNUSED(dimx); Q_UNUSED(dimy);
+    return false;
+}
+
+bool AxObject::setPropertyVector(Class parent, const QString &prop_path, const QVector<double> &vector)
+{
+    Q_UNUSED(parent); Q_UNUSED(prop_path); Q_UNUSED(vector);
+    return false;
+}
+
+// nothing is put, so nothing is shadowed
+bool AxObject::setPropertyCached(Class parent, const QString &prop_path, const QVariant &v)
+{
+    m_shadowMisses++;
+    return setProperty(parent, prop_path, v);
+}
+
+void AxObject::setShadowEnabled(bool on)
+{
+    m_shadowEnabled = on;
+}
+
+void AxObject::invalidateShadow(Class parent)
+{
+    m_shadow.remove(parent);
+}
+
+void AxObject::invalidateShadow(Class parent, const QString &prop_path)
+{
+    Q_UNUSED(prop_path);
+    m_shadow.remove(parent);
+}
+
+void AxObject::clearShadow()
+{
+    m_shadow.clear();
+}
+
+double AxObject::shadowHitRate() const
+{
+    const int total = m_shadowHits + m_shadowMisses;
+    return total ? double(m_shadowHits)/total : 0;
+}
+
+void AxObject::resetShadowStats()
+{
+    m_shadowHits = 0;
+    m_shadowMisses = 0;
+}
+
+bool AxObject::property_get(Class parent, const QString &prop, QVariant *pvalue)
+{
+    Q_UNUSED(parent); Q_UNUSED(prop);
+    if(pvalue) *pvalue = QVariant();
+    return false;
+}
+
+bool AxObject::property(Class parent, const QString &prop_path, QVariant *pvalue)
+{
+    return property_get(parent, prop_path, pvalue);
+}
+
+void AxObject::clearAbort()
+{
+    m_trig = false;
+    m_state = AxObject::Normal;
+}
+
+bool AxObject::method_run(Class parent, const QString &method, QVariant *pres
+                          , const QVariant &, const QVariant &, const QVariant &, const QVariant &
+                          , const QVariant &, const QVariant &, const QVariant &, const QVariant &)
+{
+    Q_UNUSED(parent); Q_UNUSED(method);
+    if(pres) *pres = QVariant();
+    return false;
+}
+
+bool AxObject::dynamicCall(Class parent, const QString &method_path, QVariant *pres
+                           , const QVariant &, const QVariant &, const QVariant &, const QVariant &
+                           , const QVariant &, const QVariant &, const QVariant &, const QVariant &)
+{
+    return method_run(parent, method_path, pres);
+}
+
+AxObject::Class AxObject::object(const QString &obj_name, Class parent_id)
+{
+    Q_UNUSED(obj_name); Q_UNUSED(parent_id);
+    return 0;
+}
+
+bool AxObject::objectExists(const QString &obj_name, Class parent_id)
+{
+    Q_UNUSED(obj_name); Q_UNUSED(parent_id);
+    return false;
+}
+
+void AxObject::setErrorSlot(QObject *pobj, const char *slot)
+{
+    connect(this, SIGNAL(signal_error(QString,int*)), pobj, slot);
+}
+
+void AxObject::release()
+{
+    m_shadow.clear();
+}
+
+void AxObject::assignObject(const QString &obj_name, Class obj, Class parent_id, bool constant)
+{
+    Q_UNUSED(obj_name); Q_UNUSED(obj); Q_UNUSED(parent_id); Q_UNUSED(constant);
+}
+
+void AxObject::releaseObject(const QString &obj_name, Class parent_id)
+{
+    Q_UNUSED(obj_name); Q_UNUSED(parent_id);
+}
+
+void AxObject::clearBag()
+{
+}
+
+AxObject::Class AxObject::findCachedObject(const QString &obj_name, Class parent_id)
+{
+    Q_UNUSED(obj_name); Q_UNUSED(parent_id);
+    return 0;
+}
+
+bool AxObject::recycle()
+{
+    return false;
+}
+
+void AxObject::setWatchdogInterval(int msec)
+{
+    Q_UNUSED(msec);
+}
+
+void AxObject::slot_watchdog()
+{
+}
+
+void AxObject::slot_notifyRecycled()
+{
+}
@@ -14,7 +14,15 @@
 #include <QRgb>
 #include "axobject.h"
 #include "excelenums.h"
+#include "excelrangeset.h"
+#include "excelsheetmodel.h"
+#include "excelupsert.h"
 #include <QLocale>
+#include <QXmlStreamReader>
+#include <QDir>
+#include <QDateTime>
+#include <algorithm>
+#include <cmath>
 
 
 
@@ -30,30 +38,85 @@
  ****************************************************************************/
 Excel::Excel(const QString filename, bool use_thread, bool autosave) :
     QObject(0)
+{
+    init(filename, use_thread, autosave, ComBackend);
+}
+
+Excel::Excel(const QString filename, Backend backend, bool autosave) :
+    QObject(0)
+{
+    init(filename, false, autosave, backend);
+}
+
+void Excel::init(const QString &filename, bool use_thread, bool autosave, Backend backend)
 {
     m_autosave = autosave;
     m_opened = false;
     m_saved = false;
     m_filename = filename;
-    mp_exlObject = new AxObject( "Excel.Application",use_thread,false);
-    if(mp_exlObject->isValid()){
+    mp_xlsx = 0;
+    mp_exlObject = 0;
+    if(backend == XlsxBackend){
+        // no server, methods without xlsx support fail
+        mp_xlsx = new ExcelXlsxWriter(filename);
+    }
+    else mp_exlObject = new AxObject( "Excel.Application",use_thread,false);
+    if(mp_exlObject && mp_exlObject->isValid()){
         mp_exlObject->setProperty( 0,"DisplayAlerts", 1);
         mp_exlObject->setProperty(0,"DisplayStatusBar",0);
         mp_exlObject->setProperty(0,"EnableEvents",0);
     }
+    if(mp_exlObject)
+    {
+        mp_exlObject->setShadowOverlap(&Excel::shadowOverlap);
+        connect(mp_exlObject, SIGNAL(signal_recycled()), this, SLOT(slot_serverRecycled()));
+    }
     mp_currentSheet =0;
     mp_currentWorkBook =0;
     m_badFile = false;
     m_updatesOn = true;
+    m_updatesDepth = 0;
+    m_sheetGeneration = 0;
+    m_replayedRecycles = 0;
+    m_formatBuffered = false;
+    m_framesBuffered = false;
+    m_chartsCreated = 0;
+    m_chartTime = 0;
+    m_postedCount = 0;
+    m_coalescedCount = 0;
+    m_postedWritten = 0;
+    m_readCacheEnabled = false;
+    m_readHits = 0;
+    m_readMisses = 0;
+    m_combineEnabled = false;
+    m_combinedWrites = 0;
+    m_combinedBlocks = 0;
+    m_combineTimer.setSingleShot(true);
+    connect(&m_combineTimer, SIGNAL(timeout()), this, SLOT(slot_flushCombined()));
+    connect(&m_postTimer, SIGNAL(timeout()), this, SLOT(slot_flushPosted()));
+    m_tableTimer.setSingleShot(true);
+    connect(&m_tableTimer, SIGNAL(timeout()), this, SLOT(slot_flushTables()));
+    m_seriesTimer.setSingleShot(true);
+    connect(&m_seriesTimer, SIGNAL(timeout()), this, SLOT(slot_redrawSeries()));
+    m_ringTimer.setSingleShot(true);
+    connect(&m_ringTimer, SIGNAL(timeout()), this, SLOT(slot_flushRings()));
 }
 
 Excel::~Excel()
 {    
-    if(!m_badFile){
+    if(mp_xlsx){
+        close();
+        delete mp_xlsx;
+    }
+    else if(!m_badFile){
         close();
         mp_exlObject->dynamicCall(0,"Workbooks.Close");
         mp_exlObject->method_run(mp_exlObject->id(),"Quit");
     }
+    detachTables(false);
+    foreach(ExcelSheetModel *pmodel, m_models) pmodel->mp_excel = 0;
+    m_models.clear();
+    clearChartTemplates();
     delete mp_exlObject;
 }
 
@@ -71,11 +134,14 @@ bool Excel::validName(const QString &name)
 
 void Excel::setErrorSlot(QObject *pobj, const char *slot)
 {
+    if(!mp_exlObject) return;
     mp_exlObject->setErrorSlot(pobj,slot);
 }
 
 QString Excel::fileName()
 {
+    if(mp_xlsx) return mp_xlsx->fileName();
+    if(m_opened) return workbookInfo().fullName;
     QVariant v;
     if(mp_exlObject->property(this->mp_currentWorkBook, "FullName", &v))
         return v.toString();
@@ -96,10 +162,14 @@ QString Excel::fileName()
  ****************************************************************************/
 bool Excel::open()
 {
+    if(mp_xlsx) return mp_xlsx->open();
     bool result = false;
     QVariant var;
     /* check if opened and file name is empty*/
     if (mp_exlObject != NULL && !m_opened ) {
+        m_styles.clear();
+        clearChartTemplates();
+        invalidateWorkbookInfo();
 
         /* try open workbooks*/
 
@@ -123,18 +193,34 @@ bool Excel::open()
     return result;
 }
 
+/****************************************************************************
+ * @function name: Excel::nextSheetGeneration()
+ * @description: sheets were added, removed or closed; sheet handles may be
+ *               reused by server so cached property values are dropped
+ ****************************************************************************/
+void Excel::nextSheetGeneration()
+{
+    m_sheetGeneration++;
+    if(mp_exlObject) mp_exlObject->clearShadow();
+    m_readGrids.clear();
+    m_conditionRules.clear();
+}
+
 bool Excel::activate()
 {
+    if(!mp_exlObject) return false;
     return mp_exlObject->dynamicCall(0,"ActiveWindow.Activate");
 }
 
 void Excel::release()
 {
+    if(!mp_exlObject) return;
     mp_exlObject->release();
 }
 
 void Excel::clearAbort()
 {
+    if(!mp_exlObject) return;
     mp_exlObject->clearAbort();
 }
 
@@ -146,6 +232,8 @@ bool Excel::isAborted()
 
 bool Excel::isReadOnly()
 {
+    if(m_opened) return workbookInfo().readOnly;
+    if(!mp_exlObject) return false;
     QVariant value;
     mp_exlObject->property(0,"ActiveWorkbook.ReadOnly",&value);
     return value.toBool();
@@ -162,11 +250,13 @@ bool Excel::isReadOnly()
  ****************************************************************************/
 bool Excel::isOpen() const
 {
+    if(mp_xlsx) return mp_xlsx->isOpen();
     return m_opened && mp_exlObject;
 }
 
 bool Excel::setZoom(int val)
 {
+    if(!mp_exlObject) return false;
     return mp_exlObject->setProperty(0,"ActiveWindow.Zoom",val);
 }
 
@@ -185,10 +275,13 @@ int Excel::zoom()
  ****************************************************************************/
 bool Excel::addSheet(const QString &sheetname)
 {
+    if(mp_xlsx) return mp_xlsx->addSheet(sheetname);
     bool result =false;
     if (m_opened)
     {
+        flushSheetBuffers();
         mp_exlObject->clearBag();
+        nextSheetGeneration();
         do{
             QVariant var;
 
@@ -197,6 +290,22 @@ bool Excel::addSheet(const QString &sheetname)
 
             mp_exlObject->assignObject("ActiveSheet", mp_currentSheet);
             if(!mp_exlObject->setProperty(mp_currentSheet, "Name", sheetname)) break;
+            m_sheetname = sheetname;
+
+            // new sheet is inserted into snapshot at its position
+            if(m_info.valid)
+            {
+                SheetInfo sheet;
+                sheet.name = sheetname;
+                sheet.handle = mp_currentSheet;
+                if(mp_exlObject->property(mp_currentSheet, "Index", &var) && var.toInt() > 0
+                        && var.toInt() <= m_info.sheets.count() + 1)
+                {
+                    m_info.sheets.insert(var.toInt() - 1, sheet);
+                    for(int i=0; i<m_info.sheets.count(); i++) m_info.sheets[i].index = i + 1;
+                }
+                else invalidateWorkbookInfo();
+            }
 
             result = true;
         }while(0);
@@ -216,6 +325,7 @@ bool Excel::addSheet(const QString &sheetname)
  ****************************************************************************/
 bool Excel::setCellHint(qint32 row, qint32 col, const QString &text)
 {
+    if(mp_xlsx) return false;
     mp_exlObject->clearBag();
     Excel::Cell cell((int)row-1,(int)col-1);
     QVariant v;
@@ -238,12 +348,15 @@ bool Excel::setCellHint(qint32 row, qint32 col, const QString &text)
  ****************************************************************************/
 bool Excel::setCurrentSheet(const QString &sheetname)
 {
+    if(mp_xlsx) return mp_xlsx->setCurrentSheet(sheetname);
     bool result = false;
     if (m_opened)
     {
+        flushSheetBuffers();
         mp_exlObject->clearBag();
         result = mp_exlObject->dynamicCall(0,QString("Sheets(\"%1\").Activate").arg(sheetname));
         mp_currentSheet = mp_exlObject->object(QString("Sheets(\"%1\")").arg(sheetname));
+        if(result) m_sheetname = sheetname;
     }
     return result;
 }
@@ -292,8 +405,16 @@ bool Excel::removeSheet(const QString &sheetname)
     bool result = false;
     if (m_opened)
     {
+        flushSheetBuffers();
         mp_exlObject->clearBag();
+        nextSheetGeneration();
         result = mp_exlObject->dynamicCall(0,QString("Sheets(\"%1\").Delete").arg(sheetname));
+        if(result && m_info.valid)
+        {
+            const int index = m_info.indexOf(sheetname);
+            if(index >= 0) m_info.sheets.removeAt(index);
+            for(int i=0; i<m_info.sheets.count(); i++) m_info.sheets[i].index = i + 1;
+        }
     }
     return result;
 }
@@ -310,8 +431,16 @@ bool Excel::removeSheet(int sheetnumber)
     bool result = false;
     if (m_opened)
     {
+        flushSheetBuffers();
         mp_exlObject->clearBag();
+        nextSheetGeneration();
         result = mp_exlObject->dynamicCall(0,QString("Sheets(%1).Delete").arg(sheetnumber));
+        if(result && m_info.valid)
+        {
+            if(sheetnumber > 0 && sheetnumber <= m_info.sheets.count())
+                m_info.sheets.removeAt(sheetnumber - 1);
+            for(int i=0; i<m_info.sheets.count(); i++) m_info.sheets[i].index = i + 1;
+        }
     }
     return result;
 }
@@ -324,11 +453,14 @@ bool Excel::removeSheet(int sheetnumber)
  ****************************************************************************/
 bool Excel::save(void)
 {
+    if(mp_xlsx) return mp_xlsx->save();
     bool ok=0;
     if(m_filename.isEmpty()) return false;
+    flushCombined();
     mp_exlObject->clearBag();
     if(!m_saved  ){
         ok = mp_exlObject->dynamicCall(currentWorkBook(),"SaveAs",0, m_filename);
+        if(ok) refreshFileInfo();
     }
     else ok =  mp_exlObject->dynamicCall(currentWorkBook(),"Save");
     if(ok ) m_saved =1;
@@ -337,9 +469,14 @@ bool Excel::save(void)
 
 bool Excel::saveAs(const QString &)
 {    
+    if(mp_xlsx) return mp_xlsx->save();
     bool ok ;
+    flushCombined();
     ok = mp_exlObject->dynamicCall(mp_currentWorkBook,"SaveAs",0, m_filename);
-    if(ok) m_saved = 1;
+    if(ok){
+        m_saved = 1;
+        refreshFileInfo();
+    }
     return m_saved;
 }
 
@@ -361,48 +498,308 @@ bool Excel::write(Excel::Cell cell, const QVariant &data, const QFont &font )
 
 bool Excel::write(const QString &range, const QStringList &l, const QFont &font)
 {    
-    mp_exlObject->clearBag();
+    flushCombined();
+    // plain area goes through value block, FormulaArray only for the rest
+    const Rect rect = Range_To_Rect(range);
+    if(rect.width() > 0 && rect.height() > 0)
+        return writeBlock(rect, l, font);
+
     bool result = false;
     if (m_opened && Range_Is_Valid(range) )
     {
+        mp_exlObject->clearBag();
         result = mp_exlObject->setProperty(mp_currentSheet, QString("Range(\"%1\").FormulaArray").arg(range),l);
+        sheetDataChanged();
 
 
         if(result && font != QFont())
+            putFont(mp_currentSheet, QString("Range(\"%1\")").arg(range), font);
+    }
+    return result;
+}
+
+/****************************************************************************
+ * @function name: Excel::setWriteCombining()
+ * @param:
+ *      bool on
+ *      int flush_msec - held writes are sent after this idle time
+ * @description: write(row,col) calls continuing a row-major or column-major
+ *               sequence are held and sent as block writes
+ ****************************************************************************/
+void Excel::setWriteCombining(bool on, int flush_msec)
+{
+    if(!on) flushCombined();
+    m_combineEnabled = on;
+    m_combineTimer.setInterval(qMax(0, flush_msec));
+}
+
+// cell continues sequence, direction is fixed by second cell, span by first wrap
+bool Excel::WriteCombiner::next(qint32 r, qint32 c)
+{
+    const int n = values.count();
+    if(n == 0) return false;
+    if(direction == None)
+    {
+        if(r == row && c == col + 1) direction = RowMajor;
+        else if(r == row + 1 && c == col) direction = ColumnMajor;
+        else return false;
+        return true;
+    }
+
+    // position along and across direction
+    const int along = direction == RowMajor ? c - col : r - row;
+    const int across = direction == RowMajor ? r - row : c - col;
+    if(span == 0)
+    {
+        if(across == 0 && along == n) return true;
+        if(across == 1 && along == 0) {span = n; return true;}
+        return false;
+    }
+    return across == n/span && along == n%span;
+}
+
+int Excel::WriteCombiner::indexOf(qint32 r, qint32 c) const
+{
+    const int n = values.count();
+    if(n == 0) return -1;
+    if(direction == None) return (r == row && c == col) ? 0 : -1;
+
+    const int along = direction == RowMajor ? c - col : r - row;
+    const int across = direction == RowMajor ? r - row : c - col;
+    if(along < 0 || across < 0) return -1;
+    if(span == 0) return (across == 0 && along < n) ? along : -1;
+    if(along >= span) return -1;
+    const int index = across*span + along;
+    return index < n ? index : -1;
+}
+
+bool Excel::combineWrite(qint32 row, qint32 col, const QVariant &data)
+{
+    bool result = true;
+    if(!m_combiner.next(row, col))
+    {
+        if(!m_combiner.values.isEmpty()) result = flushCombined();
+        m_combiner.row = row;
+        m_combiner.col = col;
+    }
+    m_combiner.values.append(data);
+    m_combinedWrites++;
+    m_combineTimer.start();
+    return result;
+}
+
+/****************************************************************************
+ * @function name: Excel::flushCombined()
+ * @description: held writes are sent as one block of full rows (columns)
+ *               and one block of incomplete last row (column)
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool Excel::flushCombined()
+{
+    if(m_combiner.values.isEmpty()) return true;
+    m_combineTimer.stop();
+    // taken out first, block writes below flush too
+    const WriteCombiner held = m_combiner;
+    m_combiner = WriteCombiner();
+
+    const int n = held.values.count();
+    const bool columns = held.direction == WriteCombiner::ColumnMajor;
+    const int span = held.span ? held.span : n;
+    const int full = n/span;
+    const int rest = n%span;
+    const int x = held.col - 1;
+    const int y = held.row - 1;
+
+    bool result = true;
+    if(columns)
+    {
+        // SetDataToRange takes row-major list
+        QVariantList block;
+        block.reserve(full*span);
+        for(int r=0; r<span; r++)
+            for(int c=0; c<full; c++)
+                block.append(held.values[c*span + r]);
+        result &= SetDataToRange(Rect(x, y, full, span), block);
+        if(rest) result &= SetDataToRange(Rect(x + full, y, 1, rest), held.values.mid(full*span));
+    }
+    else
+    {
+        result &= SetDataToRange(Rect(x, y, span, full), held.values.mid(0, full*span));
+        if(rest) result &= SetDataToRange(Rect(x, y + full, rest, 1), held.values.mid(full*span));
+    }
+    m_combinedBlocks += rest ? 2 : 1;
+    return result;
+}
+
+void Excel::slot_flushCombined()
+{
+    flushCombined();
+}
+
+/****************************************************************************
+ * @function name: Excel::writeBlock()
+ * @param:
+ *    const Rect &rect - target area
+ *    const QStringList &texts - row-major values, missing are empty
+ *    const QFont &font
+ * @description: texts are converted to numbers where text is the number
+ *               as excel shows it and sent as one 2D Value2 array, font is
+ *               applied once to whole area. Other numeric texts ("007",
+ *               "1.50") stay texts
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool Excel::writeBlock(const Rect &rect, const QStringList &texts, const QFont &font)
+{
+    flushCombined();
+    if(!isOpen() || rect.width() <= 0 || rect.height() <= 0) return false;
+    dropPosted(rect);
+
+    const int count = rect.width()*rect.height();
+    QVariantList data;
+    for(int i=0; i<count; i++)
+        data.append(i < texts.count() ? typedValue(texts[i], !mp_xlsx) : QVariant(QString("")));
+
+    if(mp_xlsx){
+        const QRect cells(rect.x(), rect.y(), rect.width(), rect.height());
+        bool result = mp_xlsx->writeBlock(cells, data);
+        if(result && font != QFont()) result = mp_xlsx->setFont(cells, font);
+        return result;
+    }
+
+    mp_exlObject->clearBag();
+    bool result = mp_exlObject->setPropertyBlock(currentSheet(),
+                                                 QString("Range(\"%1\").Value2").arg(rect.toRange())
+                                                 , data, rect.width(), rect.height());
+    sheetDataChanged(QString(), rect);
+    if(result && font != QFont())
+    {
+        CellStyle style;
+        style.setFont(font);
+        applyStyle(rect, style);
+    }
+    return result;
+}
+
+// numeric text is a number unless the number loses it: leading zeros like
+// "007" or more than 15 significant digits. Excel parses put texts as well,
+// so kept numeric texts get apostrophe prefix when quote is set
+QVariant Excel::typedValue(const QString &text, bool quote)
+{
+    bool ok = false;
+    const double value = QLocale::c().toDouble(text, &ok);
+    if(!ok || !qIsFinite(value)) return text;
+
+    int i = 0;
+    const int n = text.size();
+    if(i < n && (text[i] == QLatin1Char('+') || text[i] == QLatin1Char('-'))) i++;
+    const bool leading_zero = i + 1 < n && text[i] == QLatin1Char('0') && text[i+1].isDigit();
+    // significant digits of mantissa, leading and trailing zeros are not
+    int first = -1, last = -1, count = 0;
+    for(; i < n && text[i] != QLatin1Char('e') && text[i] != QLatin1Char('E'); i++)
+    {
+        if(!text[i].isDigit()) continue;
+        if(text[i] != QLatin1Char('0'))
         {
-            mp_exlObject->setProperty(mp_currentSheet, QString("Range(\"%1\").Font.Name").arg(range), font.family());
-            if(font.pointSize()>0)
-                mp_exlObject->setProperty(mp_currentSheet, QString("Range(\"%1\").Font.Size").arg(range), font.pointSize());
-            mp_exlObject->setProperty(mp_currentSheet, QString("Range(\"%1\").Font.Bold").arg(range), font.bold());
-            mp_exlObject->setProperty(mp_currentSheet, QString("Range(\"%1\").Font.Italic").arg(range), font.italic());
+            if(first < 0) first = count;
+            last = count;
         }
+        count++;
     }
-    return result;
+    if(!leading_zero && (first < 0 || last - first < 15)) return value;
+    return quote ? QString("'") + text : text;
 }
 
 bool Excel::mergeRange(const QString &range,bool on)
 {
+    if(mp_xlsx){
+        const Rect rect = Range_To_Rect(range);
+        return on && mp_xlsx->mergeCells(QRect(rect.x(), rect.y(), rect.width(), rect.height()));
+    }
     if(m_opened && Range_Is_Valid(range)){
+        // merge drops values of covered cells, held writes go first
+        flushCombined();
+        sheetDataChanged(QString(), Range_To_Rect(range));
         return mp_exlObject->setProperty(mp_currentSheet, QString("Range(\"%1\").MergeCells").arg(range), on);
     }
     return false;
 }
 
+bool Excel::mergeRange(const QList<Rect> &rects, bool on)
+{
+    if(!isOpen()) return false;
+    bool result = true;
+    if(mp_xlsx){
+        foreach(const Rect &rect, rects)
+            result &= mergeRange(rect.toRange(), on);
+        return result;
+    }
+    // areas of multi-area range are merged each on its own
+    foreach(const QString &range, Rects_To_Ranges(rects))
+        result &= mergeRange(range, on);
+    return result;
+}
+
+bool Excel::mergeRange(const ExcelRangeSet &cells, bool on)
+{
+    return mergeRange(cells.rects(), on);
+}
+
+/****************************************************************************
+ * @function name: Excel::clearRange()
+ * @param:
+ *    const ExcelRangeSet &cells
+ *    bool contents_only - values only, formats are kept
+ * @description: one call per multi-area range of set
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool Excel::clearRange(const ExcelRangeSet &cells, bool contents_only)
+{
+    if(!m_opened) return false;
+    // held writes land before clear, not over it
+    flushCombined();
+    foreach(const Rect &rect, cells.rects()) dropPosted(rect);
+    mp_exlObject->clearBag();
+    bool result = true;
+    foreach(const QString &range, cells.toRanges())
+    {
+        // cleared formats drop cached fonts of these cells only
+        if(!contents_only) mp_exlObject->invalidateShadow(currentSheet(), QString("Range(\"%1\")").arg(range));
+        result &= mp_exlObject->dynamicCall(currentSheet(), QString("Range(\"%1\").%2")
+                                            .arg(range).arg(contents_only ? "ClearContents" : "Clear"));
+    }
+    sheetDataChanged(QString(), cells.boundingRect());
+    return result;
+}
+
 
 bool Excel::write(qint32 row, qint32 col, const QVariant &data, const QFont &font)
 {
+    if(row > 0 && col > 0) dropPosted(Rect(col - 1, row - 1, 1, 1));
+    if(mp_xlsx){
+        bool result = mp_xlsx->write(row, col, data);
+        if(result && font != QFont()) result = mp_xlsx->setFont(QRect(col - 1, row - 1, 1, 1), font);
+        return result;
+    }
+    if(m_combineEnabled && m_opened && row > 0 && col > 0 && font == QFont())
+        return combineWrite(row, col, data);
+    flushCombined();
+
     mp_exlObject->clearBag();
     bool result = false;
     if (m_opened && row > 0 && col > 0 )
     {
         result = mp_exlObject->setProperty(mp_currentSheet, QString("Cells(%1,%2).Value").arg(row).arg(col),data);
+        // formulas depending on the cell are recalculated, grid is stale
+        sheetDataChanged(QString(), Rect(col - 1, row - 1, 1, 1));
+
         if(result && font != QFont())
         {
-            mp_exlObject->setProperty(mp_currentSheet, QString("Cells(%1,%2).Font.Name").arg(row).arg(col), font.family());
-            if(font.pointSize()>0)
-                mp_exlObject->setProperty(mp_currentSheet, QString("Cells(%1,%2).Font.Size").arg(row).arg(col), font.pointSize());
-            mp_exlObject->setProperty(mp_currentSheet, QString("Cells(%1,%2).Font.Bold").arg(row).arg(col), font.bold());
-            mp_exlObject->setProperty(mp_currentSheet, QString("Cells(%1,%2).Font.Italic").arg(row).arg(col), font.italic());
+            if(m_formatBuffered){
+                CellStyle style;
+                style.setFont(font);
+                setCellStyle(row, col, style);
+            }
+            else putFont(mp_currentSheet, QString("Cells(%1,%2)").arg(row).arg(col), font);
         }
     }
     return result;
@@ -411,28 +808,132 @@ bool Excel::write(qint32 row, qint32 col, const QVariant &data, const QFont &fon
 
 bool Excel::write(AxObject::Class range, qint32 row, qint32 col, const QVariant &data, const QFont &font)
 {
-    mp_exlObject->clearBag();
+    flushCombined();
     bool result = false;
     if (m_opened && row > 0 && col > 0 )
     {
+        mp_exlObject->clearBag();
         int retry=5;        
         while(!result && retry--)
             result = mp_exlObject->setProperty(range, QString("Cells(%1,%2).Value").arg(row).arg(col),data);
+        sheetDataChanged();
 
         if(result && font != QFont())
         {
-            mp_exlObject->setProperty( range,QString("Cells(%1,%2).Font.Name").arg(row).arg(col), font.family());
-            if(font.pointSize()>0)
-                mp_exlObject->setProperty(range, QString("Cells(%1,%2).Font.Size").arg(row).arg(col), font.pointSize());
-            mp_exlObject->setProperty(range, QString("Cells(%1,%2).Font.Bold").arg(row).arg(col), font.bold());
-            mp_exlObject->setProperty(range, QString("Cells(%1,%2).Font.Italic").arg(row).arg(col), font.italic());
+            // range handle belongs to any sheet, its cells are unknown here
+            putFont(range, QString("Cells(%1,%2)").arg(row).arg(col), font, false);
+            mp_exlObject->clearShadow();
         }
     }
     return result;
 }
 
+/****************************************************************************
+ * @function name: Excel::putFont()
+ * @param:
+ *    AxObject::Class parent - sheet or range object
+ *    const QString &path - "Cells(r,c)" or "Range(...)" relative to parent
+ *    const QFont &font
+ *    bool cached - parent is a sheet, puts go through property shadow
+ * @description: unchanged font attributes of a sheet path are not sent
+ *               again, puts drop shadowed fonts of overlapping paths only
+ *               (see shadowOverlap). Puts through range handles are sent
+ *               directly, caller drops sheet fonts they cover.
+ ****************************************************************************/
+void Excel::putFont(AxObject::Class parent, const QString &path, const QFont &font, bool cached)
+{
+    bool (AxObject::*put)(AxObject::Class, const QString &, const QVariant &)
+            = cached ? &AxObject::setPropertyCached : &AxObject::setProperty;
+    (mp_exlObject->*put)(parent, path + ".Font.Name", font.family());
+    if(font.pointSize()>0)
+        (mp_exlObject->*put)(parent, path + ".Font.Size", font.pointSize());
+    (mp_exlObject->*put)(parent, path + ".Font.Bold", font.bold());
+    (mp_exlObject->*put)(parent, path + ".Font.Italic", font.italic());
+}
+
+// splits shadow path "Range(\"A1\").Font.Name" to object and property part,
+// object is empty for application properties like "EnableEvents"
+static void splitShadowPath(const QString &path, QString *pobject, QString *pproperty)
+{
+    int end = -1;
+    if(path.startsWith(QLatin1String("Cells("))) end = path.indexOf(QLatin1Char(')')) + 1;
+    else if(path.startsWith(QLatin1String("Range(\""))) end = path.indexOf(QLatin1String("\")"), 7) + 2;
+    if(end <= 0)
+    {
+        *pobject = QString();
+        *pproperty = path;
+        return;
+    }
+    *pobject = path.left(end);
+    *pproperty = path.mid(end + 1);
+}
+
+// areas of Cells(r,c) or Range("...") object part, -1 when unknown
+static int shadowAreas(const QString &object, ExcelAddress::Area *pareas, int max_areas)
+{
+    if(object.startsWith(QLatin1String("Cells(")))
+    {
+        const QStringList rc = object.mid(6, object.size() - 7).split(QLatin1Char(','));
+        bool ok_row = false, ok_col = false;
+        if(rc.size() != 2 || max_areas < 1) return -1;
+        pareas[0].first.row = rc[0].trimmed().toInt(&ok_row) - 1;
+        pareas[0].first.col = rc[1].trimmed().toInt(&ok_col) - 1;
+        if(!ok_row || !ok_col) return -1;
+        pareas[0].last = pareas[0].first;
+        return 1;
+    }
+    const int count = ExcelAddress::parseRange(object.mid(7, object.size() - 9), pareas, max_areas);
+    return count > 0 && count <= max_areas ? count : -1;
+}
+
+static bool shadowPropertiesOverlap(const QString &a, const QString &b)
+{
+    if(a.isEmpty() || b.isEmpty() || a == b) return true;
+    if(a.size() < b.size()) return b.startsWith(a) && b[a.size()] == QLatin1Char('.');
+    return a.startsWith(b) && a[b.size()] == QLatin1Char('.');
+}
+
+/****************************************************************************
+ * @function name: Excel::shadowOverlap()
+ * @param:
+ *    const QString &a, &b - shadow paths like "Range(\"A1:B2\").Font.Bold"
+ *                           or "Cells(3,4).Font"
+ * @description: paths overlap when one property contains the other (an
+ *               empty property is the whole object) and their cells
+ *               intersect. Unknown cell objects, e.g. defined names,
+ *               cover the whole sheet.
+ * @return: ( bool ) put on a may change value of b
+ ****************************************************************************/
+bool Excel::shadowOverlap(const QString &a, const QString &b)
+{
+    QString object_a, property_a, object_b, property_b;
+    splitShadowPath(a, &object_a, &property_a);
+    splitShadowPath(b, &object_b, &property_b);
+    if(object_a.isEmpty() || object_b.isEmpty()) return a == b;
+    if(!shadowPropertiesOverlap(property_a, property_b)) return false;
+
+    enum {MaxAreas = 16};
+    ExcelAddress::Area areas_a[MaxAreas], areas_b[MaxAreas];
+    const int count_a = shadowAreas(object_a, areas_a, MaxAreas);
+    const int count_b = shadowAreas(object_b, areas_b, MaxAreas);
+    if(count_a < 0 || count_b < 0) return true;
+    for(int i=0; i<count_a; i++)
+    {
+        const ExcelAddress::Area &p = areas_a[i];
+        for(int j=0; j<count_b; j++)
+        {
+            const ExcelAddress::Area &q = areas_b[j];
+            if(p.first.col <= q.last.col && q.first.col <= p.last.col
+                    && p.first.row <= q.last.row && q.first.row <= p.last.row)
+                return true;
+        }
+    }
+    return false;
+}
+
 bool Excel::cellVisible(int row, int col)
 {
+    if(!m_opened) return false;
     return mp_exlObject->dynamicCall(mp_currentSheet,QString("Cells(%1, %2).Select").arg(row).arg(col));
 }
 
@@ -440,12 +941,18 @@ Excel::Table* Excel::CreateTable(const Excel::Rect &rect
                                  , const QStringList &headerData
                                  , const QStringList &tableData)
 {
+    // table, header and body frames overlap, draw them resolved at once
+    const bool batch = !m_framesBuffered;
+    if(batch) beginFrames();
+
     Excel::Table *ptable = CreateTable(rect, new TableHeader1Line(), new TableStandardBody());
 
-    if(!headerData.isEmpty())
+    if(ptable && !headerData.isEmpty())
         ptable->setHeaderData(headerData);
-    if(!tableData.isEmpty())
+    if(ptable && !tableData.isEmpty())
         ptable->setTableData(tableData);
+
+    if(batch) flushFrames();
     return ptable;
 }
 
@@ -453,7 +960,7 @@ Excel::Table * Excel::CreateTable(const Rect &rect
                                   , DataArea *tableHeaderArea
                                   , DataArea *tableDataArea)
 {
-    if(!m_opened) return 0;
+    if(!isOpen()) return 0;
 
     Excel::Table *ptable =  new Excel::Table(this,rect);
 
@@ -488,17 +995,22 @@ bool Excel::AppendRow(Table *ptable, const QStringList &tableData)
 
 bool Excel::SetDataToColumn(Excel::Table *ptable, const QVariantList &data, int column)
 {
+    flushCombined();
+    if(mp_xlsx){
+        if(data.isEmpty() || !ptable) return false;
+        const Rect rect = ptable->dataRect().column(column);
+        return mp_xlsx->writeBlock(QRect(rect.x(), rect.y(), 1, data.count()), data);
+    }
 
     bool result = false;
     mp_exlObject->clearBag();
     setUpdatesOn(0);
     if(!data.isEmpty() && ptable)
     {
-        VARIANT v;
-        AxObject::QVariantList_to_2D_VARIANT(data,1,data.count(),v);
-        if(mp_exlObject->setPropertyVariant(currentSheet(),
-                                            QString("Range(\"%1\").Value")
-                                            .arg(ptable->dataRect().column(column).toRange()), v))
+        sheetDataChanged(QString(), ptable->dataRect().column(column));
+        if(mp_exlObject->setPropertyBlock(currentSheet(),
+                                          QString("Range(\"%1\").Value")
+                                          .arg(ptable->dataRect().column(column).toRange()), data, 1, data.count()))
         {
             result = true;
         }
@@ -511,6 +1023,8 @@ bool Excel::SetDataToColumn(Excel::Table *ptable, const QVariantList &data, int
 
 bool Excel::SetDataToRange(const Excel::Rect &rect,  QVariantList data)
 {
+    flushCombined();
+    if(mp_xlsx) return mp_xlsx->writeBlock(QRect(rect.x(), rect.y(), rect.width(), rect.height()), data);
 
     bool result = false;
     mp_exlObject->clearBag();
@@ -518,11 +1032,10 @@ bool Excel::SetDataToRange(const Excel::Rect &rect,  QVariantList data)
         for(int i=data.size();i<rect.width()*rect.height();i++)
             data.append(QString(""));
     }
-    VARIANT v;
-    AxObject::QVariantList_to_2D_VARIANT(data,rect.width(),rect.height(),v);
-    if(mp_exlObject->setPropertyVariant(currentSheet(),
-                                        QString("Range(\"%1\").Value")
-                                        .arg(rect.toRange()), v))
+    sheetDataChanged(QString(), rect);
+    if(mp_exlObject->setPropertyBlock(currentSheet(),
+                                      QString("Range(\"%1\").Value")
+                                      .arg(rect.toRange()), data, rect.width(), rect.height()))
     {
         result = true;
     }
@@ -530,19 +1043,184 @@ bool Excel::SetDataToRange(const Excel::Rect &rect,  QVariantList data)
     return result;
 }
 
+/****************************************************************************
+ * @function name: Excel::SetDataToRange()
+ * @param:
+ *      const QString &sheetname - sheet, current sheet when empty
+ *      const Excel::Rect &rect
+ *      QVariantList data - row-major values
+ * @description: values are put through handle of named sheet, sheet is
+ *               not activated
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool Excel::SetDataToRange(const QString &sheetname, const Excel::Rect &rect, QVariantList data)
+{
+    if(sheetname.isEmpty()) return SetDataToRange(rect, data);
+    if(mp_xlsx)
+    {
+        const QString current = mp_xlsx->currentSheet();
+        if(!mp_xlsx->setCurrentSheet(sheetname)) return false;
+        const bool result = SetDataToRange(rect, data);
+        if(!current.isEmpty()) mp_xlsx->setCurrentSheet(current);
+        return result;
+    }
+
+    flushCombined();
+    const AxObject::Class pSheet = sheetHandle(sheetname);
+    if(pSheet == 0) return false;
+    mp_exlObject->clearBag();
+    for(int i=data.size(); i<rect.width()*rect.height(); i++)
+        data.append(QString(""));
+    sheetDataChanged(sheetname, rect);
+    return mp_exlObject->setPropertyBlock(pSheet, QString("Range(\"%1\").Value").arg(rect.toRange())
+                                          , data, rect.width(), rect.height());
+}
+
+/****************************************************************************
+ * @function name: Excel::upsertRows()
+ * @param:
+ *      const Cell &top_left - first cell of table on current sheet
+ *      int width - columns of table
+ *      int old_count - rows now present on sheet, 0 - empty region
+ *      const QList<QVariantList> &rows - new table rows
+ *      UpsertStats *pstats - optional
+ *      int call_cost - unchanged cells one call is worth
+ * @description: old block is read by one Value2 call, old and new rows are
+ *               matched by hash (see ExcelUpsert::plan), so inserted or
+ *               deleted rows do not rewrite rows after them. Matched runs
+ *               at other position are moved by Cut, rows without match are
+ *               written in runs, stale rows are cleared.
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool Excel::upsertRows(const Cell &top_left, int width, int old_count, const QList<QVariantList> &rows
+                       , UpsertStats *pstats, int call_cost)
+{
+    UpsertStats stats;
+    if(pstats) *pstats = stats;
+    if(!m_opened || width <= 0 || top_left.x() < 0 || top_left.y() < 0) return false;
+    flushCombined();
+
+    old_count = qMax(0, old_count);
+    const int new_count = rows.count();
+    const int x = top_left.x();
+    const int y = top_left.y();
+
+    QVector<quint64> old_hashes(old_count);
+    if(old_count > 0)
+    {
+        mp_exlObject->clearBag();
+        const Rect block(x, y, width, old_count);
+        QVariant data;
+        if(!mp_exlObject->property(currentSheet(), QString("Range(\"%1\").Value2").arg(block.toRange(false)), &data))
+            return false;
+        stats.calls++;
+
+        // single cell comes as scalar, other areas as rows of columns
+        QVariantList old_rows = data.toList();
+        if(width == 1 && old_count == 1) old_rows = QVariantList() << QVariant(QVariantList() << data);
+        for(int r=0; r<old_count; r++)
+            old_hashes[r] = ExcelUpsert::rowHash(r < old_rows.count() ? old_rows[r].toList() : QVariantList(), width);
+    }
+
+    // new data is hashed as excel will store it, not as given
+    QVector<quint64> new_hashes(new_count);
+    for(int r=0; r<new_count; r++)
+    {
+        QVariantList stored;
+        stored.reserve(rows[r].count());
+        foreach(const QVariant &data, rows[r]) stored.append(ExcelUpsert::storedValue(data));
+        new_hashes[r] = ExcelUpsert::rowHash(stored, width);
+    }
+    const ExcelUpsert::Plan plan = ExcelUpsert::plan(old_hashes, new_hashes, width, call_cost);
+
+    bool result = true;
+    if(!plan.moves.isEmpty())
+    {
+        dropPosted(Rect(x, y, width, qMax(old_count, new_count)));
+        sheetDataChanged(QString(), Rect(x, y, width, qMax(old_count, new_count)));
+    }
+    foreach(const ExcelUpsert::Move &move, plan.moves)
+    {
+        // cut moves values and formats, source is left empty
+        mp_exlObject->clearBag();
+        const AxObject::Class pdest = mp_exlObject->queryObject(currentSheet()
+                                    , QString("Range(\"%1\")").arg(Rect(x, y + move.to, width, move.count).toRange()));
+        result &= pdest != currentSheet()
+                && mp_exlObject->dynamicCall(currentSheet()
+                                             , QString("Range(\"%1\").Cut").arg(Rect(x, y + move.from, width, move.count).toRange())
+                                             , 0, AxObjectType(DISPATCH, (quint32)pdest));
+        stats.calls += 2;
+    }
+    stats.rowsMoved = plan.rowsMoved;
+    stats.rowsUnchanged = plan.rowsUnchanged;
+
+    foreach(const ExcelUpsert::Run &run, plan.writes)
+    {
+        QVariantList block;
+        block.reserve(run.count*width);
+        for(int i=run.first; i<run.first + run.count; i++)
+        {
+            const QVariantList &row = rows[i];
+            for(int c=0; c<width; c++)
+            {
+                const QVariant data = c < row.count() ? row[c] : QVariant(QString(""));
+                block.append(data);
+                stats.bytesWritten += ExcelUpsert::variantBytes(data);
+            }
+        }
+        result &= SetDataToRange(Rect(x, y + run.first, width, run.count), block);
+        stats.rowsWritten += run.count;
+        stats.calls++;
+    }
+
+    qint64 full_bytes = 0;
+    foreach(const QVariantList &row, rows)
+        for(int c=0; c<width; c++)
+            full_bytes += ExcelUpsert::variantBytes(c < row.count() ? row[c] : QVariant(QString("")));
+
+    int full_calls = new_count > 0 ? 1 : 0;
+    if(!plan.clears.isEmpty())
+    {
+        // vacated runs are cleared as multi-area ranges
+        ExcelRangeSet cells;
+        foreach(const ExcelUpsert::Run &run, plan.clears)
+        {
+            cells.addRect(Rect(x, y + run.first, width, run.count));
+            stats.rowsCleared += run.count;
+        }
+        result &= clearRange(cells);
+        stats.calls += cells.toRanges().count();
+    }
+    if(old_count > new_count) full_calls++;
+
+    stats.bytesSaved = full_bytes - stats.bytesWritten;
+    stats.callsSaved = full_calls - stats.calls;
+    if(pstats) *pstats = stats;
+    return result;
+}
+
+bool Excel::upsertRows(const Rect &rect, const QList<QVariantList> &rows, UpsertStats *pstats, int call_cost)
+{
+    return upsertRows(rect.p1(), rect.width(), rect.height(), rows, pstats, call_cost);
+}
 
 bool Excel::SetDataToRow(Excel::Table *ptable, const QVariantList &data, int row)
 {
+    flushCombined();
+    if(mp_xlsx){
+        if(data.isEmpty() || !ptable) return false;
+        const Rect rect = ptable->dataRect().row(row);
+        return mp_xlsx->writeBlock(QRect(rect.x(), rect.y(), data.count(), 1), data);
+    }
     bool result = false;
     mp_exlObject->clearBag();
     setUpdatesOn(0);
     if(!data.isEmpty() && ptable)
     {
-        VARIANT v;
-        AxObject::QVariantList_to_2D_VARIANT(data,data.count(),1,v);
-        if(mp_exlObject->setPropertyVariant(currentSheet(),
-                                            QString("Range(\"%1\").Value")
-                                            .arg(ptable->dataRect().row(row).toRange()), v))
+        sheetDataChanged(QString(), ptable->dataRect().row(row));
+        if(mp_exlObject->setPropertyBlock(currentSheet(),
+                                          QString("Range(\"%1\").Value")
+                                          .arg(ptable->dataRect().row(row).toRange()), data, data.count(), 1))
         {
             result = true;
         }
@@ -554,7 +1232,7 @@ bool Excel::SetDataToRow(Excel::Table *ptable, const QVariantList &data, int row
 int Excel::width(const QString &range)
 {
     QVariant v;
-    if(mp_exlObject->property(currentSheet(),QString("Range(\"%1\").Width").arg(range),&v))
+    if(m_opened && mp_exlObject->property(currentSheet(),QString("Range(\"%1\").Width").arg(range),&v))
     {
         return v.toInt();
     }
@@ -564,19 +1242,65 @@ int Excel::width(const QString &range)
 int Excel::height(const QString &range)
 {
     QVariant v;
-    if( mp_exlObject->property( currentSheet(), QString("Range(\"%1\").Height").arg(range) , &v ) )
+    if( m_opened && mp_exlObject->property( currentSheet(), QString("Range(\"%1\").Height").arg(range) , &v ) )
     {
         return v.toInt();
     }
     return 0;
 }
 
+void Excel::setRequestTimeout(int msec, bool recycle)
+{
+    if(!mp_exlObject) return;
+    mp_exlObject->setRequestTimeout(msec);
+    mp_exlObject->setAutoRecycle(recycle);
+}
+
+void Excel::setWatchdogInterval(int msec)
+{
+    if(!mp_exlObject) return;
+    mp_exlObject->setWatchdogInterval(msec);
+}
+
+/****************************************************************************
+ * @function name: Excel::slot_serverRecycled()
+ * @description: hung excel was restarted by watchdog. Handles died with the
+ *               old server, so session state is replayed: application
+ *               settings, workbook and current sheet. Replay runs once per
+ *               recycle, repeated notifications are ignored.
+ ****************************************************************************/
+void Excel::slot_serverRecycled()
+{
+    if(mp_exlObject->recycleCount() == m_replayedRecycles) return;
+    m_replayedRecycles = mp_exlObject->recycleCount();
+    // range handles of tables belong to dead server
+    detachTables(false);
+    nextSheetGeneration();
+    mp_currentSheet = 0;
+    mp_currentWorkBook = 0;
+    m_opened = false;
+    m_updatesOn = true;
+    m_updatesDepth = 0;
+    if(!mp_exlObject->isValid()) return;
+
+    mp_exlObject->setProperty( 0,"DisplayAlerts", 1);
+    mp_exlObject->setProperty(0,"DisplayStatusBar",0);
+    mp_exlObject->setProperty(0,"EnableEvents",0);
+
+    // reopens last saved file or starts new workbook
+    if(open() && !m_sheetname.isEmpty())
+        setCurrentSheet(m_sheetname);
+}
+
 void Excel::setUpdatesOn(bool on)
 {
-    if(!mp_exlObject) return;    
+    if(!mp_exlObject) return;
+    // only outermost off/on pair reaches excel
+    if(!on && m_updatesDepth++ > 0) return;
+    if(on && m_updatesDepth > 0 && --m_updatesDepth > 0) return;
     if(on != m_updatesOn){
         //mp_exlObject->setProperty(0,"DisplayStatusBar",on);
-        mp_exlObject->setProperty(0,"EnableEvents",on);
+        mp_exlObject->setPropertyCached(0,"EnableEvents",on);
         setCalculation(on);
         m_updatesOn = on;
     }
@@ -584,18 +1308,27 @@ void Excel::setUpdatesOn(bool on)
 void Excel::setCalculation(bool on)
 {
     if(!mp_exlObject) return;
-    if(!on) mp_exlObject->setProperty(0,"Calculation",xlCalculationManual);
+    if(!on) mp_exlObject->setPropertyCached(0,"Calculation",xlCalculationManual);
     else {
-        mp_exlObject->setProperty(0,"Calculation",xlCalculationAutomatic);
+        mp_exlObject->setPropertyCached(0,"Calculation",xlCalculationAutomatic);
     }
 }
 
 void Excel::setScreenUpdate(bool on)
 {
-    mp_exlObject->setProperty(0,"ScreenUpdating", on);
+    if(!mp_exlObject) return;
+    mp_exlObject->setPropertyCached(0,"ScreenUpdating", on);
+}
+
+bool Excel::screenUpdate()
+{
+    QVariant v;
+    if(!mp_exlObject || !mp_exlObject->property(0,"ScreenUpdating",&v)) return true;
+    return v.toBool();
 }
 
 void Excel::recalculate(){
+    if(!mp_exlObject) return;
     mp_exlObject->dynamicCall(0,"Calculate");
 }
 
@@ -614,43 +1347,213 @@ int Excel::version()
 }
 
 
+/****************************************************************************
+ * @function name: Excel::CreateChart()
+ * @param:
+ *      const Chart &chart - chart description
+ * @description: chart is created from cell data. Formatting of first chart
+ *               of each style is saved as chart template, next charts of
+ *               the same style get it with one ApplyChartTemplate call.
+ * @return: ( AxObject::Class ) chart shape, 0 on error
+ ****************************************************************************/
 AxObject::Class Excel::CreateChart(const Chart &chart)
 {  
-    mp_exlObject->clearBag();
-
-    AxObject::Class pObj = 0 ;
     if(!m_opened) return 0;
-    QVariant var;
-    const int _XLChartType[] ={ xlXYScatterLinesNoMarkers,       xlLine  };
+    mp_exlObject->clearBag();
+    QElapsedTimer timer;
+    timer.start();
 
-    mp_exlObject->dynamicCall(this->mp_currentSheet,QString("Range(\"%1\").Select").arg(chart.cellDataRange.toRange()));
+    AxObject::Class pChart = 0;
+    AxObject::Class pObj = addChartShape(chart, &pChart);
+    if(pObj==0) return 0;
 
-    if(!chart.rect.isEmpty()){
-        mp_exlObject->dynamicCall(this->mp_currentSheet, "Shapes.AddChart2",&var ,-1, _XLChartType[chart.type]
-                                  ,chart.rect.x(),  chart.rect.y(),   chart.rect.width(),   chart.rect.height());
-    }
-    else {
-        mp_exlObject->dynamicCall(this->mp_currentSheet, "Shapes.AddChart2",&var ,-1, _XLChartType[chart.type]);
-    }
+    AxObject::Class  pRange = mp_exlObject->queryObject(currentSheet(), QString("Range(\"%1\")").arg(chart.cellDataRange.toRange()));
+    mp_exlObject->dynamicCall(pChart,"SetSourceData",0, AxObjectType(DISPATCH,(quint32)pRange),2);
 
-    pObj = var.toInt();
-    if(pObj==0) return 0;
+    applyChartStyle(pChart, chart);
 
-    mp_exlObject->method_run(pObj,"Select");
-    mp_exlObject->setProperty(0,"ActiveChart.ChartType", _XLChartType[chart.type]);
+    m_chartsCreated++;
+    m_chartTime += timer.elapsed();
+    return pObj;
+}
 
-    AxObject::Class  pRange = mp_exlObject->queryObject(currentSheet(), QString("Range(\"%1\")").arg(chart.cellDataRange.toRange()));
-    mp_exlObject->dynamicCall(0,"ActiveChart.SetSourceData",0, AxObjectType(DISPATCH,(quint32)pRange),2);
+/****************************************************************************
+ * @function name: Excel::CreateChart()
+ * @param:
+ *      const Chart &chart - chart description, cellDataRange is not used
+ *      const QList<ChartSeries> &series - series values
+ *      ExcelDecimate::Mode decimation - point reduction of long series
+ *      int max_points - limit of points per series when decimated
+ * @description: chart series values are assigned from numeric arrays,
+ *               data is not written to cells. Excel keeps array values in
+ *               series formula of limited length, so decimated series get
+ *               fewer points than max_points when their values do not fit
+ *               ExcelDecimate::MaxSeriesLiteral characters. Chart is
+ *               deleted when a series is refused, e.g. long series with
+ *               ExcelDecimate::None.
+ * @return: ( AxObject::Class ) chart shape, 0 on error
+ ****************************************************************************/
+AxObject::Class Excel::CreateChart(const Chart &chart, const QList<ChartSeries> &series
+                                   , ExcelDecimate::Mode decimation, int max_points)
+{
+    if(!m_opened) return 0;
+    mp_exlObject->clearBag();
+    QElapsedTimer timer;
+    timer.start();
 
+    AxObject::Class pChart = 0;
+    AxObject::Class pObj = addChartShape(chart, &pChart);
+    if(pObj==0) return 0;
 
-    mp_exlObject->setProperty(0,"ActiveChart.ChartTitle.Text",chart.title);
+    // series guessed by excel from current selection are not wanted
+    QVariant var;
+    if(mp_exlObject->property(pChart,"SeriesCollection.Count",&var))
+    {
+        for(int i=var.toInt();i>0;i--)
+            mp_exlObject->dynamicCall(pChart,QString("SeriesCollection(%1).Delete").arg(i));
+    }
 
-    int series_count =0;
-    if(mp_exlObject->property(0,"ActiveChart.SeriesCollection.Count",&var))
+    bool result = true;
+    foreach(const ChartSeries &item, series)
     {
-        series_count = var.toInt();
-        for(int i=1;i<series_count+1;i++){
-            mp_exlObject->setProperty(0,QString("ActiveChart.SeriesCollection(%1).Border.Weight").arg(i),xlThin);
+        QVector<double> x = item.x;
+        if(x.isEmpty())
+        {
+            x.resize(item.y.size());
+            for(int i=0;i<x.size();i++) x[i] = i+1;
+        }
+
+        QVector<double> xs, ys;
+        ExcelDecimate::decimateToLength(decimation, x, item.y, max_points
+                                        , ExcelDecimate::MaxSeriesLiteral - item.name.size(), &xs, &ys);
+
+        AxObject::Class pSeries = 0;
+        if(mp_exlObject->dynamicCall(pChart,"SeriesCollection.NewSeries",&var))
+            pSeries = var.toInt();
+        if(pSeries==0) {
+            result = false;
+            break;
+        }
+
+        if(!item.name.isEmpty())
+            mp_exlObject->setProperty(pSeries,"Name",item.name);
+
+        // too long series formula is refused, series would stay empty
+        if(!mp_exlObject->setPropertyVector(pSeries,"XValues",xs)
+                || !mp_exlObject->setPropertyVector(pSeries,"Values",ys))
+        {
+            result = false;
+            break;
+        }
+    }
+    if(!result)
+    {
+        mp_exlObject->dynamicCall(pObj, "Delete");
+        return 0;
+    }
+
+    applyChartStyle(pChart, chart);
+
+    m_chartsCreated++;
+    m_chartTime += timer.elapsed();
+    return pObj;
+}
+
+// new chart shape on current sheet, chart object is returned by ppchart
+AxObject::Class Excel::addChartShape(const Chart &chart, AxObject::Class *ppchart)
+{
+    QVariant var;
+    const int _XLChartType[] ={ xlXYScatterLinesNoMarkers,       xlLine  };
+
+    if(!chart.rect.isEmpty()){
+        mp_exlObject->dynamicCall(this->mp_currentSheet, "Shapes.AddChart2",&var ,-1, _XLChartType[chart.type]
+                                  ,chart.rect.x(),  chart.rect.y(),   chart.rect.width(),   chart.rect.height());
+    }
+    else {
+        mp_exlObject->dynamicCall(this->mp_currentSheet, "Shapes.AddChart2",&var ,-1, _XLChartType[chart.type]);
+    }
+
+    AxObject::Class pObj = var.toInt();
+    if(pObj==0) return 0;
+
+    // chart is addressed by handle, no ActiveChart lookups
+    AxObject::Class pChart = mp_exlObject->queryObject(pObj, "Chart");
+    if(pChart == pObj) return 0;
+
+    mp_exlObject->setProperty(pChart,"ChartType", _XLChartType[chart.type]);
+    *ppchart = pChart;
+    return pObj;
+}
+
+// template of chart style is applied, or chart is formatted and saved as template
+void Excel::applyChartStyle(AxObject::Class pChart, const Chart &chart)
+{
+    // series colors and plot area size are part of template
+    QVariant var;
+    mp_exlObject->property(pChart, "SeriesCollection.Count", &var);
+    const QString key = chartTemplateKey(chart, var.toInt());
+    if(m_chartTemplates.contains(key)
+            && mp_exlObject->dynamicCall(pChart, "ApplyChartTemplate", 0, m_chartTemplates[key]))
+    {
+        setChartTexts(pChart, chart);
+    }
+    else
+    {
+        formatChart(pChart, chart);
+        const QString path = QDir::temp().filePath(QString("AxChart_%1_%2.crtx")
+                                                    .arg(quintptr(this), 0, 16)
+                                                    .arg(qHash(key), 8, 16, QChar('0')));
+        if(mp_exlObject->dynamicCall(pChart, "SaveChartTemplate", 0, QDir::toNativeSeparators(path)))
+            m_chartTemplates.insert(key, QDir::toNativeSeparators(path));
+    }
+}
+
+// formatting parameters of chart, texts are not part of style
+QString Excel::chartTemplateKey(const Chart &chart, int series_count)
+{
+    return QString("%1|%2|%3|%4|%5|%6|%7|%8|%9")
+            .arg(chart.type).arg(chart.xScaleType).arg(chart.yScaleType)
+            .arg(chart.legendVisible).arg(chart.minorGridLines).arg(chart.majorGridLines)
+            .arg(!chart.title.isEmpty()).arg(!chart.xAxis.isEmpty()).arg(!chart.yAxis.isEmpty())
+            + QString("|%1|%2x%3").arg(series_count).arg(chart.rect.width()).arg(chart.rect.height());
+}
+
+// template files saved for this workbook are removed
+void Excel::clearChartTemplates()
+{
+    foreach(const QString &path, m_chartTemplates)
+        QFile::remove(path);
+    m_chartTemplates.clear();
+}
+
+void Excel::setChartTexts(AxObject::Class pChart, const Chart &chart)
+{
+    mp_exlObject->setProperty(pChart,"HasTitle", !chart.title.isEmpty());
+    if(!chart.title.isEmpty())
+        mp_exlObject->setProperty(pChart,"ChartTitle.Text", chart.title);
+    if(!chart.yAxis.isEmpty())
+        mp_exlObject->setProperty(pChart,"Axes(2).AxisTitle.Caption", chart.yAxis);
+    if(!chart.xAxis.isEmpty())
+        mp_exlObject->setProperty(pChart,"Axes(1).AxisTitle.Caption" , chart.xAxis);
+}
+
+double Excel::chartsPerSecond() const
+{
+    if(m_chartTime == 0) return 0;
+    return 1000.0*m_chartsCreated/m_chartTime;
+}
+
+void Excel::formatChart(AxObject::Class pChart, const Chart &chart)
+{
+    QVariant var;
+    mp_exlObject->setProperty(pChart,"ChartTitle.Text",chart.title);
+
+    int series_count =0;
+    if(mp_exlObject->property(pChart,"SeriesCollection.Count",&var))
+    {
+        series_count = var.toInt();
+        for(int i=1;i<series_count+1;i++){
+            mp_exlObject->setProperty(pChart,QString("SeriesCollection(%1).Border.Weight").arg(i),xlThin);
         }
     }
     const QColor std_colors[7] = {
@@ -666,98 +1569,445 @@ AxObject::Class Excel::CreateChart(const Chart &chart)
 
     for(int i=0;i<qMin(series_count,7);i++)
     {
-        mp_exlObject->setProperty(0, QString("ActiveChart.SeriesCollection(%1).Format.Line.ForeColor.RGB").arg(i+1), std_colors[i]);
+        mp_exlObject->setProperty(pChart, QString("SeriesCollection(%1).Format.Line.ForeColor.RGB").arg(i+1), std_colors[i]);
     }
 
 
-    mp_exlObject->setProperty(0,"ActiveChart.HasTitle", !chart.title.isEmpty());
-    mp_exlObject->setProperty(0,"ActiveChart.ChartTitle.Caption", QString("Automated Measurement Output Chart %1").arg(series_count));
-    mp_exlObject->setProperty(0,"ActiveChart.ChartTitle.Text", chart.title);
-    mp_exlObject->setProperty(0,"ActiveChart.ChartTitle.AutoScaleFont", false);
-    mp_exlObject->setProperty(0,"ActiveChart.ChartTitle.Font.Name", "Arial");
-    mp_exlObject->setProperty(0,"ActiveChart.ChartTitle.Font.Size", 12);
-    mp_exlObject->setProperty(0,"ActiveChart.ChartTitle.Font.Bold", true);
+    mp_exlObject->setProperty(pChart,"HasTitle", !chart.title.isEmpty());
+    mp_exlObject->setProperty(pChart,"ChartTitle.Caption", QString("Automated Measurement Output Chart %1").arg(series_count));
+    mp_exlObject->setProperty(pChart,"ChartTitle.Text", chart.title);
+    mp_exlObject->setProperty(pChart,"ChartTitle.AutoScaleFont", false);
+    mp_exlObject->setProperty(pChart,"ChartTitle.Font.Name", "Arial");
+    mp_exlObject->setProperty(pChart,"ChartTitle.Font.Size", 12);
+    mp_exlObject->setProperty(pChart,"ChartTitle.Font.Bold", true);
 
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(2).TickLabels.Font.Name","Arial");
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(2).TickLabels.Font.Size",8);
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(2).TickLabels.AutoScaleFont",false);
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(2).TickLabelPosition",xlLow );
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(2).HasMajorGridLines",true);
+    mp_exlObject->setProperty(pChart,"Axes(2).TickLabels.Font.Name","Arial");
+    mp_exlObject->setProperty(pChart,"Axes(2).TickLabels.Font.Size",8);
+    mp_exlObject->setProperty(pChart,"Axes(2).TickLabels.AutoScaleFont",false);
+    mp_exlObject->setProperty(pChart,"Axes(2).TickLabelPosition",xlLow );
+    mp_exlObject->setProperty(pChart,"Axes(2).HasMajorGridLines",true);
 
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(2).MajorGridLines.Border.Weight",xlHairLine );
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(2).MajorGridLines.Border.ColorIndex",16);
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(2).HasMinorGridlines",false);
+    mp_exlObject->setProperty(pChart,"Axes(2).MajorGridLines.Border.Weight",xlHairLine );
+    mp_exlObject->setProperty(pChart,"Axes(2).MajorGridLines.Border.ColorIndex",16);
+    mp_exlObject->setProperty(pChart,"Axes(2).HasMinorGridlines",false);
 
 
     //xlValue
     if(!chart.yAxis.isEmpty())
     {
-        mp_exlObject->setProperty(0,"ActiveChart.Axes(2).HasTitle", true);
-        mp_exlObject->setProperty(0,"ActiveChart.Axes(2).AxisTitle.Caption", chart.yAxis);
-        mp_exlObject->setProperty(0,"ActiveChart.Axes(2).AxisTitle.Font.Name","Arial");
-        mp_exlObject->setProperty(0,"ActiveChart.Axes(2).AxisTitle.Font.Size",9);
-        mp_exlObject->setProperty(0,"ActiveChart.Axes(2).AxisTitle.Font.Bold",true);
-        mp_exlObject->setProperty(0,"ActiveChart.Axes(2).AxisTitle.AutoScaleFont",false);
+        mp_exlObject->setProperty(pChart,"Axes(2).HasTitle", true);
+        mp_exlObject->setProperty(pChart,"Axes(2).AxisTitle.Caption", chart.yAxis);
+        mp_exlObject->setProperty(pChart,"Axes(2).AxisTitle.Font.Name","Arial");
+        mp_exlObject->setProperty(pChart,"Axes(2).AxisTitle.Font.Size",9);
+        mp_exlObject->setProperty(pChart,"Axes(2).AxisTitle.Font.Bold",true);
+        mp_exlObject->setProperty(pChart,"Axes(2).AxisTitle.AutoScaleFont",false);
     }
 
     //xlCategory
     if(!chart.xAxis.isEmpty()){
-        mp_exlObject->setProperty(0,"ActiveChart.Axes(1).HasTitle" , true);
-        mp_exlObject->setProperty(0,"ActiveChart.Axes(1).AxisTitle.Caption" , chart.xAxis);
-        mp_exlObject->setProperty(0,"ActiveChart.Axes(1).AxisTitle.AutoScaleFont" , false);
-        mp_exlObject->setProperty(0,"ActiveChart.Axes(1).AxisTitle.Font.Name" , "Arial");
-        mp_exlObject->setProperty(0,"ActiveChart.Axes(1).AxisTitle.Font.Size" , 9);
-        mp_exlObject->setProperty(0,"ActiveChart.Axes(1).AxisTitle.Font.Bold" , true);
+        mp_exlObject->setProperty(pChart,"Axes(1).HasTitle" , true);
+        mp_exlObject->setProperty(pChart,"Axes(1).AxisTitle.Caption" , chart.xAxis);
+        mp_exlObject->setProperty(pChart,"Axes(1).AxisTitle.AutoScaleFont" , false);
+        mp_exlObject->setProperty(pChart,"Axes(1).AxisTitle.Font.Name" , "Arial");
+        mp_exlObject->setProperty(pChart,"Axes(1).AxisTitle.Font.Size" , 9);
+        mp_exlObject->setProperty(pChart,"Axes(1).AxisTitle.Font.Bold" , true);
     }
 
     const int _XLScaleType[] = {xlLinear,xlLogarithmic};
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(1).ScaleType" , _XLScaleType[chart.xScaleType]);
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(1).TickLabels.Font.Name" , "Arial");
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(1).TickLabels.Font.Size" , 8);
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(1).TickLabels.AutoScaleFont" , 8);
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(1).TickLabelPosition" , xlLow);
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(1).HasMajorGridlines" , chart.majorGridLines);
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(1).MinorGridlines.Border.Weight" , xlHairLine);
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(1).MinorGridlines.Border.ColorIndex" , 16);
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(1).HasMinorGridlines" , chart.minorGridLines);
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(1).MinorGridlines.Border.Weight" , xlHairLine);
-    mp_exlObject->setProperty(0,"ActiveChart.Axes(1).MinorGridlines.Border.ColorIndex" , 15);
+    mp_exlObject->setProperty(pChart,"Axes(1).ScaleType" , _XLScaleType[chart.xScaleType]);
+    mp_exlObject->setProperty(pChart,"Axes(1).TickLabels.Font.Name" , "Arial");
+    mp_exlObject->setProperty(pChart,"Axes(1).TickLabels.Font.Size" , 8);
+    mp_exlObject->setProperty(pChart,"Axes(1).TickLabels.AutoScaleFont" , 8);
+    mp_exlObject->setProperty(pChart,"Axes(1).TickLabelPosition" , xlLow);
+    mp_exlObject->setProperty(pChart,"Axes(1).HasMajorGridlines" , chart.majorGridLines);
+    mp_exlObject->setProperty(pChart,"Axes(1).MinorGridlines.Border.Weight" , xlHairLine);
+    mp_exlObject->setProperty(pChart,"Axes(1).MinorGridlines.Border.ColorIndex" , 16);
+    mp_exlObject->setProperty(pChart,"Axes(1).HasMinorGridlines" , chart.minorGridLines);
+    mp_exlObject->setProperty(pChart,"Axes(1).MinorGridlines.Border.Weight" , xlHairLine);
+    mp_exlObject->setProperty(pChart,"Axes(1).MinorGridlines.Border.ColorIndex" , 15);
 
 
 
     QVariant width,left,height;
-    mp_exlObject->property(0,"ActiveChart.ChartArea.Width",&width);
-    mp_exlObject->property(0,"ActiveChart.ChartArea.Height",&height);
-    mp_exlObject->setProperty(0,"ActiveChart.PlotArea.Height", height.toInt() -40);
-    mp_exlObject->setProperty(0,"ActiveChart.PlotArea.Interior.ColorIndex",xlAutomatic);
-    mp_exlObject->property(0,"ActiveChart.PlotArea.Left",&left);
-    mp_exlObject->setProperty(0,"ActiveChart.PlotArea.Width", width.toInt() -2*left.toInt());
+    mp_exlObject->property(pChart,"ChartArea.Width",&width);
+    mp_exlObject->property(pChart,"ChartArea.Height",&height);
+    mp_exlObject->setProperty(pChart,"PlotArea.Height", height.toInt() -40);
+    mp_exlObject->setProperty(pChart,"PlotArea.Interior.ColorIndex",xlAutomatic);
+    mp_exlObject->property(pChart,"PlotArea.Left",&left);
+    mp_exlObject->setProperty(pChart,"PlotArea.Width", width.toInt() -2*left.toInt());
 
     // legend
     if(chart.legendVisible){
-        mp_exlObject->setProperty(0,"ActiveChart.HasLegend",true);
-        mp_exlObject->setProperty(0,"ActiveChart.Legend.Font.Name","Arial");
-        mp_exlObject->setProperty(0,"ActiveChart.Legend.Font.Size",8);
-        mp_exlObject->setProperty(0,"ActiveChart.Legend.IncludeInLayout",false);
-        mp_exlObject->setProperty(0,"ActiveChart.Legend.Position",xlLegendPositionRight);
-        mp_exlObject->setProperty(0,"ActiveChart.Legend.Format.Fill.Visible",true);
-        mp_exlObject->setProperty(0,"ActiveChart.Legend.Format.Fill.ForeColor.ObjectThemeColor",msoThemeColorBackground1);
-        mp_exlObject->setProperty(0,"ActiveChart.Legend.Format.Fill.ForeColor.TintAndShade",true);
-        mp_exlObject->setProperty(0,"ActiveChart.Legend.Format.Fill.ForeColor.Brightness",0);
-        mp_exlObject->setProperty(0,"ActiveChart.Legend.Format.Fill.Transparency",0);
-        mp_exlObject->setProperty(0,"ActiveChart.Legend.Interior.PatternColorIndex",2);//white
-        mp_exlObject->setProperty(0,"ActiveChart.Legend.Interior.Pattern",xlSolid);//white
-        mp_exlObject->setProperty(0,"ActiveChart.Legend.Border.Weight",xlHairLine);
-        mp_exlObject->setProperty(0,"ActiveChart.Legend.Border.ColorIndex",1); //Black
-        mp_exlObject->setProperty(0,"ActiveChart.Legend.AutoScaleFont",false); //Black
+        mp_exlObject->setProperty(pChart,"HasLegend",true);
+        mp_exlObject->setProperty(pChart,"Legend.Font.Name","Arial");
+        mp_exlObject->setProperty(pChart,"Legend.Font.Size",8);
+        mp_exlObject->setProperty(pChart,"Legend.IncludeInLayout",false);
+        mp_exlObject->setProperty(pChart,"Legend.Position",xlLegendPositionRight);
+        mp_exlObject->setProperty(pChart,"Legend.Format.Fill.Visible",true);
+        mp_exlObject->setProperty(pChart,"Legend.Format.Fill.ForeColor.ObjectThemeColor",msoThemeColorBackground1);
+        mp_exlObject->setProperty(pChart,"Legend.Format.Fill.ForeColor.TintAndShade",true);
+        mp_exlObject->setProperty(pChart,"Legend.Format.Fill.ForeColor.Brightness",0);
+        mp_exlObject->setProperty(pChart,"Legend.Format.Fill.Transparency",0);
+        mp_exlObject->setProperty(pChart,"Legend.Interior.PatternColorIndex",2);//white
+        mp_exlObject->setProperty(pChart,"Legend.Interior.Pattern",xlSolid);//white
+        mp_exlObject->setProperty(pChart,"Legend.Border.Weight",xlHairLine);
+        mp_exlObject->setProperty(pChart,"Legend.Border.ColorIndex",1); //Black
+        mp_exlObject->setProperty(pChart,"Legend.AutoScaleFont",false); //Black
     }
-
-    return pObj;
 }
 
+/****************************************************************************
+ * @function name: Excel::SetChartData()
+ * @param:
+ *      AxObject::Class chart - chart shape returned by CreateChart or chart
+ *      const QString &range - cells of current sheet with chart data
+ * @description: source data of existing chart is replaced
+ * @return: ( bool )  success = true
+ ****************************************************************************/
 bool Excel::SetChartData(AxObject::Class chart, const QString &range)
 {
-    return false;
+    if(!m_opened || chart == 0) return false;
+    mp_exlObject->clearBag();
+
+    // for chart object itself query returns chart
+    AxObject::Class pChart = mp_exlObject->queryObject(chart, "Chart");
+    AxObject::Class pRange = mp_exlObject->queryObject(currentSheet(), QString("Range(\"%1\")").arg(range));
+    if(pRange == currentSheet()) return false;
+
+    return mp_exlObject->dynamicCall(pChart,"SetSourceData",0, AxObjectType(DISPATCH,(quint32)pRange),2);
+}
+
+
+/****************************************************************************
+ * @function name: LiveSeries::LiveSeries()
+ * @param:
+ *      Excel *pexcel - excel
+ *      AxObject::Class chart - chart shape returned by CreateChart or chart
+ *      int series - 1-based series index, new series is added when missing
+ * @description: series handle is kept, chart is not rebuilt on updates.
+ *               Valid series is registered with excel, like Table.
+ ****************************************************************************/
+Excel::LiveSeries::LiveSeries(Excel *pexcel, AxObject::Class chart, int series)
+{
+    mp_excel = pexcel;
+    m_series = 0;
+    m_fps = 10;
+    m_window = 10000;
+    m_decimation = ExcelDecimate::Lttb;
+    m_maxPoints = 1000;
+    m_pending = 0;
+    m_frames = 0;
+
+    if(mp_excel == 0 || chart == 0 || mp_excel->object() == 0) return;
+    AxObject *pobj = mp_excel->object();
+    pobj->clearBag();
+
+    AxObject::Class pChart = pobj->queryObject(chart, "Chart");
+    QVariant var;
+    if(pobj->property(pChart,"SeriesCollection.Count",&var) && var.toInt() >= series)
+    {
+        AxObject::Class pSeries = pobj->queryObject(pChart, QString("SeriesCollection(%1)").arg(series));
+        if(pSeries != pChart) m_series = pSeries;
+    }
+    else if(pobj->dynamicCall(pChart,"SeriesCollection.NewSeries",&var))
+    {
+        m_series = var.toInt();
+    }
+    if(m_series) mp_excel->m_liveSeries.append(this);
+    else mp_excel = 0;
+}
+
+Excel::LiveSeries::~LiveSeries()
+{
+    // excel detaches series on close and destruction
+    if(mp_excel){
+        redraw();
+        mp_excel->m_liveSeries.removeAll(this);
+    }
+}
+
+void Excel::LiveSeries::setFrameRate(double fps)
+{
+    m_fps = fps;
+}
+
+void Excel::LiveSeries::setDecimation(ExcelDecimate::Mode mode, int max_points)
+{
+    m_decimation = mode;
+    m_maxPoints = max_points;
+}
+
+void Excel::LiveSeries::append(double x, double y)
+{
+    if(!m_streamTimer.isValid()) m_streamTimer.start();
+    m_x.append(x);
+    m_y.append(y);
+    m_pending++;
+    redrawIfDue();
+}
+
+void Excel::LiveSeries::append(const QVector<double> &x, const QVector<double> &y)
+{
+    if(!m_streamTimer.isValid()) m_streamTimer.start();
+    const int count = qMin(x.size(), y.size());
+    m_x += x.mid(0, count);
+    m_y += y.mid(0, count);
+    m_pending += count;
+    redrawIfDue();
+}
+
+void Excel::LiveSeries::clear()
+{
+    m_x.clear();
+    m_y.clear();
+    m_pending = 1;
+    redraw();
+}
+
+void Excel::LiveSeries::redrawIfDue()
+{
+    // points out of window are dropped in chunks, not on every append
+    if(m_window > 0 && m_x.size() > 2*m_window)
+    {
+        m_x.remove(0, m_x.size() - m_window);
+        m_y.remove(0, m_y.size() - m_window);
+    }
+
+    const int msec = msecToFrame();
+    if(msec > 0 && mp_excel) mp_excel->scheduleSeriesRedraw(msec);
+    else redraw();
+}
+
+// time left until next frame may be put, 0 - due now
+int Excel::LiveSeries::msecToFrame() const
+{
+    if(m_fps <= 0 || !m_frameTimer.isValid()) return 0;
+    return qMax(0, (int)std::ceil(1000.0/m_fps - m_frameTimer.elapsed()));
+}
+
+/****************************************************************************
+ * @function name: LiveSeries::redraw()
+ * @description: window of points is decimated and put to XValues/Values
+ *               with screen updating off, excel repaints once when it is
+ *               switched on again. Screen updating switched off by caller
+ *               stays off.
+ * @return: ( bool )  success = true
+ ****************************************************************************/
+bool Excel::LiveSeries::redraw()
+{
+    if(m_series == 0 || m_pending == 0) return false;
+    m_frameTimer.start();
+
+    const int first = (m_window > 0) ? qMax(0, m_x.size() - m_window) : 0;
+    QVector<double> xs, ys;
+    ExcelDecimate::decimateToLength(m_decimation, m_x.mid(first), m_y.mid(first), m_maxPoints
+                                    , ExcelDecimate::MaxSeriesLiteral, &xs, &ys);
+
+    AxObject *pobj = mp_excel->object();
+    pobj->clearBag();
+    const bool updating = mp_excel->screenUpdate();
+    if(updating) mp_excel->setScreenUpdate(false);
+    bool result = pobj->setPropertyVector(m_series,"XValues",xs)
+            && pobj->setPropertyVector(m_series,"Values",ys);
+    if(updating) mp_excel->setScreenUpdate(true);
+
+    m_pending = 0;
+    m_frames++;
+    return result;
+}
+
+double Excel::LiveSeries::framesPerSecond() const
+{
+    if(!m_streamTimer.isValid() || m_streamTimer.elapsed() == 0) return 0;
+    return 1000.0*m_frames/m_streamTimer.elapsed();
+}
+
+
+/****************************************************************************
+ * @function name: RingRegion::RingRegion()
+ * @param:
+ *      Excel *pexcel - excel
+ *      const Rect &rect - region on current sheet, height is ring capacity
+ * @description: region is registered with excel, like Table
+ ****************************************************************************/
+Excel::RingRegion::RingRegion(Excel *pexcel, const Excel::Rect &rect)
+{
+    mp_excel = pexcel;
+    m_range = 0;
+    if(mp_excel){
+        mp_excel->m_rings.append(this);
+        m_sheetName = mp_excel->mp_xlsx ? mp_excel->mp_xlsx->currentSheet() : mp_excel->m_sheetname;
+        if(mp_excel->object())
+            m_range = mp_excel->object()->queryObject(mp_excel->currentSheet()
+                                                      , QString("Range(\"%1\")").arg(rect.toRange()));
+    }
+    m_rect = rect;
+    m_ring.resize(qMax(0, rect.height()));
+    m_total = 0;
+    m_flushed = 0;
+    m_dropped = 0;
+    m_rowsWritten = 0;
+    m_hz = 10;
+    m_rotated = false;
+    m_markerSlot = -1;
+}
+
+Excel::RingRegion::~RingRegion()
+{
+    // excel detaches regions on close and destruction
+    if(mp_excel){
+        flush();
+        mp_excel->m_rings.removeAll(this);
+    }
+}
+
+void Excel::RingRegion::setHeadMarker(const QColor &marker, const QColor &background)
+{
+    m_marker = marker;
+    m_markerBackground = background;
+}
+
+/****************************************************************************
+ * @function name: RingRegion::append()
+ * @param:
+ *      const QVariantList &row - sample, values of row
+ * @description: sample is stored to ring, region is refreshed when refresh
+ *               period elapsed. Cost does not depend on capacity.
+ * @return: ( bool ) false when refresh failed
+ ****************************************************************************/
+bool Excel::RingRegion::append(const QVariantList &row)
+{
+    const int cap = capacity();
+    if(cap <= 0) return false;
+
+    m_ring[m_total % cap] = row;
+    m_total++;
+    // oldest pending sample was overwritten before excel got it
+    if(m_total - m_flushed > cap)
+    {
+        m_flushed++;
+        m_dropped++;
+    }
+
+    const int msec = msecToRefresh();
+    if(msec <= 0) return flush();
+    if(mp_excel) mp_excel->scheduleRingFlush(msec);
+    return true;
+}
+
+// time left until next refresh may be written, 0 - due now
+int Excel::RingRegion::msecToRefresh() const
+{
+    if(m_hz <= 0 || !m_refreshTimer.isValid()) return 0;
+    return qMax(0, (int)std::ceil(1000.0/m_hz - m_refreshTimer.elapsed()));
+}
+
+/****************************************************************************
+ * @function name: RingRegion::flush()
+ * @description: pending samples are written now. Wrapped mode writes the
+ *               changed slots only, rotated mode writes whole region.
+ * @return: ( bool )  success = true
+ ****************************************************************************/
+bool Excel::RingRegion::flush()
+{
+    const int cap = capacity();
+    if(mp_excel == 0 || cap <= 0 || m_total == m_flushed) return true;
+    m_refreshTimer.start();
+
+    bool result = true;
+    if(m_rotated)
+    {
+        result = writeSlots(0, cap);
+    }
+    else
+    {
+        const int first = m_flushed % cap;
+        const int count = (int)(m_total - m_flushed);
+        const int tail = qMin(count, cap - first);
+        result = writeSlots(first, tail);
+        if(result && count > tail)
+            result = writeSlots(0, count - tail);
+        if(result) result = moveMarker();
+    }
+
+    if(result) m_flushed = m_total;
+    return result;
+}
+
+// slots [first, first+count) are written as one block, in rotated mode
+// slot index is row of display and oldest sample is on top
+bool Excel::RingRegion::writeSlots(int first, int count)
+{
+    const int cap = capacity();
+    const int width = m_rect.width();
+    const int shown = this->count();
+    const int oldest = (int)((m_total - shown) % cap);
+
+    QVariantList block;
+    block.reserve(count*width);
+    for(int i=first; i<first+count; i++)
+    {
+        QVariantList row;
+        if(!m_rotated) row = m_ring[i];
+        else if(i < shown) row = m_ring[(oldest + i) % cap];
+
+        for(int j=0; j<width; j++)
+            block.append(j < row.size() ? row[j] : QVariant(QString("")));
+    }
+
+    bool result = false;
+    if(mp_excel->mp_xlsx)
+    {
+        ExcelXlsxWriter *pxlsx = mp_excel->mp_xlsx;
+        const QString current = pxlsx->currentSheet();
+        if(!m_sheetName.isEmpty()) pxlsx->setCurrentSheet(m_sheetName);
+        result = mp_excel->SetDataToRange(Rect(m_rect.x(), m_rect.y() + first, width, count), block);
+        if(!current.isEmpty()) pxlsx->setCurrentSheet(current);
+    }
+    else if(m_range)
+    {
+        // rows relative to top left cell of region
+        mp_excel->flushCombined();
+        mp_excel->sheetDataChanged(m_sheetName, Rect(m_rect.x(), m_rect.y() + first, width, count));
+        result = mp_excel->mp_exlObject->setPropertyBlock(m_range
+                      , QString("Range(\"%1\").Value").arg(Rect(0, first, width, count).toRange()), block, width, count);
+    }
+    if(!result) return false;
+    m_rowsWritten += count;
+    return true;
+}
+
+// background of ring slot on region's sheet, text black
+bool Excel::RingRegion::paintSlot(int slot, const QColor &background)
+{
+    if(mp_excel->mp_xlsx)
+    {
+        ExcelXlsxWriter *pxlsx = mp_excel->mp_xlsx;
+        const QString current = pxlsx->currentSheet();
+        if(!m_sheetName.isEmpty()) pxlsx->setCurrentSheet(m_sheetName);
+        const bool result = mp_excel->setColor(m_rect.row(slot), background, Qt::black);
+        if(!current.isEmpty()) pxlsx->setCurrentSheet(current);
+        return result;
+    }
+    if(!m_range) return false;
+    const QString range = Rect(0, slot, m_rect.width(), 1).toRange();
+    AxObject *pobj = mp_excel->object();
+    return pobj->setProperty(m_range, QString("Range(\"%1\").Interior.Color").arg(range), toXlColor(background))
+            && pobj->setProperty(m_range, QString("Range(\"%1\").Font.Color").arg(range), toXlColor(Qt::black));
+}
+
+bool Excel::RingRegion::moveMarker()
+{
+    if(!m_marker.isValid()) return true;
+    const int head = (int)((m_total - 1) % capacity());
+    if(head == m_markerSlot) return true;
+
+    bool result = true;
+    if(m_markerSlot >= 0)
+        result = paintSlot(m_markerSlot, m_markerBackground);
+    result = paintSlot(head, m_marker) && result;
+    m_markerSlot = head;
+    return result;
 }
 
 
@@ -791,118 +2041,1378 @@ bool Excel::read(qint32 row, qint32 col, QVariant &data)
     bool result = false;
     if (m_opened && row > 0 && col > 0 )
     {
+        // read your writes, held value is newest
+        const int held = m_combiner.indexOf(row, col);
+        if(held >= 0)
+        {
+            data = m_combiner.values[held];
+            return true;
+        }
+        flushCombined();
+
+        if(m_readCacheEnabled)
+        {
+            const QString name = currentSheetName();
+            QHash<QString, ReadGrid>::iterator grid = m_readGrids.find(name);
+            if(grid == m_readGrids.end() && !name.isEmpty())
+            {
+                ReadGrid loaded;
+                if(loadReadGrid(&loaded)) grid = m_readGrids.insert(name, loaded);
+            }
+            if(grid != m_readGrids.end())
+            {
+                // cells out of used range are empty
+                const Rect &rect = grid->rect;
+                const int x = col - 1 - rect.x();
+                const int y = row - 1 - rect.y();
+                const bool inside = x >= 0 && y >= 0 && x < rect.width() && y < rect.height();
+                const int chunk = inside ? y/grid->chunkRows : 0;
+                if(!inside || grid->loaded[chunk] || loadReadChunk(&grid.value(), chunk))
+                {
+                    data = inside ? grid->get(y*rect.width() + x) : QVariant();
+                    m_readHits++;
+                    return true;
+                }
+            }
+            m_readMisses++;
+        }
         result = mp_exlObject->property(this->mp_currentSheet, QString("Cells( %1, %2).Value").arg(row).arg(col),&data);
     }
     return result;
 }
 
-void Excel::setAutoSaveOn(bool on)
+// box saves call_cost per call it replaces, pays cells read in vain
+class GatherMerger : public ExcelRectMerger
 {
-    m_autosave = on;
+public:
+    explicit GatherMerger(int call_cost) : ExcelRectMerger(call_cost), m_callCost(call_cost) {}
+
+protected:
+    qint64 gain(const Excel::Rect &box, qint64 inside, int count, bool) const
+    {
+        return qint64(count - 1)*m_callCost - (box.area() - inside);
+    }
+
+private:
+    int m_callCost;
+};
+
+/****************************************************************************
+ * @function name: Excel::planGather()
+ * @param:
+ *      const QList<Cell> &cells - requested cells
+ *      int call_cost - price of one call counted in transferred cells
+ * @description: starts from exact rectangles of cells and merges the pair
+ *               whose bounding box saves most: call_cost per call dropped
+ *               against cells added. Pairs closer than call_cost cells are
+ *               examined only.
+ * @return: ( QList<Rect> ) rectangles covering all cells
+ ****************************************************************************/
+QList<Excel::Rect> Excel::planGather(const QList<Cell> &cells, int call_cost)
+{
+    const QList<Rect> rects = ExcelRangeSet::fromCells(cells).rects();
+    if(rects.count() < 2 || call_cost <= 0) return rects;
+    GatherMerger merger(call_cost);
+    return merger.merge(rects);
 }
 
-bool Excel::readRange(const QString &range, QVariantList *presult)
+/****************************************************************************
+ * @function name: Excel::readCells()
+ * @param:
+ *      const QList<Cell> &cells - cells of current sheet, any order
+ *      QVariantList *presult - Value2 of cells in order of cells
+ *      int call_cost - price of one call counted in transferred cells
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool Excel::readCells(const QList<Cell> &cells, QVariantList *presult, int call_cost)
 {
-    QVariant data;
-    bool r= mp_exlObject->property(this->mp_currentSheet,QString("Range(\"%1\").Value").arg(range),&data);
-    if(presult) *presult = data.toList();
-    return r;
+    flushCombined();
+    if(!m_opened || presult == 0) return false;
+    presult->clear();
+    if(cells.isEmpty()) return true;
+
+    QHash<quint64, QVariant> values;
+    bool result = true;
+    mp_exlObject->clearBag();
+    foreach(const Rect &rect, planGather(cells, call_cost))
+    {
+        QVariant data;
+        if(!mp_exlObject->property(currentSheet(), QString("Range(\"%1\").Value2").arg(rect.toRange()), &data))
+        {
+            result = false;
+            continue;
+        }
+
+        if(rect.width() == 1 && rect.height() == 1)
+        {
+            values.insert((quint64(rect.y()) << 32) | quint32(rect.x()), data);
+            continue;
+        }
+        const QVariantList rows = data.toList();
+        for(int r=0; r<rows.count() && r<rect.height(); r++)
+        {
+            const QVariantList cols = rows[r].toList();
+            for(int c=0; c<cols.count() && c<rect.width(); c++)
+                values.insert((quint64(rect.y() + r) << 32) | quint32(rect.x() + c), cols[c]);
+        }
+    }
+
+    foreach(const Cell &cell, cells)
+        presult->append(values.value((quint64(cell.y()) << 32) | quint32(cell.x())));
+    return result;
 }
 
-bool Excel::writeRange(const QString &range, QVariantList l)
+void Excel::setReadCacheEnabled(bool on)
 {
-    // TODO
-    return false;
+    m_readCacheEnabled = on;
+    if(!on) m_readGrids.clear();
 }
 
-bool Excel::setRangeAlignment(const QString &range, unsigned int align)
+bool Excel::refreshReadCache()
 {
-    if(m_opened && Range_Is_Valid(range)){
-        return  mp_exlObject->setProperty(mp_currentSheet, QString("Range(\"%1\").HorizontalAlignment").arg(range), xlCenter);
+    if(!m_readCacheEnabled || !m_opened)
+    {
+        m_readGrids.clear();
+        return false;
     }
-    return false;
+    const QString name = currentSheetName();
+    m_readGrids.remove(name);
+    ReadGrid grid;
+    if(name.isEmpty() || !loadReadGrid(&grid)) return false;
+    m_readGrids.insert(name, grid);
+    return true;
 }
 
-bool Excel::drawFrame(const Rect &rect, const Frame &f){    
-    return drawFrame(rect.toRange(),f);
+double Excel::readCacheHitRate() const
+{
+    const qint64 total = m_readHits + m_readMisses;
+    return total ? double(m_readHits)/total : 0;
 }
 
-bool Excel::drawFrame(const QString &range , const Frame &f)
+qint64 Excel::readCacheCells() const
 {
-    mp_exlObject->clearBag();
-    if(m_opened){
-        for(int i=0;i<5;i++)
-        {
-            if(f.drawLine(i))
-            {
-                const int xlBorders[] = {9,7,10,8,12,11};
-                const int xlStyles[] = { -4142,1,-4119};
-                const int xlWidth[] = {1, -4138 ,4, 2};
+    qint64 cells = 0;
+    foreach(const ReadGrid &grid, m_readGrids)
+        cells += grid.types.size();
+    return cells;
+}
+
+qint64 Excel::readCacheBytes() const
+{
+    qint64 bytes = 0;
+    foreach(const ReadGrid &grid, m_readGrids)
+    {
+        bytes += grid.types.size()*(sizeof(quint8) + sizeof(double));
+        foreach(const QString &text, grid.texts)
+            bytes += text.size()*sizeof(QChar) + sizeof(int);
+    }
+    return bytes;
+}
 
-                mp_exlObject->setProperty(currentSheet(), QString("Range(\"%1\").Borders(%2).LineStyle")
-                                          .arg(range).arg(xlBorders[i]), xlStyles[f.style(i)]);
+/****************************************************************************
+ * @function name: Excel::loadReadGrid()
+ * @param:
+ *      ReadGrid *pgrid - output
+ * @description: used range of current sheet is set up, chunks of rows,
+ *               about 64k cells each, are read on first use. Sheet is
+ *               asked once whether it has formulas.
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool Excel::loadReadGrid(ReadGrid *pgrid)
+{
+    mp_exlObject->clearBag();
+    const Rect rect = Range_To_Rect(usedRange());
+    if(rect.width() <= 0 || rect.height() <= 0) return false;
+
+    pgrid->rect = rect;
+    pgrid->chunkRows = qMax(1, 65536/rect.width());
+    pgrid->loaded.fill(false, (rect.height() + pgrid->chunkRows - 1)/pgrid->chunkRows);
+    pgrid->types.fill(QVariant::Invalid, rect.width()*rect.height());
+    pgrid->numbers.fill(0, rect.width()*rect.height());
+    pgrid->texts.clear();
+
+    // false - no formula, true or null (mixed) - some
+    QVariant var;
+    pgrid->formulas = !mp_exlObject->property(currentSheet(), "UsedRange.HasFormula", &var)
+            || var.type() != QVariant::Bool || var.toBool();
+    return true;
+}
+
+/****************************************************************************
+ * @function name: Excel::loadReadChunk()
+ * @param:
+ *      ReadGrid *pgrid - grid of current sheet
+ *      int chunk - index of chunk of rows
+ * @description: Value of chunk is read by one call
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool Excel::loadReadChunk(ReadGrid *pgrid, int chunk)
+{
+    const Rect &rect = pgrid->rect;
+    const int y = chunk*pgrid->chunkRows;
+    const Rect part(rect.x(), rect.y() + y, rect.width(), qMin(pgrid->chunkRows, rect.height() - y));
+    QVariant data;
+    mp_exlObject->clearBag();
+    if(!mp_exlObject->property(currentSheet(), QString("Range(\"%1\").Value").arg(part.toRange()), &data))
+        return false;
+
+    if(part.width() == 1 && part.height() == 1)
+    {
+        pgrid->set(y*rect.width(), data);
+        pgrid->loaded[chunk] = true;
+        return true;
+    }
+    // one row part comes as 2D array too
+    const QVariantList rows = data.toList();
+    for(int r=0; r<rows.count() && r<part.height(); r++)
+    {
+        const QVariantList cols = rows[r].toList();
+        const int base = (y + r)*rect.width();
+        for(int c=0; c<cols.count() && c<rect.width(); c++)
+            pgrid->set(base + c, cols[c]);
+    }
+    pgrid->loaded[chunk] = true;
+    return true;
+}
+
+void Excel::ReadGrid::set(int index, const QVariant &data)
+{
+    types[index] = (quint8)data.type();
+    switch(data.type())
+    {
+    case QVariant::Invalid:
+        break;
+    case QVariant::Bool:
+    case QVariant::Double:
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+        numbers[index] = data.toDouble();
+        break;
+    case QVariant::Date:
+        numbers[index] = data.toDate().toJulianDay();
+        break;
+    case QVariant::Time:
+        numbers[index] = QTime(0, 0).msecsTo(data.toTime());
+        break;
+    case QVariant::DateTime:
+        numbers[index] = data.toDateTime().toMSecsSinceEpoch();
+        break;
+    default:
+        types[index] = (quint8)QVariant::String;
+        texts.insert(index, data.toString());
+        return;
+    }
+    texts.remove(index);
+}
+
+QVariant Excel::ReadGrid::get(int index) const
+{
+    const double n = numbers[index];
+    switch(types[index])
+    {
+    case QVariant::Bool: return n != 0;
+    case QVariant::Double: return n;
+    case QVariant::Int: return (int)n;
+    case QVariant::UInt: return (uint)n;
+    case QVariant::LongLong: return (qlonglong)n;
+    case QVariant::ULongLong: return (qulonglong)n;
+    case QVariant::Date: return QDate::fromJulianDay((qint64)n);
+    case QVariant::Time: return QTime(0, 0).addMSecs((int)n);
+    case QVariant::DateTime: return QDateTime::fromMSecsSinceEpoch((qint64)n);
+    case QVariant::String: return texts.value(index);
+    default: return QVariant();
+    }
+}
+
+void Excel::setAutoSaveOn(bool on)
+{
+    m_autosave = on;
+}
+
+bool Excel::readRange(const QString &range, QVariantList *presult)
+{
+    flushCombined();
+    if(!m_opened) return false;
+    QVariant data;
+    bool r= mp_exlObject->property(this->mp_currentSheet,QString("Range(\"%1\").Value").arg(range),&data);
+    if(presult) *presult = data.toList();
+    return r;
+}
+
+bool Excel::writeRange(const QString &range, QVariantList l)
+{
+    // TODO
+    return false;
+}
+
+bool Excel::setRangeAlignment(const QString &range, unsigned int align)
+{
+    if(m_opened && Range_Is_Valid(range)){
+        return  mp_exlObject->setProperty(mp_currentSheet, QString("Range(\"%1\").HorizontalAlignment").arg(range), xlCenter);
+    }
+    return false;
+}
+
+bool Excel::drawFrame(const Rect &rect, const Frame &f){    
+    if(mp_xlsx) return xlsxFrame(rect, f);
+    if(m_framesBuffered){
+        m_framePlanner.add(rect, f);
+        return m_opened;
+    }
+    return drawFrame(rect.toRange(),f);
+}
+
+bool Excel::drawFrame(const QString &range , const Frame &f)
+{
+    if(mp_xlsx) return xlsxFrame(Range_To_Rect(range), f);
+    if(m_framesBuffered){
+        const Rect rect = Range_To_Rect(range);
+        if(rect.width() > 0 && rect.height() > 0){
+            m_framePlanner.add(rect, f);
+            return m_opened;
+        }
+    }
+
+    mp_exlObject->clearBag();
+    if(m_opened) return putFrame(currentSheet(), range, f);
+    return false;
+}
+
+/****************************************************************************
+ * @function name: Excel::putFrame()
+ * @param:
+ *    AxObject::Class parent - sheet or range object
+ *    const QString &range - range relative to parent
+ *    const Frame &f
+ * @description: border lines of frame put directly, without planner
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool Excel::putFrame(AxObject::Class parent, const QString &range, const Frame &f)
+{
+    for(int i=0;i<6;i++)
+    {
+        if(f.drawLine(i))
+        {
+            const int xlBorders[] = {9,7,10,8,12,11};
+            const int xlStyles[] = { -4142,1,-4119};
+            const int xlWidth[] = {1, -4138 ,4, 2};
+
+            mp_exlObject->setProperty(parent, QString("Range(\"%1\").Borders(%2).LineStyle")
+                                      .arg(range).arg(xlBorders[i]), xlStyles[f.style(i)]);
+
+            if( f.style(i) != Frame::LineDouble)
+                mp_exlObject->setProperty(parent, QString("Range(\"%1\").Borders(%2).Weight")
+                                          .arg(range).arg(xlBorders[i]), xlWidth[f.width(i)]);
+        }
+    }
+    return true;
+}
+
+
+
+ExcelXlsxWriter::Style Excel::xlsxStyle(const CellStyle &style)
+{
+    ExcelXlsxWriter::Style result;
+    if(style.hasFont()) result.setFont(style.font());
+    if(style.hasBackground()) result.setBackground(style.background());
+    if(style.hasForeground()) result.setForeground(style.foreground());
+    return result;
+}
+
+// frame lines as cell borders of xlsx backend
+bool Excel::xlsxFrame(const Rect &rect, const Frame &f)
+{
+    if(rect.width() <= 0 || rect.height() <= 0) return false;
+    const int widths[] = {ExcelXlsxWriter::LineHair, ExcelXlsxWriter::LineMedium
+                          , ExcelXlsxWriter::LineThick, ExcelXlsxWriter::LineThin};
+    int lines[6];
+    for(int i=0; i<6; i++)
+    {
+        if(!f.drawLine(i) || f.style(i) == Frame::LineNone) lines[i] = ExcelXlsxWriter::LineNone;
+        else if(f.style(i) == Frame::LineDouble) lines[i] = ExcelXlsxWriter::LineDouble;
+        else lines[i] = widths[f.width(i)];
+    }
+    int outer[4];
+    outer[ExcelXlsxWriter::Left] = lines[Frame::Left];
+    outer[ExcelXlsxWriter::Right] = lines[Frame::Right];
+    outer[ExcelXlsxWriter::Top] = lines[Frame::Top];
+    outer[ExcelXlsxWriter::Bottom] = lines[Frame::Bottom];
+    return mp_xlsx->setBorders(QRect(rect.x(), rect.y(), rect.width(), rect.height())
+                               , outer, lines[Frame::Horizontal], lines[Frame::Vertical]);
+}
+
+void Excel::beginFrames()
+{
+    m_framesBuffered = true;
+}
+
+bool Excel::flushFrames()
+{
+    m_framesBuffered = false;
+    if(m_framePlanner.isEmpty()) return true;
+    const bool result = drawFrames(m_framePlanner);
+    m_framePlanner.clear();
+    return result;
+}
+
+/****************************************************************************
+ * @function name: Excel::drawFrames()
+ * @param:
+ *    const BorderPlanner &planner - frames of current sheet
+ * @description: executes resolved border operations, frame around area is
+ *               one BorderAround call, edge and inside lines are
+ *               LineStyle and Weight puts
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool Excel::drawFrames(const BorderPlanner &planner)
+{
+    if(!m_opened) return false;
+    mp_exlObject->clearBag();
+
+    const int xlStyles[] = { xlLineStyleNone, xlContinuous, xlDouble};
+    const int xlWidth[] = {xlHairLine, xlMedium, xlThick, xlThin};
+
+    bool result = true;
+    const AxObject::Class sheet = currentSheet();
+    foreach(const BorderPlanner::Operation &op, planner.plan())
+    {
+        const QString range = QString("Range(\"%1\")").arg(op.rect.toRange());
+        if(op.border == BorderPlanner::BorderAround)
+        {
+            if(op.style == Frame::LineContinuous)
+                result &= mp_exlObject->dynamicCall(sheet, range + ".BorderAround", 0
+                                                    , xlStyles[op.style], xlWidth[op.width]);
+            else
+                result &= mp_exlObject->dynamicCall(sheet, range + ".BorderAround", 0, xlStyles[op.style]);
+        }
+        else
+        {
+            result &= mp_exlObject->setProperty(sheet, QString("%1.Borders(%2).LineStyle")
+                                                .arg(range).arg(op.border), xlStyles[op.style]);
+            if(op.style == Frame::LineContinuous)
+                result &= mp_exlObject->setProperty(sheet, QString("%1.Borders(%2).Weight")
+                                                    .arg(range).arg(op.border), xlWidth[op.width]);
+        }
+    }
+    return result;
+}
+
+
+// border line piece [a,b) along one row or column boundary
+struct BorderSegment
+{
+    int a;
+    int b;
+    int style;
+    int width;  // -1 when style has no weight
+};
+typedef QList<BorderSegment> BorderLine;
+typedef QMap<int, BorderLine> BorderLines; // boundary index -> segments
+
+static bool segmentLess(const BorderSegment &s1, const BorderSegment &s2)
+{
+    return s1.a < s2.a;
+}
+
+// paints [a,b) over line, style -1 erases
+static void paintLine(BorderLine &line, int a, int b, int style, int width)
+{
+    BorderLine result;
+    foreach(const BorderSegment &seg, line)
+    {
+        if(seg.b <= a || seg.a >= b){
+            result.append(seg);
+            continue;
+        }
+        if(seg.a < a){
+            BorderSegment left = seg;
+            left.b = a;
+            result.append(left);
+        }
+        if(seg.b > b){
+            BorderSegment right = seg;
+            right.a = b;
+            result.append(right);
+        }
+    }
+    if(style >= 0){
+        BorderSegment seg = {a, b, style, width};
+        result.append(seg);
+    }
+    std::sort(result.begin(), result.end(), segmentLess);
+
+    // join touching pieces of the same line
+    line.clear();
+    foreach(const BorderSegment &seg, result)
+    {
+        if(!line.isEmpty() && line.last().b == seg.a
+                && line.last().style == seg.style && line.last().width == seg.width)
+            line.last().b = seg.b;
+        else
+            line.append(seg);
+    }
+}
+
+static void eraseLine(BorderLines &lines, int k, int a, int b)
+{
+    if(!lines.contains(k)) return;
+    paintLine(lines[k], a, b, -1, -1);
+    if(lines[k].isEmpty()) lines.remove(k);
+}
+
+static bool lineValueAt(const BorderLines &lines, int k, int pos, int *pstyle, int *pwidth)
+{
+    foreach(const BorderSegment &seg, lines.value(k))
+    {
+        if(seg.a <= pos && pos < seg.b){
+            *pstyle = seg.style;
+            *pwidth = seg.width;
+            return true;
+        }
+    }
+    return false;
+}
+
+// [a,b) is drawn completely with one style
+static bool lineCovered(const BorderLines &lines, int k, int a, int b, int style, int width)
+{
+    int pos = a;
+    foreach(const BorderSegment &seg, lines.value(k))
+    {
+        if(seg.b <= pos) continue;
+        if(seg.a > pos || seg.style != style || seg.width != width) return false;
+        pos = seg.b;
+        if(pos >= b) return true;
+    }
+    return pos >= b;
+}
+
+struct BorderPiece
+{
+    int k;
+    BorderSegment seg;
+};
+
+static bool pieceLess(const BorderPiece &p1, const BorderPiece &p2)
+{
+    if(p1.seg.a != p2.seg.a) return p1.seg.a < p2.seg.a;
+    if(p1.seg.b != p2.seg.b) return p1.seg.b < p2.seg.b;
+    if(p1.seg.style != p2.seg.style) return p1.seg.style < p2.seg.style;
+    if(p1.seg.width != p2.seg.width) return p1.seg.width < p2.seg.width;
+    return p1.k < p2.k;
+}
+
+// remaining pieces become edge lines, equal pieces on consecutive
+// boundaries become one inside line of the area between them
+static void planLeftovers(const BorderLines &lines, bool horizontal, QList<Excel::BorderPlanner::Operation> &ops)
+{
+    QList<BorderPiece> pieces;
+    foreach(int k, lines.keys())
+    {
+        foreach(const BorderSegment &seg, lines[k])
+        {
+            BorderPiece piece = {k, seg};
+            pieces.append(piece);
+        }
+    }
+    std::sort(pieces.begin(), pieces.end(), pieceLess);
+
+    int i = 0;
+    while(i < pieces.count())
+    {
+        const BorderSegment &seg = pieces[i].seg;
+        const int k0 = pieces[i].k;
+        int n = 1;
+        while(i + n < pieces.count()
+              && pieces[i+n].k == k0 + n
+              && pieces[i+n].seg.a == seg.a && pieces[i+n].seg.b == seg.b
+              && pieces[i+n].seg.style == seg.style && pieces[i+n].seg.width == seg.width)
+            n++;
+
+        Excel::BorderPlanner::Operation op;
+        op.style = seg.style;
+        op.width = seg.width;
+        if(n >= 2 && k0 >= 1)
+        {
+            op.border = horizontal ? xlInsideHorizontal : xlInsideVertical;
+            op.rect = horizontal ? Excel::Rect(seg.a, k0 - 1, seg.b - seg.a, n + 1)
+                                 : Excel::Rect(k0 - 1, seg.a, n + 1, seg.b - seg.a);
+            ops.append(op);
+        }
+        else
+        {
+            for(int k = k0; k < k0 + n; k++)
+            {
+                // line above row k is bottom of row k-1, first row has only top
+                const int cell = k > 0 ? k - 1 : 0;
+                if(horizontal){
+                    op.border = k > 0 ? xlEdgeBottom : xlEdgeTop;
+                    op.rect = Excel::Rect(seg.a, cell, seg.b - seg.a, 1);
+                }
+                else{
+                    op.border = k > 0 ? xlEdgeRight : xlEdgeLeft;
+                    op.rect = Excel::Rect(cell, seg.a, 1, seg.b - seg.a);
+                }
+                ops.append(op);
+            }
+        }
+        i += n;
+    }
+}
+
+void Excel::BorderPlanner::add(const Rect &rect, const Frame &frame)
+{
+    if(rect.width() <= 0 || rect.height() <= 0) return;
+    Request request;
+    request.rect = rect;
+    request.frame = frame;
+    m_requests.append(request);
+}
+
+/****************************************************************************
+ * @function name: Excel::BorderPlanner::plan()
+ * @description: frames are painted as line segments on row and column
+ *               boundaries, later frame wins. Complete outlines and inside
+ *               grids of requested areas become BorderAround and inside
+ *               border operations, rest is emitted per edge.
+ * @return: ( QList<Operation> ) border operations
+ ****************************************************************************/
+QList<Excel::BorderPlanner::Operation> Excel::BorderPlanner::plan() const
+{
+    BorderLines horizontal; // row boundary -> column segments
+    BorderLines vertical;   // column boundary -> row segments
+
+    foreach(const Request &request, m_requests)
+    {
+        const int x = request.rect.x();
+        const int y = request.rect.y();
+        const int w = request.rect.width();
+        const int h = request.rect.height();
+        for(int line=0; line<6; line++)
+        {
+            if(!request.frame.drawLine(line)) continue;
+            const int style = request.frame.style(line);
+            const int width = style == Frame::LineContinuous ? request.frame.width(line) : -1;
+            switch(line)
+            {
+            case Frame::Top:
+                paintLine(horizontal[y], x, x + w, style, width);
+                break;
+            case Frame::Bottom:
+                paintLine(horizontal[y + h], x, x + w, style, width);
+                break;
+            case Frame::Left:
+                paintLine(vertical[x], y, y + h, style, width);
+                break;
+            case Frame::Right:
+                paintLine(vertical[x + w], y, y + h, style, width);
+                break;
+            case Frame::Horizontal:
+                for(int k = y + 1; k < y + h; k++)
+                    paintLine(horizontal[k], x, x + w, style, width);
+                break;
+            case Frame::Vertical:
+                for(int k = x + 1; k < x + w; k++)
+                    paintLine(vertical[k], y, y + h, style, width);
+                break;
+            }
+        }
+    }
+
+    QList<Operation> ops;
+    foreach(const Request &request, m_requests)
+    {
+        const int x = request.rect.x();
+        const int y = request.rect.y();
+        const int w = request.rect.width();
+        const int h = request.rect.height();
+        int style, width;
+
+        if(lineValueAt(horizontal, y, x, &style, &width) && style != Frame::LineNone
+                && lineCovered(horizontal, y, x, x + w, style, width)
+                && lineCovered(horizontal, y + h, x, x + w, style, width)
+                && lineCovered(vertical, x, y, y + h, style, width)
+                && lineCovered(vertical, x + w, y, y + h, style, width))
+        {
+            Operation op = {request.rect, BorderAround, style, width};
+            ops.append(op);
+            eraseLine(horizontal, y, x, x + w);
+            eraseLine(horizontal, y + h, x, x + w);
+            eraseLine(vertical, x, y, y + h);
+            eraseLine(vertical, x + w, y, y + h);
+        }
+
+        if(h > 1 && lineValueAt(horizontal, y + 1, x, &style, &width))
+        {
+            bool all = true;
+            for(int k = y + 1; k < y + h && all; k++)
+                all = lineCovered(horizontal, k, x, x + w, style, width);
+            if(all){
+                Operation op = {request.rect, xlInsideHorizontal, style, width};
+                ops.append(op);
+                for(int k = y + 1; k < y + h; k++)
+                    eraseLine(horizontal, k, x, x + w);
+            }
+        }
+
+        if(w > 1 && lineValueAt(vertical, x + 1, y, &style, &width))
+        {
+            bool all = true;
+            for(int k = x + 1; k < x + w && all; k++)
+                all = lineCovered(vertical, k, y, y + h, style, width);
+            if(all){
+                Operation op = {request.rect, xlInsideVertical, style, width};
+                ops.append(op);
+                for(int k = x + 1; k < x + w; k++)
+                    eraseLine(vertical, k, y, y + h);
+            }
+        }
+    }
+
+    planLeftovers(horizontal, true, ops);
+    planLeftovers(vertical, false, ops);
+    return ops;
+}
+
+int Excel::BorderPlanner::callCount(const QList<Operation> &operations)
+{
+    int calls = 0;
+    foreach(const Operation &op, operations)
+    {
+        if(op.border == BorderAround || op.style != Frame::LineContinuous) calls += 1;
+        else calls += 2;
+    }
+    return calls;
+}
+
+
+/****************************************************************************
+ * @function name: ExcelData::setColor()
+ *
+ * @param:
+ *    qint32 i
+ *    qint32 j
+ *    const QColor background
+ *    const QColor foreground
+ * @description: Sets color of background ,foreground cell
+ * @return: ( bool ) - success = true
+ ****************************************************************************/
+bool Excel::setColor(qint32 row, qint32 col, const QColor background, const QColor foreground)
+{
+    if(mp_xlsx) return mp_xlsx->setColor(QRect(col - 1, row - 1, 1, 1), background, foreground);
+    bool result = false;
+    if (m_opened && row > 0 && col > 0 && m_formatBuffered)
+    {
+        CellStyle style;
+        style.setBackground(background);
+        style.setForeground(foreground);
+        result = setCellStyle(row, col, style);
+    }
+    else if (m_opened && row > 0 && col > 0 )
+    {
+        quint32 color;
+        color = (background.red() << 0) | (background.green() << 8) | (background.blue() << 16);
+        result = mp_exlObject->setProperty(currentSheet(), QString("Cells(%1,%2).Interior.Color").arg(row).arg(col), QVariant(color));
+
+        color = (foreground.red() << 0) | (foreground.green() << 8) | (foreground.blue() << 16);
+        result = mp_exlObject->setProperty(currentSheet(), QString("Cells(%1,%2).Font.Color").arg(row).arg(col), QVariant(color));
+        result = true;
+    }
+    return result;
+}
+
+bool Excel::setColor(const Rect &rect, const QColor background, const QColor foreground)
+{
+    return    setColor(rect.toRange(),background,foreground);
+}
+
+bool Excel::setColor(const ExcelRangeSet &cells, const QColor background, const QColor foreground)
+{
+    bool result = !cells.isEmpty();
+    foreach(const QString &range, cells.toRanges())
+        result &= setColor(range, background, foreground);
+    return result;
+}
+
+bool Excel::setColor(const QString &range, const QColor background, const QColor foreground)
+{
+    if(mp_xlsx){
+        const Rect rect = Range_To_Rect(range);
+        return mp_xlsx->setColor(QRect(rect.x(), rect.y(), rect.width(), rect.height()), background, foreground);
+    }
+    bool result = false;
+    if (m_opened && Range_Is_Valid(range) )
+    {
+        quint32 color;
+        color = (background.red() << 0) | (background.green() << 8) | (background.blue() << 16);
+        result = mp_exlObject->setProperty(currentSheet(), QString("Range(\"%1\").Interior.Color").arg(range), QVariant(color));
+
+        color = (foreground.red() << 0) | (foreground.green() << 8) | (foreground.blue() << 16);
+        result = mp_exlObject->setProperty(currentSheet(), QString("Range(\"%1\").Font.Color").arg(range), QVariant(color));
+
+        result = true;
+    }
+    return result;
+}
+
+quint32 Excel::toXlColor(const QColor &color)
+{
+    return (color.red() << 0) | (color.green() << 8) | (color.blue() << 16);
+}
+
+
+/****************************************************************************
+ * @function name: Excel::beginFormat()
+ * @description: starts collecting per cell style intents, nothing is sent
+ *               to excel until flushFormat()
+ ****************************************************************************/
+void Excel::beginFormat()
+{
+    m_formatBuffered = true;
+}
+
+// buffered styles and frames belong to current sheet, apply them before it changes
+void Excel::flushSheetBuffers()
+{
+    if(m_formatBuffered){
+        flushFormat();
+        beginFormat();
+    }
+    if(m_framesBuffered){
+        flushFrames();
+        beginFrames();
+    }
+    flushPosted();
+    flushCombined();
+}
+
+/****************************************************************************
+ * @function name: Excel::beginCoalescing()
+ * @param:
+ *      int tick_msec - period of writing posted values
+ * @description: starts timer writing cells updated by post()
+ ****************************************************************************/
+void Excel::beginCoalescing(int tick_msec)
+{
+    m_postTimer.start(qMax(1, tick_msec));
+}
+
+void Excel::endCoalescing()
+{
+    m_postTimer.stop();
+    flushPosted();
+}
+
+/****************************************************************************
+ * @function name: Excel::post()
+ * @param:
+ *      qint32 row, qint32 col - cell, 1-based
+ *      const QVariant &data - value
+ * @description: value replaces not yet written value of the same cell.
+ *               Only the map is locked, excel is not called.
+ ****************************************************************************/
+void Excel::post(qint32 row, qint32 col, const QVariant &data)
+{
+    if(row <= 0 || col <= 0) return;
+    const quint64 key = (quint64(row - 1) << 32) | quint32(col - 1);
+
+    QMutexLocker locker(&m_postMutex);
+    m_postedCount++;
+    QHash<quint64, QVariant>::iterator it = m_posted.find(key);
+    if(it != m_posted.end()){
+        it.value() = data;
+        m_coalescedCount++;
+    }
+    else m_posted.insert(key, data);
+}
+
+/****************************************************************************
+ * @function name: Excel::flushPosted()
+ * @description: dirty cells are taken under lock, grouped to rectangles
+ *               and every rectangle is written by one Value call
+ * @return: ( bool )  success = true
+ ****************************************************************************/
+bool Excel::flushPosted()
+{
+    QHash<quint64, QVariant> posted;
+    {
+        QMutexLocker locker(&m_postMutex);
+        if(m_posted.isEmpty()) return true;
+        posted.swap(m_posted);
+    }
+    if(!m_opened) return false;
+
+    QList<Cell> cells;
+    cells.reserve(posted.count());
+    for(QHash<quint64, QVariant>::const_iterator it = posted.constBegin(); it != posted.constEnd(); ++it)
+        cells.append(Cell(int(it.key() & 0xffffffff), int(it.key() >> 32)));
+
+    bool result = true;
+    foreach(const Rect &rect, ExcelRangeSet::fromCells(cells).rects())
+    {
+        QVariantList block;
+        block.reserve(rect.width()*rect.height());
+        for(int y=rect.y(); y<rect.y()+rect.height(); y++)
+            for(int x=rect.x(); x<rect.x()+rect.width(); x++)
+                block.append(posted.value((quint64(y) << 32) | quint32(x)));
+
+        if(SetDataToRange(rect, block)) m_postedWritten += block.count();
+        else result = false;
+    }
+    return result;
+}
+
+void Excel::slot_flushPosted()
+{
+    flushPosted();
+}
+
+// direct write or clear of cells is newer than their posted values
+void Excel::dropPosted(const Rect &rect)
+{
+    QMutexLocker locker(&m_postMutex);
+    if(m_posted.isEmpty()) return;
+    QHash<quint64, QVariant>::iterator it = m_posted.begin();
+    while(it != m_posted.end())
+    {
+        const int x = int(it.key() & 0xffffffff);
+        const int y = int(it.key() >> 32);
+        if(x >= rect.x() && x < rect.x() + rect.width() && y >= rect.y() && y < rect.y() + rect.height())
+            it = m_posted.erase(it);
+        else ++it;
+    }
+}
+
+/****************************************************************************
+ * @function name: Excel::scheduleTableFlush()
+ * @param:
+ *      int msec - time left until oldest pending rows of a table are due
+ * @description: table timer is started or moved earlier
+ ****************************************************************************/
+void Excel::scheduleTableFlush(int msec)
+{
+    msec = qMax(0, msec);
+    if(!m_tableTimer.isActive() || m_tableTimer.remainingTime() > msec)
+        m_tableTimer.start(msec);
+}
+
+void Excel::slot_flushTables()
+{
+    int next = -1;
+    foreach(Table *ptable, m_tables)
+    {
+        if(ptable->m_pending.isEmpty() || ptable->m_flushMsec <= 0) continue;
+        const int left = ptable->m_flushMsec - (int)ptable->m_pendingTimer.elapsed();
+        if(left <= 0) ptable->flush();
+        else if(next < 0 || left < next) next = left;
+    }
+    if(next >= 0) scheduleTableFlush(next);
+}
+
+/****************************************************************************
+ * @function name: Excel::scheduleSeriesRedraw()
+ * @param:
+ *      int msec - time left until a live series may put its next frame
+ * @description: series timer is started or moved earlier
+ ****************************************************************************/
+void Excel::scheduleSeriesRedraw(int msec)
+{
+    msec = qMax(0, msec);
+    if(!m_seriesTimer.isActive() || m_seriesTimer.remainingTime() > msec)
+        m_seriesTimer.start(msec);
+}
+
+void Excel::slot_redrawSeries()
+{
+    int next = -1;
+    foreach(LiveSeries *pseries, m_liveSeries)
+    {
+        if(pseries->m_pending == 0) continue;
+        const int left = pseries->msecToFrame();
+        if(left <= 0) pseries->redraw();
+        else if(next < 0 || left < next) next = left;
+    }
+    if(next >= 0) scheduleSeriesRedraw(next);
+}
+
+/****************************************************************************
+ * @function name: Excel::scheduleRingFlush()
+ * @param:
+ *      int msec - time left until a ring region may refresh
+ * @description: ring timer is started or moved earlier
+ ****************************************************************************/
+void Excel::scheduleRingFlush(int msec)
+{
+    msec = qMax(0, msec);
+    if(!m_ringTimer.isActive() || m_ringTimer.remainingTime() > msec)
+        m_ringTimer.start(msec);
+}
+
+void Excel::slot_flushRings()
+{
+    int next = -1;
+    foreach(RingRegion *pring, m_rings)
+    {
+        if(pring->pendingSamples() == 0) continue;
+        const int left = pring->msecToRefresh();
+        if(left <= 0) pring->flush();
+        else if(next < 0 || left < next) next = left;
+    }
+    if(next >= 0) scheduleRingFlush(next);
+}
+
+/****************************************************************************
+ * @function name: Excel::detachTables()
+ * @param:
+ *      bool flush - write pending rows before
+ * @description: workbook is closed or server is gone, range handles of
+ *               tables, live series and ring regions are invalid. Detached
+ *               objects do no COM calls, also not in destructor, their
+ *               pending data is dropped
+ ****************************************************************************/
+void Excel::detachTables(bool flush)
+{
+    m_tableTimer.stop();
+    foreach(Table *ptable, m_tables)
+    {
+        if(flush) ptable->flush();
+        ptable->mp_excel = 0;
+        ptable->m_dataRange = 0;
+    }
+    m_tables.clear();
+
+    m_seriesTimer.stop();
+    foreach(LiveSeries *pseries, m_liveSeries)
+    {
+        if(flush) pseries->redraw();
+        pseries->mp_excel = 0;
+        pseries->m_series = 0;
+    }
+    m_liveSeries.clear();
+
+    // models stay bound to their sheet, values they know are stale
+    foreach(ExcelSheetModel *pmodel, m_models) pmodel->sheetChanged();
+
+    m_ringTimer.stop();
+    foreach(RingRegion *pring, m_rings)
+    {
+        if(flush) pring->flush();
+        pring->mp_excel = 0;
+        pring->m_range = 0;
+    }
+    m_rings.clear();
+}
+
+bool Excel::setCellStyle(qint32 row, qint32 col, const CellStyle &style)
+{
+    if(!m_opened || row <= 0 || col <= 0) return false;
+    if(!m_formatBuffered){
+        // immediate application is flush of one cell
+        beginFormat();
+        setCellStyle(row, col, style);
+        return flushFormat();
+    }
+    const quint64 key = (quint64(row-1) << 32) | quint32(col-1);
+    m_formatCells[key].merge(style);
+    return true;
+}
+
+/****************************************************************************
+ * @function name: Excel::flushFormat()
+ * @description: applies collected styles. Every attribute value is applied
+ *               once to union of rectangles of cells sharing it, so cost
+ *               depends on distinct fonts and colors, not on cells count
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool Excel::flushFormat()
+{
+    m_formatBuffered = false;
+    if(m_formatCells.isEmpty()) return true;
+    if(!m_opened){
+        m_formatCells.clear();
+        return false;
+    }
+
+    QHash<QString, QList<Cell> > fontCells;
+    QHash<QString, QFont> fonts;
+    QHash<quint32, QList<Cell> > backgroundCells;
+    QHash<quint32, QList<Cell> > foregroundCells;
+
+    QHash<quint64, CellStyle>::const_iterator it;
+    for(it = m_formatCells.constBegin(); it != m_formatCells.constEnd(); ++it)
+    {
+        const Cell cell((int)(it.key() & 0xFFFFFFFF), (int)(it.key() >> 32));
+        const CellStyle &style = it.value();
+        if(style.hasFont()){
+            const QString key = style.font().key();
+            fontCells[key].append(cell);
+            fonts.insert(key, style.font());
+        }
+        if(style.hasBackground())
+            backgroundCells[toXlColor(style.background())].append(cell);
+        if(style.hasForeground())
+            foregroundCells[toXlColor(style.foreground())].append(cell);
+    }
+    m_formatCells.clear();
+
+    mp_exlObject->clearBag();
+    const AxObject::Class sheet = currentSheet();
+
+    bool result = true;
+    foreach(const QString &key, fontCells.keys())
+    {
+        foreach(const QString &range, ExcelRangeSet::fromCells(fontCells[key]).toRanges())
+            putFont(sheet, QString("Range(\"%1\")").arg(range), fonts[key]);
+    }
+    result &= putColorGroups(backgroundCells, "Interior.Color");
+    result &= putColorGroups(foregroundCells, "Font.Color");
+    return result;
+}
+
+// one put of color property per union of cells having that color
+bool Excel::putColorGroups(const QHash<quint32, QList<Cell> > &groups, const QString &property)
+{
+    bool result = true;
+    const AxObject::Class sheet = currentSheet();
+    QHash<quint32, QList<Cell> >::const_iterator it;
+    for(it = groups.constBegin(); it != groups.constEnd(); ++it)
+    {
+        foreach(const QString &range, ExcelRangeSet::fromCells(it.value()).toRanges())
+            result &= mp_exlObject->setProperty(sheet, QString("Range(\"%1\").%2").arg(range).arg(property)
+                                                , QVariant(it.key()));
+    }
+    return result;
+}
+
+/****************************************************************************
+ * @function name: Excel::setColors()
+ * @param:
+ *    const Rect &rect - painted area
+ *    const QList<QColor> &backgrounds - row-major colors of rect cells
+ *    const QList<QColor> &foregrounds - row-major colors of rect cells
+ * @description: matrix is split to same color rectangles, every distinct
+ *               color is one put on union of its rectangles. Invalid or
+ *               missing colors leave cells unchanged.
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool Excel::setColors(const Rect &rect, const QList<QColor> &backgrounds, const QList<QColor> &foregrounds)
+{
+    if(!m_opened || rect.width() <= 0 || rect.height() <= 0) return false;
+
+    QHash<quint32, QList<Cell> > backgroundCells;
+    QHash<quint32, QList<Cell> > foregroundCells;
+    for(int i=0; i<rect.width()*rect.height(); i++)
+    {
+        const Cell cell(rect.x() + i%rect.width(), rect.y() + i/rect.width());
+        if(i < backgrounds.count() && backgrounds[i].isValid())
+            backgroundCells[toXlColor(backgrounds[i])].append(cell);
+        if(i < foregrounds.count() && foregrounds[i].isValid())
+            foregroundCells[toXlColor(foregrounds[i])].append(cell);
+    }
+
+    mp_exlObject->clearBag();
+    bool result = putColorGroups(backgroundCells, "Interior.Color");
+    result &= putColorGroups(foregroundCells, "Font.Color");
+    return result;
+}
+
+
+/****************************************************************************
+ * @function name: Excel::registerStyle()
+ * @param:
+ *      const CellStyle &style
+ * @description: adds named style to workbook Styles collection. Name is
+ *               built from content hash, so the same style placed by
+ *               different tables is created once.
+ * @return: ( QString ) style name, empty on error
+ ****************************************************************************/
+QString Excel::registerStyle(const CellStyle &style)
+{
+    if(!m_opened) return QString();
+
+    const QString base = QString("AxStyle_%1").arg(style.hash(), 8, 16, QChar('0'));
+    QString name = base;
+    for(int n=2; m_styles.contains(name); n++)
+    {
+        if(m_styles[name] == style) return name;
+        name = QString("%1_%2").arg(base).arg(n);
+    }
+
+    mp_exlObject->clearBag();
+    // reopened workbook may keep the style from previous session
+    mp_exlObject->blockSignals(1);
+    AxObject::Class pstyle = mp_exlObject->queryObject(currentWorkBook(), QString("Styles(\"%1\")").arg(name));
+    mp_exlObject->blockSignals(0);
+    if(pstyle == currentWorkBook()) pstyle = 0;
+
+    if(!pstyle)
+    {
+        QVariant var;
+        if(!mp_exlObject->dynamicCall(currentWorkBook(), "Styles.Add", &var, name)) return QString();
+        pstyle = var.toInt();
+        if(!pstyle) return QString();
+    }
+
+    // style is based on Normal, only defined parts are applied to cells
+    mp_exlObject->setProperty(pstyle, "IncludeNumber", false);
+    mp_exlObject->setProperty(pstyle, "IncludeAlignment", false);
+    mp_exlObject->setProperty(pstyle, "IncludeBorder", false);
+    mp_exlObject->setProperty(pstyle, "IncludeProtection", false);
+    mp_exlObject->setProperty(pstyle, "IncludeFont", style.hasFont() || style.hasForeground());
+    mp_exlObject->setProperty(pstyle, "IncludePatterns", style.hasBackground());
+
+    if(style.hasFont())
+    {
+        const QFont font = style.font();
+        mp_exlObject->setProperty(pstyle, "Font.Name", font.family());
+        if(font.pointSize()>0)
+            mp_exlObject->setProperty(pstyle, "Font.Size", font.pointSize());
+        mp_exlObject->setProperty(pstyle, "Font.Bold", font.bold());
+        mp_exlObject->setProperty(pstyle, "Font.Italic", font.italic());
+    }
+    if(style.hasForeground())
+        mp_exlObject->setProperty(pstyle, "Font.Color", QVariant(toXlColor(style.foreground())));
+    if(style.hasBackground())
+        mp_exlObject->setProperty(pstyle, "Interior.Color", QVariant(toXlColor(style.background())));
+
+    m_styles.insert(name, style);
+    return name;
+}
+
+bool Excel::applyStyle(const Rect &rect, const CellStyle &style)
+{
+    return applyStyle(rect.toRange(), style);
+}
+
+bool Excel::applyStyle(const ExcelRangeSet &cells, const CellStyle &style)
+{
+    bool result = !cells.isEmpty();
+    foreach(const QString &range, cells.toRanges())
+        result &= applyStyle(range, style);
+    return result;
+}
 
-                if( f.style(i) != Frame::LineDouble)
-                    mp_exlObject->setProperty(currentSheet(), QString("Range(\"%1\").Borders(%2).Weight")
-                                              .arg(range).arg(xlBorders[i]), xlWidth[f.width(i)]);
-            }
-        }
-        return true;
+bool Excel::applyStyle(const QString &range, const CellStyle &style)
+{
+    if(mp_xlsx){
+        const Rect rect = Range_To_Rect(range);
+        return mp_xlsx->applyStyle(QRect(rect.x(), rect.y(), rect.width(), rect.height()), xlsxStyle(style));
     }
-    return false;
+    if(!m_opened || !Range_Is_Valid(range)) return false;
+    const QString name = registerStyle(style);
+    if(name.isEmpty()) return false;
+    mp_exlObject->clearBag();
+    // cell fonts of range are replaced by style
+    mp_exlObject->invalidateShadow(currentSheet(), QString("Range(\"%1\")").arg(range));
+    return mp_exlObject->setProperty(currentSheet(), QString("Range(\"%1\").Style").arg(range), name);
 }
 
 
+bool Excel::setConditionalFormats(const Rect &rect, const QList<ConditionRule> &rules)
+{
+    return setConditionalFormats(rect.toRange(), rules);
+}
 
 /****************************************************************************
- * @function name: ExcelData::setColor()
- *
+ * @function name: Excel::setConditionalFormats()
  * @param:
- *    qint32 i
- *    qint32 j
- *    const QColor background
- *    const QColor foreground
- * @description: Sets color of background ,foreground cell
- * @return: ( bool ) - success = true
+ *      const QString &range
+ *      const QList<ConditionRule> &rules - in priority order
+ * @description: previous conditions of range are deleted and rules are
+ *               added. Cost is per rule, independent of range size.
+ * @return: ( bool ) success = true
  ****************************************************************************/
-bool Excel::setColor(qint32 row, qint32 col, const QColor background, const QColor foreground)
+bool Excel::setConditionalFormats(const QString &range, const QList<ConditionRule> &rules)
 {
-    bool result = false;
-    if (m_opened && row > 0 && col > 0 )
-    {
-        quint32 color;
-        color = (background.red() << 0) | (background.green() << 8) | (background.blue() << 16);
-        result = mp_exlObject->setProperty(currentSheet(), QString("Cells(%1,%2).Interior.Color").arg(row).arg(col), QVariant(color));
+    if(!m_opened || !Range_Is_Valid(range)) return false;
 
-        color = (foreground.red() << 0) | (foreground.green() << 8) | (foreground.blue() << 16);
-        result = mp_exlObject->setProperty(currentSheet(), QString("Cells(%1,%2).Font.Color").arg(row).arg(col), QVariant(color));
-        result = true;
-    }
-    return result;
-}
+    const AxObject::Class sheet = currentSheet();
+    if(m_conditionRules.value(sheet).contains(range)
+            && m_conditionRules.value(sheet).value(range) == rules)
+        return true;
 
-bool Excel::setColor(const Rect &rect, const QColor background, const QColor foreground)
-{
-    return    setColor(rect.toRange(),background,foreground);
-}
+    mp_exlObject->clearBag();
+    const QString path = QString("Range(\"%1\").FormatConditions").arg(range);
+    mp_exlObject->dynamicCall(sheet, path + ".Delete");
 
-bool Excel::setColor(const QString &range, const QColor background, const QColor foreground)
-{
-    bool result = false;
-    if (m_opened && Range_Is_Valid(range) )
+    // optional argument left out in the middle of argument list
+    const QString missing = AxObjectType(ERROR, (int)DISP_E_PARAMNOTFOUND);
+
+    bool result = true;
+    foreach(const ConditionRule &rule, rules)
     {
-        quint32 color;
-        color = (background.red() << 0) | (background.green() << 8) | (background.blue() << 16);
-        result = mp_exlObject->setProperty(currentSheet(), QString("Range(\"%1\").Interior.Color").arg(range), QVariant(color));
+        // null text is dropped from argument list, empty one is kept
+        const QString formula1 = rule.formula1.isNull() ? QString("") : rule.formula1;
+        QVariant var;
+        bool ok = false;
+        switch(rule.type)
+        {
+        case ConditionRule::CellValue:
+            ok = mp_exlObject->dynamicCall(sheet, path + ".Add", &var, xlCellValue, rule.comparison
+                                           , formula1
+                                           , rule.formula2.isEmpty() ? QVariant() : QVariant(rule.formula2));
+            break;
+        case ConditionRule::Expression:
+            ok = mp_exlObject->dynamicCall(sheet, path + ".Add", &var, xlExpression, missing, formula1);
+            break;
+        case ConditionRule::ColorScale:
+            ok = mp_exlObject->dynamicCall(sheet, path + ".AddColorScale", &var, rule.midColor.isValid() ? 3 : 2);
+            break;
+        case ConditionRule::DataBar:
+            ok = mp_exlObject->dynamicCall(sheet, path + ".AddDatabar", &var);
+            break;
+        }
 
-        color = (foreground.red() << 0) | (foreground.green() << 8) | (foreground.blue() << 16);
-        result = mp_exlObject->setProperty(currentSheet(), QString("Range(\"%1\").Font.Color").arg(range), QVariant(color));
+        const AxObject::Class condition = var.toInt();
+        if(!ok || condition == 0){
+            result = false;
+            continue;
+        }
 
-        result = true;
+        switch(rule.type)
+        {
+        case ConditionRule::CellValue:
+        case ConditionRule::Expression:
+            if(rule.background.isValid())
+                mp_exlObject->setProperty(condition, "Interior.Color", QVariant(toXlColor(rule.background)));
+            if(rule.foreground.isValid())
+                mp_exlObject->setProperty(condition, "Font.Color", QVariant(toXlColor(rule.foreground)));
+            break;
+        case ConditionRule::ColorScale:
+        {
+            int criteria = 1;
+            mp_exlObject->setProperty(condition, QString("ColorScaleCriteria(%1).FormatColor.Color").arg(criteria++)
+                                      , QVariant(toXlColor(rule.lowColor)));
+            if(rule.midColor.isValid())
+                mp_exlObject->setProperty(condition, QString("ColorScaleCriteria(%1).FormatColor.Color").arg(criteria++)
+                                          , QVariant(toXlColor(rule.midColor)));
+            mp_exlObject->setProperty(condition, QString("ColorScaleCriteria(%1).FormatColor.Color").arg(criteria)
+                                      , QVariant(toXlColor(rule.highColor)));
+        }
+            break;
+        case ConditionRule::DataBar:
+            if(rule.background.isValid())
+                mp_exlObject->setProperty(condition, "BarColor.Color", QVariant(toXlColor(rule.background)));
+            break;
+        }
     }
+
+    if(result) m_conditionRules[sheet].insert(range, rules);
+    else m_conditionRules[sheet].remove(range);
     return result;
 }
 
+bool Excel::clearConditionalFormats(const QString &range)
+{
+    if(!m_opened || !Range_Is_Valid(range)) return false;
+    mp_exlObject->clearBag();
+    m_conditionRules[currentSheet()].remove(range);
+    return mp_exlObject->dynamicCall(currentSheet(), QString("Range(\"%1\").FormatConditions.Delete").arg(range));
+}
+
+
 /****************************************************************************
  * @function name: ExcelData::color()
  *
@@ -934,6 +3444,202 @@ bool Excel::color(qint32 row, qint32 col, QColor &background, QColor &foreground
 }
 
 
+static const QString xmlSpreadsheetNs("urn:schemas-microsoft-com:office:spreadsheet");
+
+// reads children of <Style> into format
+static void readXmlStyle(QXmlStreamReader &xml, Excel::CellFormat &format)
+{
+    while(xml.readNextStartElement())
+    {
+        const QXmlStreamAttributes attr = xml.attributes();
+        if(xml.name() == QLatin1String("Font"))
+        {
+            if(attr.hasAttribute(xmlSpreadsheetNs, "FontName"))
+                format.fontName = attr.value(xmlSpreadsheetNs, "FontName").toString();
+            if(attr.hasAttribute(xmlSpreadsheetNs, "Size"))
+                format.fontSize = attr.value(xmlSpreadsheetNs, "Size").toString().toDouble();
+            if(attr.hasAttribute(xmlSpreadsheetNs, "Bold"))
+                format.bold = attr.value(xmlSpreadsheetNs, "Bold") == QLatin1String("1");
+            if(attr.hasAttribute(xmlSpreadsheetNs, "Italic"))
+                format.italic = attr.value(xmlSpreadsheetNs, "Italic") == QLatin1String("1");
+            if(attr.hasAttribute(xmlSpreadsheetNs, "Color"))
+                format.foreground = QColor(attr.value(xmlSpreadsheetNs, "Color").toString());
+        }
+        else if(xml.name() == QLatin1String("Interior"))
+        {
+            if(attr.hasAttribute(xmlSpreadsheetNs, "Color")
+                    && attr.value(xmlSpreadsheetNs, "Pattern") != QLatin1String("None"))
+                format.background = QColor(attr.value(xmlSpreadsheetNs, "Color").toString());
+        }
+        xml.skipCurrentElement();
+    }
+}
+
+/****************************************************************************
+ * @function name: parseXmlSpreadsheet()
+ * @param:
+ *    const QString &text - XML spreadsheet of range
+ *    int width, int height - range size, <=0 taken from table
+ *    Excel::FormatSnapshot *psnapshot - result
+ * @description: streaming parse of styles and cells. Cell without own
+ *               style gets style of its row, column or Default.
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+static bool parseXmlSpreadsheet(const QString &text, int width, int height, Excel::FormatSnapshot *psnapshot)
+{
+    QXmlStreamReader xml(text);
+    QHash<QString, Excel::CellFormat> formats; // ss:ID -> format
+    QVector<QString> cellStyles;
+    QVector<QString> rowStyles;
+    QVector<QString> columnStyles;
+    QVariantList values;
+    int row = -1;
+    int nextRow = 0;
+    int col = 0;
+    int column = 0;
+    int cellIndex = -1;
+
+    while(!xml.atEnd())
+    {
+        xml.readNext();
+        if(!xml.isStartElement()) continue;
+        const QXmlStreamAttributes attr = xml.attributes();
+
+        if(xml.name() == QLatin1String("Style"))
+        {
+            const QString id = attr.value(xmlSpreadsheetNs, "ID").toString();
+            QString parent = attr.value(xmlSpreadsheetNs, "Parent").toString();
+            if(parent.isEmpty()) parent = "Default";
+            Excel::CellFormat format = id == "Default" ? Excel::CellFormat() : formats.value(parent);
+            readXmlStyle(xml, format);
+            formats.insert(id, format);
+        }
+        else if(xml.name() == QLatin1String("Table"))
+        {
+            if(width <= 0) width = attr.value(xmlSpreadsheetNs, "ExpandedColumnCount").toString().toInt();
+            if(height <= 0) height = attr.value(xmlSpreadsheetNs, "ExpandedRowCount").toString().toInt();
+            if(width <= 0 || height <= 0) return false;
+            cellStyles = QVector<QString>(width*height);
+            rowStyles = QVector<QString>(height);
+            columnStyles = QVector<QString>(width);
+            values.clear();
+            for(int i=0; i<width*height; i++) values.append(QVariant());
+        }
+        else if(xml.name() == QLatin1String("Column"))
+        {
+            if(attr.hasAttribute(xmlSpreadsheetNs, "Index"))
+                column = attr.value(xmlSpreadsheetNs, "Index").toString().toInt() - 1;
+            const int span = attr.value(xmlSpreadsheetNs, "Span").toString().toInt();
+            const QString style = attr.value(xmlSpreadsheetNs, "StyleID").toString();
+            for(int c = column; c <= column + span && c < columnStyles.count(); c++)
+                if(c >= 0) columnStyles[c] = style;
+            column += span + 1;
+        }
+        else if(xml.name() == QLatin1String("Row"))
+        {
+            row = nextRow;
+            if(attr.hasAttribute(xmlSpreadsheetNs, "Index"))
+                row = attr.value(xmlSpreadsheetNs, "Index").toString().toInt() - 1;
+            // span repeats row, its style covers the following rows too
+            const int span = attr.value(xmlSpreadsheetNs, "Span").toString().toInt();
+            const QString style = attr.value(xmlSpreadsheetNs, "StyleID").toString();
+            for(int r = row; r <= row + span && r < rowStyles.count(); r++)
+                if(r >= 0) rowStyles[r] = style;
+            nextRow = row + span + 1;
+            col = 0;
+        }
+        else if(xml.name() == QLatin1String("Cell"))
+        {
+            if(attr.hasAttribute(xmlSpreadsheetNs, "Index"))
+                col = attr.value(xmlSpreadsheetNs, "Index").toString().toInt() - 1;
+            const int across = attr.value(xmlSpreadsheetNs, "MergeAcross").toString().toInt();
+            const int down = attr.value(xmlSpreadsheetNs, "MergeDown").toString().toInt();
+            const QString style = attr.value(xmlSpreadsheetNs, "StyleID").toString();
+
+            cellIndex = (row >= 0 && row < height && col >= 0 && col < width) ? row*width + col : -1;
+            // merged area has style of its first cell
+            for(int r = row; r <= row + down && r < height; r++)
+                for(int c = col; c <= col + across && c < width; c++)
+                    if(r >= 0 && c >= 0) cellStyles[r*width + c] = style;
+            col += across + 1;
+        }
+        else if(xml.name() == QLatin1String("Comment"))
+        {
+            xml.skipCurrentElement();
+        }
+        else if(xml.name() == QLatin1String("Data"))
+        {
+            const QString type = attr.value(xmlSpreadsheetNs, "Type").toString();
+            const QString data = xml.readElementText(QXmlStreamReader::IncludeChildElements);
+            if(cellIndex >= 0 && cellIndex < values.count())
+            {
+                if(type == "Number") values[cellIndex] = data.toDouble();
+                else if(type == "Boolean") values[cellIndex] = data == "1";
+                else values[cellIndex] = data;
+            }
+        }
+    }
+    if(xml.hasError() || width <= 0 || height <= 0) return false;
+
+    psnapshot->width = width;
+    psnapshot->height = height;
+    psnapshot->values = values;
+    psnapshot->styles.clear();
+    psnapshot->styleIds = QVector<int>(width*height);
+
+    QHash<QString, int> keyIndex;   // format key -> index in styles
+    QHash<QString, int> idIndex;    // ss:ID -> index in styles
+    for(int i=0; i<width*height; i++)
+    {
+        QString id = cellStyles[i];
+        if(id.isEmpty()) id = rowStyles[i/width];
+        if(id.isEmpty()) id = columnStyles[i%width];
+        if(id.isEmpty()) id = "Default";
+
+        int index = idIndex.value(id, -1);
+        if(index < 0)
+        {
+            const Excel::CellFormat format = formats.value(id, formats.value("Default"));
+            const QString key = format.key();
+            index = keyIndex.value(key, -1);
+            if(index < 0){
+                index = psnapshot->styles.count();
+                psnapshot->styles.append(format);
+                keyIndex.insert(key, index);
+            }
+            idIndex.insert(id, index);
+        }
+        psnapshot->styleIds[i] = index;
+    }
+    return true;
+}
+
+/****************************************************************************
+ * @function name: Excel::readFormats()
+ * @param:
+ *      const QString &range
+ *      FormatSnapshot *psnapshot - values, style id per cell, style table
+ * @description: one Value(xlRangeValueXMLSpreadsheet) read instead of
+ *               property reads per cell, parsed locally
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool Excel::readFormats(const QString &range, FormatSnapshot *psnapshot)
+{
+    flushCombined();
+    if(!m_opened || !psnapshot || !Range_Is_Valid(range)) return false;
+
+    QVariant var;
+    mp_exlObject->clearBag();
+    if(!mp_exlObject->property(currentSheet()
+                               , QString("Range(\"%1\").Value(%2)").arg(range).arg(xlRangeValueXMLSpreadsheet)
+                               , &var))
+        return false;
+
+    const Rect rect = Range_To_Rect(range);
+    return parseXmlSpreadsheet(var.toString(), rect.width(), rect.height(), psnapshot);
+}
+
+
 /****************************************************************************
  * @function name: ExcelData::setVisible()
  * @param:
@@ -943,17 +3649,21 @@ bool Excel::color(qint32 row, qint32 col, QColor &background, QColor &foreground
  ****************************************************************************/
 bool Excel::setVisible(bool visible)
 {
-    if ( isOpen())
+    if ( m_opened )
     {
-        return  mp_exlObject->setProperty(0, "Visible", visible);
+        const bool result = mp_exlObject->setProperty(0, "Visible", visible);
+        if(result) m_info.visible = visible;
+        return result;
     }
     return false;
 }
 
+// served from workbook snapshot
 bool Excel::visible()
 {
-    if ( isOpen())
+    if ( m_opened )
     {
+        if(workbookInfo().valid) return m_info.visible;
         QVariant res;
         bool ok = mp_exlObject->property(0, "Visible",&res);
         return  ok && res.toBool();
@@ -963,7 +3673,8 @@ bool Excel::visible()
 
 bool Excel::valid()
 {
-    if ( isOpen())
+    if(mp_xlsx) return mp_xlsx->isOpen();
+    if ( m_opened )
     {
         QVariant tmp;
         return mp_exlObject->property(0, "Visible",&tmp);
@@ -973,6 +3684,7 @@ bool Excel::valid()
 
 bool Excel::resizeCells(double size)
 {
+    if(!m_opened) return false;
     return mp_exlObject->dynamicCall(0,"Cells.Select") && mp_exlObject->setProperty(0, "Selection.ColumnWidth",size);
 }
 
@@ -987,61 +3699,265 @@ bool Excel::resizeCells(double size)
  ****************************************************************************/
 void Excel::close()
 {       
+    if(mp_xlsx){
+        detachTables(true);
+        if(mp_xlsx->isOpen() && m_autosave) mp_xlsx->save();
+        mp_xlsx->close();
+        return;
+    }
     if(isOpen()){
+        detachTables(true);
+        if(m_formatBuffered) flushFormat();
+        if(m_framesBuffered) flushFrames();
+        flushPosted();
+        flushCombined();
         if(m_autosave) save();
         mp_exlObject->dynamicCall(currentWorkBook(), "Close");
         m_opened = false;
+        // sheet of next workbook is resolved again
+        mp_currentSheet = 0;
+        mp_currentWorkBook = 0;
+        m_sheetname.clear();
+        m_styles.clear();
+        clearChartTemplates();
+        invalidateWorkbookInfo();
+        nextSheetGeneration();
     }
 }
 
 
 int Excel::sheetsCount()
 {
-    QVariant var;
-    mp_exlObject->property(currentWorkBook(),"Sheets.Count", &var);
-    return var.toInt();
+    if(mp_xlsx) return mp_xlsx->sheetsCount();
+    if(!m_opened) return 0;
+    return workbookInfo().sheets.count();
 }
 
 QStringList Excel::sheetsList()
 {
+    if(mp_xlsx) return mp_xlsx->sheetsList();
     QStringList result;
-    int sheets_count = sheetsCount();
-    if(sheets_count>0)
+    if(!m_opened) return result;
+    foreach(const SheetInfo &sheet, workbookInfo().sheets)
+        result += sheet.name;
+    return result;
+}
+
+/****************************************************************************
+ * @function name: Excel::workbookInfo()
+ * @description: snapshot of workbook is fetched when not valid: full name,
+ *               read-only flag, visibility and all sheet names by one
+ *               GET.WORKBOOK(1) macro call. Named ranges, handles and used ranges are
+ *               fetched on first use.
+ * @return: ( const WorkbookInfo & )
+ ****************************************************************************/
+const Excel::WorkbookInfo &Excel::workbookInfo()
+{
+    if(m_info.valid || !m_opened) return m_info;
+
+    mp_exlObject->clearBag();
+    m_info = WorkbookInfo();
+    QVariant var;
+    if(mp_exlObject->property(currentWorkBook(), "FullName", &var))
+        m_info.fullName = var.toString();
+    if(mp_exlObject->property(currentWorkBook(), "ReadOnly", &var))
+        m_info.readOnly = var.toBool();
+    if(mp_exlObject->property(0, "Visible", &var))
+        m_info.visible = var.toBool();
+    m_info.valid = fetchSheetNames();
+    return m_info;
+}
+
+bool Excel::fetchSheetNames()
+{
+    QVariant var;
+    m_info.sheets.clear();
+
+    // names of all sheets as "[Book.xlsx]Sheet" in one call, macro reads
+    // active workbook unless our workbook is named
+    const QString book = m_info.fullName.section('/', -1).section('\\', -1);
+    const QString prefix = QString("[%1]").arg(book);
+    bool macro = false;
+    if(!book.isEmpty())
+    {
+        // macro sheets functions may be disabled, failure is not an error
+        mp_exlObject->blockSignals(1);
+        macro = mp_exlObject->dynamicCall(0, "ExecuteExcel4Macro", &var
+                                          , QString("GET.WORKBOOK(1,\"%1\")").arg(book));
+        mp_exlObject->blockSignals(0);
+    }
+    if(macro && var.type() == QVariant::List)
     {
-        for(int i=1;i<=sheets_count;i++)
+        foreach(const QVariant &item, var.toList())
         {
-            QVariant var;
-            mp_exlObject->property(currentWorkBook(), QString("Sheets(%1).Name").arg(i),&var);
-            result += var.toString();
+            const QString text = item.toString();
+            if(!text.startsWith(prefix, Qt::CaseInsensitive))
+            {
+                m_info.sheets.clear();
+                break;
+            }
+            SheetInfo sheet;
+            sheet.name = text.mid(prefix.size());
+            sheet.index = m_info.sheets.count() + 1;
+            m_info.sheets.append(sheet);
         }
+        if(!m_info.sheets.isEmpty()) return true;
     }
-    return result;
+
+    // macro sheets functions may be disabled, sheet by sheet then
+    if(!mp_exlObject->property(currentWorkBook(), "Sheets.Count", &var)) return false;
+    const int count = var.toInt();
+    for(int i=1; i<=count; i++)
+    {
+        if(!mp_exlObject->property(currentWorkBook(), QString("Sheets(%1).Name").arg(i), &var)) return false;
+        SheetInfo sheet;
+        sheet.name = var.toString();
+        sheet.index = i;
+        m_info.sheets.append(sheet);
+    }
+    return true;
 }
 
+void Excel::invalidateWorkbookInfo()
+{
+    m_info = WorkbookInfo();
+}
 
-QString Excel::Cell_To_Name(const Excel::Cell &cell,bool fixed)
+// SaveAs changes name and read-only flag, sheets and names stay valid
+void Excel::refreshFileInfo()
+{
+    if(!m_info.valid) return;
+    QVariant var;
+    if(mp_exlObject->property(currentWorkBook(), "FullName", &var))
+        m_info.fullName = var.toString();
+    else invalidateWorkbookInfo();
+    if(mp_exlObject->property(currentWorkBook(), "ReadOnly", &var))
+        m_info.readOnly = var.toBool();
+    else invalidateWorkbookInfo();
+}
+
+void Excel::fetchNames()
+{
+    QVariant var;
+    m_info.names.clear();
+    if(!mp_exlObject->property(currentWorkBook(), "Names.Count", &var)) return;
+    const int count = var.toInt();
+    for(int i=1; i<=count; i++)
+    {
+        AxObject::Class pName = mp_exlObject->queryObject(currentWorkBook(), QString("Names(%1)").arg(i));
+        if(pName == currentWorkBook()) return;
+        QVariant name, ref;
+        mp_exlObject->property(pName, "Name", &name);
+        mp_exlObject->property(pName, "RefersTo", &ref);
+        m_info.names.insert(name.toString(), ref.toString());
+    }
+    m_info.namesValid = true;
+}
+
+QStringList Excel::namedRanges()
+{
+    if(!m_opened) return QStringList();
+    workbookInfo();
+    if(!m_info.namesValid) fetchNames();
+    return m_info.names.keys();
+}
+
+QString Excel::namedRangeAddress(const QString &name)
+{
+    if(!m_opened) return QString();
+    workbookInfo();
+    if(!m_info.namesValid) fetchNames();
+    return m_info.names.value(name);
+}
+
+AxObject::Class Excel::sheetHandle(const QString &sheetname)
+{
+    if(!m_opened) return 0;
+    workbookInfo();
+    const int i = m_info.indexOf(sheetname);
+    if(i < 0) return 0;
+    if(m_info.sheets[i].handle == 0)
+    {
+        AxObject::Class pSheet = mp_exlObject->queryObject(currentWorkBook(), QString("Sheets(\"%1\")").arg(sheetname));
+        if(pSheet != currentWorkBook()) m_info.sheets[i].handle = pSheet;
+    }
+    return m_info.sheets[i].handle;
+}
+
+/****************************************************************************
+ * @function name: Excel::usedRange()
+ * @param:
+ *      const QString &sheetname - sheet, current sheet when empty
+ * @description: used range is kept until library writes to the sheet
+ * @return: ( QString ) address like "A1:D10", empty on error
+ ****************************************************************************/
+QString Excel::usedRange(const QString &sheetname)
 {
-    int index = 26*26*26*26;
+    const QString name = sheetname.isEmpty() ? m_sheetname : sheetname;
+    AxObject::Class pSheet = name.isEmpty() ? currentSheet() : sheetHandle(name);
+    if(pSheet == 0) return QString();
+
+    const int i = m_info.indexOf(name);
+    if(i >= 0 && !m_info.sheets[i].usedRange.isEmpty()) return m_info.sheets[i].usedRange;
+
+    QVariant var;
+    if(!mp_exlObject->property(pSheet, "UsedRange.Address", &var)) return QString();
+    const QString address = var.toString().remove('$');
+    if(i >= 0) m_info.sheets[i].usedRange = address;
+    return address;
+}
 
-    int col = cell.x();
-    QString col_abc;
-    while(index>1)
+// library wrote to current sheet, its used range may have grown. Read
+// grid of sheet without formulas drops only chunks of written rows
+void Excel::sheetDataChanged(const QString &sheetname, const Rect &rect)
+{
+    const QString name = sheetname.isEmpty() ? currentSheetName() : sheetname;
+    if(name.isEmpty())
+    {
+        // sheet unknown, nothing cached may be trusted
+        for(int i=0; i<m_info.sheets.count(); i++) m_info.sheets[i].usedRange.clear();
+        m_readGrids.clear();
+        foreach(ExcelSheetModel *pmodel, m_models) pmodel->sheetChanged();
+        return;
+    }
+    const int i = m_info.indexOf(name);
+    if(i >= 0) m_info.sheets[i].usedRange.clear();
+    QHash<QString, ReadGrid>::iterator grid = m_readGrids.find(name);
+    if(grid != m_readGrids.end())
     {
-        if(col>=index )
+        if(!grid->formulas && rect.area() > 0 && grid->rect.contains(rect))
         {
-            col_abc += QChar('A' +col/index-1);
-            col = col % index;
+            for(int y=rect.y() - grid->rect.y(); y<rect.y() + rect.height() - grid->rect.y(); y+=grid->chunkRows)
+                grid->loaded[y/grid->chunkRows] = false;
+            grid->loaded[(rect.y() + rect.height() - 1 - grid->rect.y())/grid->chunkRows] = false;
         }
-        index /=26;
+        else m_readGrids.erase(grid);
+    }
+    foreach(ExcelSheetModel *pmodel, m_models)
+    {
+        if(pmodel->sheetName().compare(name, Qt::CaseInsensitive) == 0) pmodel->sheetChanged();
+    }
+}
+
+// name of current sheet, sheet active after open is asked for its name
+QString Excel::currentSheetName()
+{
+    if(mp_xlsx) return mp_xlsx->currentSheet();
+    if(m_sheetname.isEmpty() && m_opened && currentSheet() != 0)
+    {
+        QVariant var;
+        if(mp_exlObject->property(mp_currentSheet, "Name", &var)) m_sheetname = var.toString();
     }
-    col_abc += QChar('A' +col);
+    return m_sheetname;
+}
 
-    QString cellName;
-    if(fixed)
-        cellName = QString("$%1$%2").arg(col_abc).arg(1+cell.y());
-    else cellName = QString("%1%2").arg(col_abc).arg(1+cell.y());
 
-    return cellName;
+QString Excel::Cell_To_Name(const Excel::Cell &cell,bool fixed)
+{
+    char buf[ExcelAddress::MaxCellLength];
+    const ExcelAddress::Ref ref = {cell.x(), cell.y()
+                                   , fixed ? ExcelAddress::AbsoluteColumn|ExcelAddress::AbsoluteRow : 0};
+    return QString::fromLatin1(buf, ExcelAddress::formatCell(ref, buf));
 }
 
 QString Excel::Rect_To_Range(const Excel::Rect &rect,bool fixed)
@@ -1051,25 +3967,104 @@ QString Excel::Rect_To_Range(const Excel::Rect &rect,bool fixed)
     else c.setX(c.x()-1);
     if(c.y() ==0)        c.setY(1);
     else c.setY(c.y()-1);
-    return QString("%1:%2")
-            .arg(Cell_To_Name(rect.p1(),fixed))
-            .arg(Cell_To_Name(c,fixed));
+
+    const int flags = fixed ? ExcelAddress::AbsoluteColumn|ExcelAddress::AbsoluteRow : 0;
+    ExcelAddress::Area area;
+    area.first.col = rect.x();
+    area.first.row = rect.y();
+    area.first.flags = flags;
+    area.last.col = c.x();
+    area.last.row = c.y();
+    area.last.flags = flags;
+    area.type = ExcelAddress::Cells;
+
+    // always "first:last", single cell too
+    char buf[ExcelAddress::MaxAreaLength];
+    int len = ExcelAddress::formatCell(area.first, buf);
+    buf[len++] = ':';
+    len += ExcelAddress::formatCell(area.last, buf + len);
+    return QString::fromLatin1(buf, len);
+}
+
+QList<Excel::Rect> Excel::Cells_To_Rects(QList<Cell> cells)
+{
+    return ExcelRangeSet::fromCells(cells).rects();
+}
+
+QStringList Excel::Rects_To_Ranges(const QList<Rect> &rects, int max_length)
+{
+    QStringList ranges;
+    QString range;
+    foreach(const Rect &rect, rects)
+    {
+        const QString area = (rect.width() == 1 && rect.height() == 1)
+                ? Cell_To_Name(rect.p1()) : rect.toRange();
+        if(!range.isEmpty() && range.size() + 1 + area.size() > max_length){
+            ranges.append(range);
+            range.clear();
+        }
+        if(!range.isEmpty()) range += ',';
+        range += area;
+    }
+    if(!range.isEmpty()) ranges.append(range);
+    return ranges;
 }
 
 Excel::Cell Excel::Name_To_Cell(const QString &xl_name)
 {
-    return Cell();
+    ExcelAddress::Area area;
+    if(ExcelAddress::parseRange(xl_name, &area, 1) < 1 || area.type != ExcelAddress::Cells)
+        return Cell();
+    return Cell(area.first.col, area.first.row);
 }
 
+// plain one-area cell range of current sheet, empty rect otherwise
 Excel::Rect Excel::Range_To_Rect(const QString &xl_range)
 {
-    return Rect();
+    ExcelAddress::Area area;
+    if(ExcelAddress::parseRange(xl_range, &area, 1) != 1
+            || area.type != ExcelAddress::Cells || area.sheetBegin >= 0)
+        return Rect();
+
+    return Rect(area.first.col, area.first.row
+                , area.last.col - area.first.col + 1, area.last.row - area.first.row + 1);
 }
 
 bool Excel::Range_Is_Valid(const QString &range)
 {
-    // TODO
-    return true;
+    return ExcelAddress::isValid(range) || Name_Is_Valid(range);
+}
+
+/****************************************************************************
+ * @function name: Excel::Name_Is_Valid()
+ * @param:
+ *      const QString &name - defined name, optionally "Sheet!Name"
+ * @description: syntax of excel defined names: letter, '_' or '\' first,
+ *               then letters, digits, '_', '.' or '\', at most 255
+ *               characters. Cell references like "A1" or "R1C1" and
+ *               single "R" or "C" are not names. Name is not looked up.
+ * @return: ( bool )
+ ****************************************************************************/
+bool Excel::Name_Is_Valid(const QString &name)
+{
+    const QString local = name.section('!', -1);
+    if(local.isEmpty() || local.size() > 255) return false;
+    if(name.contains('!') && name.section('!', 0, -2).isEmpty()) return false;
+
+    const QChar first = local[0];
+    if(!first.isLetter() && first != QLatin1Char('_') && first != QLatin1Char('\\')) return false;
+    for(int i=1; i<local.size(); i++)
+    {
+        const QChar c = local[i];
+        if(!c.isLetterOrNumber() && c != QLatin1Char('_') && c != QLatin1Char('.') && c != QLatin1Char('\\'))
+            return false;
+    }
+
+    const QString upper = local.toUpper();
+    if(upper == "R" || upper == "C") return false;
+    ExcelAddress::Ref ref;
+    return !ExcelAddress::parseCell(local.constData(), local.size(), &ref)
+            && !ExcelAddress::parseR1C1(local.constData(), local.size(), &ref);
 }
 
 
@@ -1077,6 +4072,7 @@ bool Excel::Range_Is_Valid(const QString &range)
 
 bool Excel::test()
 {
+    if(!mp_exlObject) return isOpen();
     mp_exlObject->blockSignals(1);
     QVariant data;
     bool result = read(1,1,data);
@@ -1088,15 +4084,30 @@ bool Excel::test()
 
 
 Excel::Table::Table()
+    :m_appendFrame(0)
 {
+    mp_excel = 0;
+    m_dataRange = 0;
     mp_headerArea = 0;
     mp_dataArea=0;
     m_rows_count =0;
+    m_width = 0;
+    m_height = 0;
+    m_flushRows = 1;
+    m_flushMsec = 0;
+    m_flushTime = 0;
+    m_rowsFlushed = 0;
 }
 
 Excel::Table::Table(Excel *pexcel, const Excel::Rect &rect)
+    :m_appendFrame(0)
 {
     mp_excel = pexcel;
+    m_dataRange = 0;
+    if(mp_excel){
+        mp_excel->m_tables.append(this);
+        m_sheetName = mp_excel->mp_xlsx ? mp_excel->mp_xlsx->currentSheet() : mp_excel->m_sheetname;
+    }
     m_font = QFont();
     m_rows_count = 0;
     m_rect = rect;
@@ -1104,6 +4115,10 @@ Excel::Table::Table(Excel *pexcel, const Excel::Rect &rect)
     m_width = rect.width();
     mp_headerArea = 0;
     mp_dataArea=0;
+    m_flushRows = 1;
+    m_flushMsec = 0;
+    m_flushTime = 0;
+    m_rowsFlushed = 0;
 }
 
 
@@ -1118,8 +4133,9 @@ void Excel::Table::setDataArea(Excel::DataArea *dataArea)
         mp_dataArea->setWidth(rect().width());
         mp_dataArea->setHeight(rect().height()-mp_headerArea->height());
 
-        m_dataRange = mp_excel->object()->queryObject(mp_excel->currentSheet()
-                                                      , QString("Range(\"%1\")").arg(mp_dataArea->rect().toRange()));
+        if(mp_excel->object())
+            m_dataRange = mp_excel->object()->queryObject(mp_excel->currentSheet()
+                                                          , QString("Range(\"%1\")").arg(mp_dataArea->rect().toRange()));
     }
 }
 
@@ -1147,28 +4163,128 @@ void Excel::Table::setTableData(const QStringList &data)
         mp_dataArea->placeData(mp_excel,  rect().x(), rect().y(), data);
 }
 
+/****************************************************************************
+ * @function name: Excel::Table::appendDataRow()
+ * @param:
+ *      const QStringList &data - row texts, longer data continues on
+ *                                next rows
+ * @description: queues rows, they are written by flush() according to
+ *               flush policy
+ * @return: ( bool ) success = true
+ ****************************************************************************/
 bool Excel::Table::appendDataRow(const QStringList &data)
 {
-    bool result=false;
+    if(data.isEmpty() || m_width <= 0) return false;
+
+    if(!m_streamTimer.isValid()) m_streamTimer.start();
+    if(m_pending.isEmpty()) m_pendingTimer.start();
+
+    for(int i=0; i<data.count(); i+=m_width)
+        m_pending.append(data.mid(i, m_width));
+
+    if(m_pending.count() >= m_flushRows
+            || (m_flushMsec > 0 && m_pendingTimer.elapsed() >= m_flushMsec))
+        return flush();
+    // trailing rows are written by timer when no more rows come
+    if(m_flushMsec > 0 && mp_excel)
+        mp_excel->scheduleTableFlush(m_flushMsec - (int)m_pendingTimer.elapsed());
+    return true;
+}
+
+void Excel::Table::setFlushPolicy(int rows, int msec)
+{
+    m_flushRows = qMax(1, rows);
+    m_flushMsec = msec;
+}
+
+/****************************************************************************
+ * @function name: Excel::Table::flush()
+ * @description: writes pending rows as one 2D block below already written
+ *               rows, font and frame are applied once to the block. Block
+ *               is addressed relative to data range handle, in xlsx mode
+ *               table sheet is made current for the write
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool Excel::Table::flush()
+{
+    if(m_pending.isEmpty()) return true;
+    if(!mp_excel || !mp_dataArea) {
+        m_pending.clear();
+        return false;
+    }
 
-    if(!data.isEmpty())
+    QElapsedTimer timer;
+    timer.start();
+
+    const int rows = m_pending.count();
+    QVariantList block;
+    foreach(const QStringList &row, m_pending)
+    {
+        for(int column=0; column<m_width; column++)
+            block.append(column < row.count() ? row[column] : QString(""));
+    }
+    m_pending.clear();
+
+    bool result = false;
+    if(mp_excel->mp_xlsx)
+    {
+        ExcelXlsxWriter *pxlsx = mp_excel->mp_xlsx;
+        const QString current = pxlsx->currentSheet();
+        if(!m_sheetName.isEmpty()) pxlsx->setCurrentSheet(m_sheetName);
+        const Rect rect(dataRect().x(), dataRect().y() + m_rows_count, m_width, rows);
+        result = mp_excel->SetDataToRange(rect, block);
+        if(result)
+        {
+            if(m_font != QFont()){
+                CellStyle style;
+                style.setFont(m_font);
+                mp_excel->applyStyle(rect, style);
+            }
+            mp_excel->drawFrame(rect, m_appendFrame);
+        }
+        if(!current.isEmpty()) pxlsx->setCurrentSheet(current);
+    }
+    else if(m_dataRange)
     {
-        int i=0;
-        int row=0,column=0;
-        foreach(const QString &txt, data)
+        // rows relative to top left cell of data range
+        const QString range = Rect(0, m_rows_count, m_width, rows).toRange();
+        mp_excel->flushCombined();
+        mp_excel->sheetDataChanged(m_sheetName, Rect(dataRect().x(), dataRect().y() + m_rows_count, m_width, rows));
+        result = mp_excel->mp_exlObject->setPropertyBlock(m_dataRange, QString("Range(\"%1\").Value").arg(range), block, m_width, rows);
+        if(result)
         {
-            row = i/m_width + 1 + m_rows_count;
-            column = i%m_width+1;
-            if(!mp_excel->write(m_dataRange, row, column, txt ,m_font))
-                return false;
-            i++;
+            if(m_font != QFont())
+            {
+                mp_excel->putFont(m_dataRange, QString("Range(\"%1\")").arg(range), m_font, false);
+                // fonts cached for these rows on the table sheet are stale
+                const Rect rows_rect(dataRect().x(), dataRect().y() + m_rows_count, m_width, rows);
+                mp_excel->mp_exlObject->invalidateShadow(mp_excel->sheetHandle(m_sheetName)
+                                                         , QString("Range(\"%1\")").arg(rows_rect.toRange()));
+            }
+            mp_excel->putFrame(m_dataRange, range, m_appendFrame);
         }
-        m_rows_count = row;
-        result= true;
     }
+    if(result)
+    {
+        m_rows_count += rows;
+        m_rowsFlushed += rows;
+    }
+    m_flushTime += timer.elapsed();
     return result;
 }
 
+double Excel::Table::rowsPerSecond() const
+{
+    if(!m_streamTimer.isValid() || m_streamTimer.elapsed() == 0) return 0;
+    return 1000.0*m_rowsFlushed/m_streamTimer.elapsed();
+}
+
+double Excel::Table::flushRowsPerSecond() const
+{
+    if(m_flushTime == 0) return 0;
+    return 1000.0*m_rowsFlushed/m_flushTime;
+}
+
 
 
 
@@ -1215,8 +4331,13 @@ void Excel::TableHeader1Line::placeData(Excel *pexcel, int x0, int y0, const QSt
 
     if(texts.count())
     {
-        pexcel->write(rect().toRange(), texts);
-        pexcel->setColor(rect().toRange(), Qt::darkGray, Qt::white);
+        CellStyle style;
+        style.setFont(m_font);
+        style.setBackground(Qt::darkGray);
+        style.setForeground(Qt::white);
+
+        pexcel->writeBlock(rect(), texts);
+        pexcel->applyStyle(rect(), style);
         pexcel->drawFrame(rect().toRange(), m_frame);
         // set tooltips
         foreach(const int &i, tooltips.keys())
@@ -1250,15 +4371,16 @@ Excel::TableStandardBody::TableStandardBody()
 
 void Excel::TableStandardBody::placeData(Excel *pexcel, int x0, int y0, const QStringList &texts)
 {    
-    if(texts.count()>0){
-        int rows = texts.count()/rect().width();
-        if( rows==0) rows=1;
-        for(int i=0;i<qMin(rows,rect().height());i++)
-        {
-            // put row
-            pexcel->write(rect().row(i).toRange(), texts.mid(i*rect().width(),rect().width()) ,m_font);
-
-        }
+    if(texts.count()>0 && rect().width()>0){
+        // whole body in one block, partial last row is padded
+        const int rows = qMin((texts.count() + rect().width() - 1)/rect().width(), rect().height());
+        Rect block = rect();
+        block.setHeight(rows);
+        pexcel->writeBlock(block, texts.mid(0, rows*rect().width()));
+
+        CellStyle style;
+        style.setFont(m_font);
+        pexcel->applyStyle(rect(), style);
     }
     pexcel->drawFrame(rect().toRange(),m_frame);
 }
@@ -15,12 +15,27 @@
 #include <QStringList>
 #include <QString>
 #include "excelenums.h"
+#include "exceldecimate.h"
+#include "exceladdress.h"
+#include "excelxlsxwriter.h"
 
 #include <QRect>
+#include <QFont>
+#include <QColor>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QMap>
+#include <QMutex>
+#include <QTimer>
+
+class ExcelRangeSet;
+class ExcelSheetModel;
 
 class Excel : public QObject
 {
     Q_OBJECT
+    friend class ExcelSheetModel;
 public:
 
     class Frame
@@ -136,15 +151,14 @@ public:
     public:
         Cell(){m_x=0;m_y=0;}
         Cell(const QString &range){
-            QRegExp rx("([a-zA-Z]+)([0-9]+)");
-            if(rx.exactMatch(range.toUpper())){
+            ExcelAddress::Ref ref;
+            if(ExcelAddress::parseCell(range.constData(), range.size(), &ref)){
+                m_x = ref.col;
+                m_y = ref.row;
+            }
+            else {
                 m_x = 0;
-                for(int i=rx.cap(1).count()-1;i>=0;i--)
-                {
-                    if(i==rx.cap(1).count()-1) m_x = rx.cap(1)[i].toLatin1()-'A';
-                    else m_x += ((rx.cap(1)[i].toLatin1()-'A')+1)*26;
-                }
-                m_y = rx.cap(2).toInt()-1;
+                m_y = 0;
             }
         }
 
@@ -223,6 +237,23 @@ public:
         bool isEmpty() const {
             return m_p1.isEmpty() && m_p2.isEmpty();
         }
+        qint64 area() const {return qint64(width())*height();}
+        bool contains(const Rect &other) const {
+            return other.x() >= x() && other.y() >= y()
+                    && other.x() + other.width() <= x() + width()
+                    && other.y() + other.height() <= y() + height();
+        }
+        bool intersects(const Rect &other) const {
+            return x() < other.x() + other.width() && other.x() < x() + width()
+                    && y() < other.y() + other.height() && other.y() < y() + height();
+        }
+        // bounding rect of both
+        Rect united(const Rect &other) const {
+            const int x0 = qMin(x(), other.x());
+            const int y0 = qMin(y(), other.y());
+            return Rect(x0, y0, qMax(x() + width(), other.x() + other.width()) - x0
+                        , qMax(y() + height(), other.y() + other.height()) - y0);
+        }
         Cell p1() const {return m_p1;}
         Cell p2() const {return m_p2;}
 
@@ -259,6 +290,102 @@ public:
     };
 
 
+    // formatting intent of cell, only attributes which are set are applied
+    class CellStyle
+    {
+    public:
+        enum {
+            HasFont = 1,
+            HasBackground = 2,
+            HasForeground = 4
+        };
+
+        CellStyle(){m_flags = 0;}
+
+        void setFont(const QFont &font) {
+            m_font = font;
+            m_flags |= HasFont;
+        }
+        void setBackground(const QColor &color) {
+            m_background = color;
+            m_flags |= HasBackground;
+        }
+        void setForeground(const QColor &color) {
+            m_foreground = color;
+            m_flags |= HasForeground;
+        }
+        // attributes of other override ours
+        void merge(const CellStyle &other) {
+            if(other.hasFont()) setFont(other.font());
+            if(other.hasBackground()) setBackground(other.background());
+            if(other.hasForeground()) setForeground(other.foreground());
+        }
+
+        bool hasFont() const {return m_flags & HasFont;}
+        bool hasBackground() const {return m_flags & HasBackground;}
+        bool hasForeground() const {return m_flags & HasForeground;}
+        bool isEmpty() const {return m_flags == 0;}
+
+        bool operator==(const CellStyle &other) const {
+            return m_flags == other.m_flags
+                    && (!hasFont() || m_font.key() == other.m_font.key())
+                    && (!hasBackground() || m_background == other.m_background)
+                    && (!hasForeground() || m_foreground == other.m_foreground);
+        }
+        bool operator!=(const CellStyle &other) const {return !(*this == other);}
+
+        // content hash, equal styles have equal hash
+        uint hash() const {
+            uint h = m_flags;
+            if(hasFont()) h = h*31 + qHash(m_font.key());
+            if(hasBackground()) h = h*31 + m_background.rgba();
+            if(hasForeground()) h = h*31 + m_foreground.rgba();
+            return h;
+        }
+
+        QFont font() const {return m_font;}
+        QColor background() const {return m_background;}
+        QColor foreground() const {return m_foreground;}
+
+    private:
+        quint32 m_flags;
+        QFont m_font;
+        QColor m_background;
+        QColor m_foreground;
+    };
+
+
+    // resolves overlapping frames of one sheet to minimal set of border operations
+    class BorderPlanner
+    {
+    public:
+        enum {BorderAround = 0}; // otherwise XlBordersIndex
+
+        struct Operation{
+            Rect rect;
+            int border;
+            int style;  // Frame::Line*
+            int width;  // Frame::Width*
+        };
+
+        // later requests win where lines overlap
+        void add(const Rect &rect, const Frame &frame);
+        void clear() {m_requests.clear();}
+        bool isEmpty() const {return m_requests.isEmpty();}
+        QList<Operation> plan() const;
+        // automation calls needed to execute operations
+        static int callCount(const QList<Operation> &operations);
+        int callCount() const {return callCount(plan());}
+
+    private:
+        struct Request{
+            Rect rect;
+            Frame frame;
+        };
+        QList<Request> m_requests;
+    };
+
+
     class DataArea
     {
         public:
@@ -292,6 +419,11 @@ public:
         Table();
         Table(Excel*pexcel, const Rect &rect);
         ~Table(){
+            // excel detaches tables on close and destruction
+            if(mp_excel){
+                flush();
+                mp_excel->m_tables.removeAll(this);
+            }
             if(mp_dataArea != 0)
                 delete mp_dataArea;
             if(mp_headerArea != 0)
@@ -307,6 +439,18 @@ public:
         void setTableData(const QStringList &data);
 
         bool appendDataRow(const QStringList &data);
+        /* appended rows are kept in memory and written as one block when
+           rows count or msec since first pending row is reached. Rows are
+           written to table sheet, current sheet may be other */
+        void setFlushPolicy(int rows, int msec = 0);
+        bool flush();
+        int pendingRows() const {return m_pending.count();}
+        void setFont(const QFont &font) {m_font = font;}
+        // frame drawn around every flushed block
+        void setAppendFrame(const Frame &frame) {m_appendFrame = frame;}
+        // appended rows per second of wall time and of time spent in flush
+        double rowsPerSecond() const;
+        double flushRowsPerSecond() const;
         int width() { return m_rect.width();}
         int height() {return m_rect.height();}
 
@@ -319,8 +463,11 @@ public:
 
 
     private:
+        friend class Excel;
+
         Excel *mp_excel;
         AxObject::Class m_dataRange;// excel id
+        QString m_sheetName;
         Rect m_rect;
         DataArea *mp_headerArea;
         DataArea *mp_dataArea;
@@ -328,6 +475,15 @@ public:
         int m_height;// rows
         int m_width; // columns
         QFont m_font;
+        Frame m_appendFrame;
+
+        QList<QStringList> m_pending; // rows not written yet
+        int m_flushRows;
+        int m_flushMsec;
+        QElapsedTimer m_pendingTimer;
+        QElapsedTimer m_streamTimer;
+        qint64 m_flushTime;
+        qint64 m_rowsFlushed;
     };
 
 
@@ -382,12 +538,235 @@ public:
         bool majorGridLines;
     };
 
+    // chart series given by values, x empty - point index is used
+    struct ChartSeries{
+        QString name;
+        QVector<double> x;
+        QVector<double> y;
+    };
 
+    /* series of existing chart updated in place. Last window() points are
+       kept in memory, decimated and put at most frameRate times per second,
+       points held back by frame rate are put by excel's frame timer.
+       Screen updating is off only while a frame is put. Excel detaches
+       series on close, detached series do no COM calls */
+    class LiveSeries
+    {
+    public:
+        LiveSeries(Excel *pexcel, AxObject::Class chart, int series = 1);
+        ~LiveSeries();
+
+        void setFrameRate(double fps);
+        double frameRate() const {return m_fps;}
+        // only last points are shown, 0 - all points, memory grows then
+        void setWindow(int points) {m_window = points;}
+        int window() const {return m_window;}
+        /* Lttb to 1000 points by default, fewer when values do not fit
+           SERIES formula, see ExcelDecimate::MaxSeriesLiteral */
+        void setDecimation(ExcelDecimate::Mode mode, int max_points);
+
+        bool isValid() const {return m_series != 0;}
+        void append(double x, double y);
+        void append(const QVector<double> &x, const QVector<double> &y);
+        void clear();
+        // puts pending points now, regardless of frame rate
+        bool redraw();
+
+        int pointsCount() const {return m_x.size();}
+        int pendingPoints() const {return m_pending;}
+        int framesDrawn() const {return m_frames;}
+        double framesPerSecond() const;
 
+    private:
+        friend class Excel;
+        void redrawIfDue();
+        int msecToFrame() const;
 
+        Excel *mp_excel;
+        AxObject::Class m_series;
+        QVector<double> m_x;
+        QVector<double> m_y;
+        double m_fps;
+        int m_window;
+        ExcelDecimate::Mode m_decimation;
+        int m_maxPoints;
+        int m_pending; // points appended since last frame
+        int m_frames;
+        QElapsedTimer m_frameTimer;
+        QElapsedTimer m_streamTimer;
+    };
+
+
+    /* fixed sheet region showing last rect.height() samples. Samples are
+       kept in client circular buffer, only rows changed since last refresh
+       are written (at most two blocks), at most refreshRate times per second,
+       samples held back by refresh rate are written by excel's ring timer.
+       Region stays on the sheet current at construction. Samples overwritten
+       before they reached excel are counted as dropped. Excel detaches
+       regions on close, detached region does no COM calls */
+    class RingRegion
+    {
+    public:
+        RingRegion(Excel *pexcel, const Rect &rect);
+        ~RingRegion();
+
+        void setRefreshRate(double hz) {m_hz = hz;}
+        double refreshRate() const {return m_hz;}
+        // newest sample at bottom row, whole region is written on refresh
+        void setRotated(bool on) {m_rotated = on;}
+        bool rotated() const {return m_rotated;}
+        // background of newest row in wrapped mode, invalid - no marker
+        void setHeadMarker(const QColor &marker, const QColor &background = Qt::white);
+
+        bool append(const QVariantList &row);
+        bool flush();
+
+        Rect rect() const {return m_rect;}
+        int capacity() const {return m_rect.height();}
+        int count() const {return (int)qMin<qint64>(m_total, capacity());}
+        int pendingSamples() const {return (int)(m_total - m_flushed);}
+        qint64 samplesAppended() const {return m_total;}
+        qint64 droppedSamples() const {return m_dropped;}
+        qint64 rowsWritten() const {return m_rowsWritten;}
+
+    private:
+        friend class Excel;
+        bool writeSlots(int first, int count);
+        bool moveMarker();
+        bool paintSlot(int slot, const QColor &background);
+        int msecToRefresh() const;
+
+        Excel *mp_excel;
+        AxObject::Class m_range;    // region on its sheet, excel id
+        QString m_sheetName;
+        Rect m_rect;
+        QVector<QVariantList> m_ring;
+        qint64 m_total;     // samples appended
+        qint64 m_flushed;   // samples written or dropped
+        qint64 m_dropped;
+        qint64 m_rowsWritten;
+        double m_hz;
+        bool m_rotated;
+        QColor m_marker;
+        QColor m_markerBackground;
+        int m_markerSlot;
+        QElapsedTimer m_refreshTimer;
+    };
+
+
+
+
+
+    // conditional formatting rule evaluated by excel
+    struct ConditionRule{
+        enum Type{
+            CellValue,  // comparison of cell value with formula1 (formula2)
+            Expression, // formula1 evaluates to true
+            ColorScale, // lowColor .. (midColor) .. highColor
+            DataBar     // bar of background color
+        };
+        ConditionRule() {type = CellValue; comparison = xlGreater;}
+
+        Type type;
+        int comparison; // XlFormatConditionOperator
+        QString formula1;
+        QString formula2;
+        QColor background;
+        QColor foreground;
+        QColor lowColor;
+        QColor midColor;
+        QColor highColor;
+
+        bool operator==(const ConditionRule &other) const {
+            return type == other.type && comparison == other.comparison
+                    && formula1 == other.formula1 && formula2 == other.formula2
+                    && background == other.background && foreground == other.foreground
+                    && lowColor == other.lowColor && midColor == other.midColor
+                    && highColor == other.highColor;
+        }
+    };
+
+
+
+    // font and colors of cell, invalid background means no fill
+    struct CellFormat{
+        CellFormat() {fontSize = 0; bold = false; italic = false;}
+        QString fontName;
+        double fontSize;
+        bool bold;
+        bool italic;
+        QColor foreground;
+        QColor background;
+
+        QString key() const {
+            return QString("%1|%2|%3|%4|%5|%6").arg(fontName).arg(fontSize).arg(bold).arg(italic)
+                    .arg(foreground.isValid() ? foreground.name() : QString())
+                    .arg(background.isValid() ? background.name() : QString());
+        }
+    };
+
+    // values and formats of range, cells are row-major
+    struct FormatSnapshot{
+        FormatSnapshot() {width = 0; height = 0;}
+        int width;
+        int height;
+        QVector<int> styleIds;      // index to styles
+        QList<CellFormat> styles;   // distinct formats
+        QVariantList values;
+
+        CellFormat format(int row, int col) const {
+            return styles.value(styleIds.value(row*width + col, -1));
+        }
+    };
+
+
+
+    // sheet of workbook snapshot, handle and used range are fetched on demand
+    struct SheetInfo{
+        SheetInfo() {index = 0; handle = 0;}
+        QString name;
+        int index;                  // 1-based position in Sheets
+        AxObject::Class handle;     // 0 - not fetched
+        QString usedRange;          // empty - not fetched or changed
+    };
+
+    // workbook metadata kept by library, updated by its own sheet operations
+    struct WorkbookInfo{
+        WorkbookInfo() {valid = false; readOnly = false; visible = false; namesValid = false;}
+        bool valid;
+        QString fullName;
+        bool readOnly;
+        bool visible;       // excel window
+        QList<SheetInfo> sheets;
+        bool namesValid;
+        QMap<QString, QString> names; // named range -> RefersTo
+
+        int indexOf(const QString &sheetname) const {
+            for(int i=0; i<sheets.count(); i++)
+                if(sheets[i].name.compare(sheetname, Qt::CaseInsensitive) == 0) return i;
+            return -1;
+        }
+    };
+
+
+
+    /* ComBackend drives running Excel, XlsxBackend writes file directly by
+       ExcelXlsxWriter without Excel. Xlsx backend supports open, close,
+       save, sheets, write, writeBlock, SetDataTo*, CreateTable, setColor,
+       applyStyle, drawFrame and mergeRange, other calls fail. Xlsx rows are
+       streamed: rows more than xlsxWriter()->rowWindow() (1024) above the
+       last written row are on disk already, writes there fail as late
+       writes. SetDataToColumn and other column-at-a-time fills of a table
+       taller than the window fail so, fill such tables by rows. Without
+       Windows only XlsxBackend works, COM objects are invalid */
+    enum Backend {ComBackend, XlsxBackend};
 
     explicit Excel(const QString filename, bool use_thread=false,bool autosave=true);
+    Excel(const QString filename, Backend backend, bool autosave=true);
     ~Excel();
+    Backend backend() const {return mp_xlsx ? XlsxBackend : ComBackend;}
+    // writer of xlsx backend, 0 for COM
+    ExcelXlsxWriter *xlsxWriter() {return mp_xlsx;}
     static bool validName(const QString &name);
     void setErrorSlot(QObject *pobj, const char *slot);
     QString fileName();
@@ -420,9 +799,27 @@ public:
     /* write data to cell*/
     bool write(Excel::Cell cell, const QVariant &data, const QFont &font= QFont() );
     bool write(qint32 row, qint32 col, const QVariant &data, const QFont &font= QFont()  );
+    /* write combining: sequential write(row,col) calls without font along
+       a row or a column (wrapping to next row or column) are held back and
+       written as blocks when sequence breaks, on read, other write or after
+       flush_msec. read() sees held values */
+    void setWriteCombining(bool on, int flush_msec = 50);
+    bool writeCombining() const {return m_combineEnabled;}
+    bool flushCombined();
+    qint64 combinedWrites() const {return m_combinedWrites;}
+    qint64 combinedBlocks() const {return m_combinedBlocks;}
     bool write(AxObject::Class range, qint32 row, qint32 col, const QVariant &data, const QFont &font= QFont()  );
     bool write(const QString &range, const QStringList &l, const QFont &font=QFont());
+    // one typed Value2 block write, row-major texts, font applied once
+    bool writeBlock(const Rect &rect, const QStringList &texts, const QFont &font=QFont());
     bool mergeRange(const QString &range, bool on=true);
+    // every given rectangle is merged on its own
+    bool mergeRange(const QList<Rect> &rects, bool on=true);
+    /* every rectangle of canonical decomposition (cells.rects()) is merged:
+       adjacent areas are fused, L-shapes split. Use QList<Rect> to merge
+       areas as given */
+    bool mergeRange(const ExcelRangeSet &cells, bool on=true);
+    bool clearRange(const ExcelRangeSet &cells, bool contents_only=true);
     //reads range of data
     bool readRange(const QString &range, QVariantList *presult);
     bool writeRange(const QString &range, QVariantList l);
@@ -435,16 +832,79 @@ public:
 
     /* reads data from cell*/
     bool read(qint32 row, qint32 col, QVariant &data);
+    /* reads scattered cells, results in order of cells. Cells are grouped
+       into rectangles read by one Value2 call each; rectangle grows while
+       the cells read in vain cost less than call_cost cells */
+    bool readCells(const QList<Cell> &cells, QVariantList *presult, int call_cost = 256);
+    static QList<Rect> planGather(const QList<Cell> &cells, int call_cost);
+    /* read cache: UsedRange Value of sheet is fetched in chunks of rows on
+       first read() of a chunk and reads are served locally with the types
+       read() returns without cache (dates are QDateTime). Library writes
+       drop the chunks they touch, or the whole sheet when it has formulas
+       or the write leaves the used range */
+    void setReadCacheEnabled(bool on);
+    bool readCacheEnabled() const {return m_readCacheEnabled;}
+    bool refreshReadCache();
+    qint64 readCacheHits() const {return m_readHits;}
+    qint64 readCacheMisses() const {return m_readMisses;}
+    double readCacheHitRate() const;
+    // cells and approximate bytes held for all sheets
+    qint64 readCacheCells() const;
+    qint64 readCacheBytes() const;
     void setAutoSaveOn(bool on);
     bool autoSaveOn() const {return m_autosave;}
     bool drawFrame(const QString &range, const Frame &f);
     bool drawFrame(const Rect &rect, const Frame &f);
+    bool drawFrames(const BorderPlanner &planner);
+    /* frames drawn until flushFrames() are collected and resolved together */
+    void beginFrames();
+    bool flushFrames();
     /* sets color of cell*/
     bool setColor(qint32 row, qint32 col, const QColor background, const QColor foreground);
     bool setColor(const QString &range, const QColor background, const QColor foreground);
     bool setColor(const Rect &rect, const QColor background, const QColor foreground);
+    bool setColor(const ExcelRangeSet &cells, const QColor background, const QColor foreground);
+    /* paints color matrix, calls depend on palette size not cells count */
+    bool setColors(const Rect &rect, const QList<QColor> &backgrounds
+                   , const QList<QColor> &foregrounds = QList<QColor>());
     /* gets color of cell */
     bool color(qint32 row, qint32 col, QColor &background, QColor &foreground);
+    /* reads values and formats of range in one call as XML spreadsheet */
+    bool readFormats(const QString &range, FormatSnapshot *psnapshot);
+
+    /* formatting buffer: cell styles, setColor(row,col) and fonts of
+       write(row,col) are collected until flushFormat() */
+    void beginFormat();
+    bool flushFormat();
+    bool isFormatBuffered() const {return m_formatBuffered;}
+    bool setCellStyle(qint32 row, qint32 col, const CellStyle &style);
+
+    /* named workbook styles: style is added to Styles collection once per
+       workbook, equal styles share one name */
+    QString registerStyle(const CellStyle &style);
+    bool applyStyle(const QString &range, const CellStyle &style);
+    bool applyStyle(const Rect &rect, const CellStyle &style);
+    bool applyStyle(const ExcelRangeSet &cells, const CellStyle &style);
+
+    /* replaces conditional formats of range in one operation, applying
+       the same rules to the same range again is skipped */
+    bool setConditionalFormats(const QString &range, const QList<ConditionRule> &rules);
+    bool setConditionalFormats(const Rect &rect, const QList<ConditionRule> &rules);
+    bool clearConditionalFormats(const QString &range);
+
+    /* last-write-wins cell updates: post() keeps latest value of cell only
+       and never calls excel, any thread may post. Dirty cells of current
+       sheet are written every tick_msec as contiguous blocks. Direct
+       writes and clears of a cell drop its posted value */
+    void beginCoalescing(int tick_msec = 100);
+    void endCoalescing();
+    bool isCoalescing() const {return m_postTimer.isActive();}
+    void post(qint32 row, qint32 col, const QVariant &data);
+    bool flushPosted();
+    // posted values, values replaced before flush, values written
+    qint64 postedCount() const {return m_postedCount;}
+    qint64 coalescedCount() const {return m_coalescedCount;}
+    qint64 postedWritten() const {return m_postedWritten;}
     /* sets visible workbook*/
     bool setVisible(bool visible);
     bool visible();
@@ -457,13 +917,29 @@ public:
     bool saveAs(const QString &);
 
     QStringList namedRanges();
+    QString namedRangeAddress(const QString &name);
+
+    /* metadata snapshot, fetched once per workbook in few calls and then
+       served locally; sheetsList(), sheetsCount(), fileName(), isReadOnly()
+       use it */
+    const WorkbookInfo &workbookInfo();
+    void invalidateWorkbookInfo();
+    AxObject::Class sheetHandle(const QString &sheetname);
+    // address of used range, current sheet when sheetname is empty
+    QString usedRange(const QString &sheetname = QString());
 
     bool test();
     static QString Cell_To_Name(const Cell &cell, bool fixed=false);
     static QString Rect_To_Range(const Rect &rect, bool fixed=false);
     static Cell Name_To_Cell(const QString &xl_name);
     static Rect Range_To_Rect(const QString &xl_range);
+    // cell address of ExcelAddress syntax or defined name like "Results"
     static bool Range_Is_Valid(const QString &range);
+    static bool Name_Is_Valid(const QString &name);
+    // decomposes cells to row runs merged vertically into rectangles
+    static QList<Rect> Cells_To_Rects(QList<Cell> cells);
+    // multi-area ranges "A1:B2,D4" not longer than max_length
+    static QStringList Rects_To_Ranges(const QList<Rect> &rects, int max_length=255);
 
     Excel::Table *CreateTable(const Rect &range
                                 , const QStringList &headers
@@ -476,26 +952,125 @@ public:
     bool AppendRow(Table *ptable, const QStringList &data);
     bool SetDataToColumn(Table *ptable, const QVariantList &data, int column);
     bool SetDataToRange(const Excel::Rect &rect, QVariantList data);
+    // block write to named sheet, current sheet stays
+    bool SetDataToRange(const QString &sheetname, const Excel::Rect &rect, QVariantList data);
     bool SetDataToRow(Table *ptable, const QVariantList &data, int row);
 
+    struct UpsertStats{
+        UpsertStats() {rowsUnchanged = 0; rowsWritten = 0; rowsMoved = 0; rowsCleared = 0; calls = 0;
+                       callsSaved = 0; bytesWritten = 0; bytesSaved = 0;}
+        int rowsUnchanged;
+        int rowsWritten;        // changed and new rows, with rewritten gaps
+        int rowsMoved;          // matched rows moved by cut
+        int rowsCleared;
+        int calls;              // read, writes and clears
+        int callsSaved;         // against one full write and one clear, may be negative
+        qint64 bytesWritten;    // approximate VARIANT payload
+        qint64 bytesSaved;
+    };
+    /* refresh of table at top_left: old_count rows on sheet are read once
+       and matched by row hash with rows, inserted or deleted rows do not
+       rewrite the rows after them. Matched runs at other position are moved,
+       other rows written, vacated rows cleared. Runs are joined when the
+       unchanged cells between them cost less than call_cost cells */
+    bool upsertRows(const Cell &top_left, int width, int old_count, const QList<QVariantList> &rows
+                    , UpsertStats *pstats = 0, int call_cost = 256);
+    // rect.height() rows on sheet, empty region needs the overload above
+    bool upsertRows(const Rect &rect, const QList<QVariantList> &rows, UpsertStats *pstats = 0, int call_cost = 256);
+
     int width(const QString &range);
     int height(const QString &range);
 
+    // request deadline in msec for threaded excel, hung server is restarted
+    void setRequestTimeout(int msec, bool recycle = true);
+    // idle check of threaded excel in msec, crashed or closed server is restarted
+    void setWatchdogInterval(int msec);
+
+    /* events and calculation off/on, calls nest: wrap a loop of
+       SetDataToColumn() in setUpdatesOn(0)/(1) to switch once */
     void setUpdatesOn(bool on);
     void setCalculation(bool on);
     void setScreenUpdate(bool on);
+    bool screenUpdate();
     void recalculate();
     static int version();
     // *****************charts************************
 
-    // charts
+    // charts, formatting is cached as chart template per chart style
     AxObject::Class CreateChart(const Chart &chart);
+    // series from arrays, no cells are written, 0 when a series is refused
+    AxObject::Class CreateChart(const Chart &chart, const QList<ChartSeries> &series
+                                , ExcelDecimate::Mode decimation = ExcelDecimate::Lttb, int max_points = 1000);
+    double chartsPerSecond() const;
 
+    // 0 for XlsxBackend, no COM object is created
     AxObject *object() {return mp_exlObject;}
 
     bool SetChartData(AxObject::Class chart, const QString &range);
 
+    // incremented when sheets are added, removed or workbook is closed
+    int sheetGeneration() const {return m_sheetGeneration;}
+
 private:    
+    void putFont(AxObject::Class parent, const QString &path, const QFont &font, bool cached = true);
+    static bool shadowOverlap(const QString &a, const QString &b);
+    static quint32 toXlColor(const QColor &color);
+    static QVariant typedValue(const QString &text, bool quote);
+    bool putColorGroups(const QHash<quint32, QList<Cell> > &groups, const QString &property);
+    void dropPosted(const Rect &rect);
+    void flushSheetBuffers();
+    void nextSheetGeneration();
+    bool fetchSheetNames();
+    void refreshFileInfo();
+    void fetchNames();
+    // rect - written cells, empty when unknown
+    void sheetDataChanged(const QString &sheetname = QString(), const Rect &rect = Rect());
+    QString currentSheetName();
+
+    // Value of used range, QVariant::Type byte and one double per cell
+    struct ReadGrid{
+        Rect rect;
+        bool formulas;              // writes may change other cells
+        int chunkRows;              // rows read by one call
+        QVector<bool> loaded;       // per chunk
+        QVector<quint8> types;
+        QVector<double> numbers;    // number, bool, date or time
+        QHash<int, QString> texts;  // cell index -> text
+        void set(int index, const QVariant &data);
+        QVariant get(int index) const;
+    };
+    bool loadReadGrid(ReadGrid *pgrid);
+    bool loadReadChunk(ReadGrid *pgrid, int chunk);
+
+    // sequential writes held back, values in order of writes
+    struct WriteCombiner{
+        enum {None, RowMajor, ColumnMajor};
+        WriteCombiner() {row = 0; col = 0; direction = None; span = 0;}
+        qint32 row;         // first cell, 1-based
+        qint32 col;
+        int direction;
+        int span;           // row width or column height, 0 - not wrapped yet
+        QVariantList values;
+        bool next(qint32 r, qint32 c);
+        int indexOf(qint32 r, qint32 c) const;
+    };
+    bool combineWrite(qint32 row, qint32 col, const QVariant &data);
+    void init(const QString &filename, bool use_thread, bool autosave, Backend backend);
+    static ExcelXlsxWriter::Style xlsxStyle(const CellStyle &style);
+    bool xlsxFrame(const Rect &rect, const Frame &f);
+    bool putFrame(AxObject::Class parent, const QString &range, const Frame &f);
+    void scheduleTableFlush(int msec);
+    void scheduleSeriesRedraw(int msec);
+    void scheduleRingFlush(int msec);
+    void detachTables(bool flush);
+
+    AxObject::Class addChartShape(const Chart &chart, AxObject::Class *ppchart);
+    void applyChartStyle(AxObject::Class pChart, const Chart &chart);
+    static QString chartTemplateKey(const Chart &chart, int series_count);
+    void clearChartTemplates();
+    void formatChart(AxObject::Class pChart, const Chart &chart);
+    void setChartTexts(AxObject::Class pChart, const Chart &chart);
+
     AxObject *mp_exlObject;
 
     AxObject::Class mp_currentSheet;
@@ -507,13 +1082,61 @@ private:
     bool m_saved;
     bool m_autosave;
     bool m_badFile;
+    ExcelXlsxWriter *mp_xlsx;
     bool m_updatesOn;
+    int m_updatesDepth;         // nested setUpdatesOn(0) calls
+    int m_sheetGeneration;
+    int m_replayedRecycles;     // recycle count of last replay
+    bool m_formatBuffered;
+    QHash<quint64, CellStyle> m_formatCells; // (row<<32|col) -> style
+    QHash<QString, CellStyle> m_styles; // registered style name -> style
+    bool m_framesBuffered;
+    BorderPlanner m_framePlanner;
+    QHash<AxObject::Class, QHash<QString, QList<ConditionRule> > > m_conditionRules; // sheet -> range -> rules
+    QHash<QString, QString> m_chartTemplates; // style key -> template file
+    int m_chartsCreated;
+    qint64 m_chartTime;
+    WorkbookInfo m_info;
+    bool m_readCacheEnabled;
+    QHash<QString, ReadGrid> m_readGrids; // sheet name -> values
+    qint64 m_readHits;
+    qint64 m_readMisses;
+    bool m_combineEnabled;
+    WriteCombiner m_combiner;
+    QTimer m_combineTimer;
+    qint64 m_combinedWrites;
+    qint64 m_combinedBlocks;
+    QMutex m_postMutex;
+    QHash<quint64, QVariant> m_posted; // (row<<32|col) -> latest value
+    QTimer m_postTimer;
+    qint64 m_postedCount;
+    qint64 m_coalescedCount;
+    qint64 m_postedWritten;
+    QList<Table*> m_tables;    // tables created on this workbook
+    QTimer m_tableTimer;
+    QList<LiveSeries*> m_liveSeries;
+    QTimer m_seriesTimer;
+    QList<RingRegion*> m_rings;
+    QTimer m_ringTimer;
+    QList<ExcelSheetModel*> m_models;   // notified of writes to their sheet
 signals:
 
 public slots:
 
+private slots:
+    void slot_serverRecycled();
+    void slot_flushPosted();
+    void slot_flushCombined();
+    void slot_flushTables();
+    void slot_redrawSeries();
+    void slot_flushRings();
 };
 
+inline uint qHash(const Excel::CellStyle &style)
+{
+    return style.hash();
+}
+
 //class AxBag:public QMap<QString , AxObject::Class>
 //{
 
@@ -5,9 +5,28 @@ HEADERS +=\
     $$PWD/axobject.h \
     $$PWD/excel.h \
     $$PWD/excelenums.h\
+    $$PWD/exceldecimate.h \
+    $$PWD/exceladdress.h \
+    $$PWD/excelrangeset.h \
+    $$PWD/excelsheetmodel.h \
+    $$PWD/excelupsert.h \
+    $$PWD/excelxlsxwriter.h \
+    $$PWD/excelxlsxreader.h \
     $$PWD/excel_tabledef.h 
 
 SOURCES +=\
-    $$PWD/axobject.cpp \
-    $$PWD/excel.cpp
+    $$PWD/excel.cpp \
+    $$PWD/exceldecimate.cpp \
+    $$PWD/exceladdress.cpp \
+    $$PWD/excelrangeset.cpp \
+    $$PWD/excelsheetmodel.cpp \
+    $$PWD/excelupsert.cpp \
+    $$PWD/excelxlsxwriter.cpp \
+    $$PWD/excelxlsxreader.cpp
 
+# ActiveX on windows only, elsewhere just the xlsx backend works
+win32 {
+    SOURCES += $$PWD/axobject.cpp
+} else {
+    SOURCES += $$PWD/axobject_none.cpp
+}
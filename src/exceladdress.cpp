@@ -0,0 +1,488 @@
+/**
+ * @file:exceladdress.cpp   -
+ * @description: Parser and formatter of excel cell addresses.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#include "exceladdress.h"
+
+
+// labels of all columns, filled once on first use
+struct ColumnLabels
+{
+    char labels[ExcelAddress::MaxColumns][4];
+
+    ColumnLabels()
+    {
+        for(int col=0; col<ExcelAddress::MaxColumns; col++)
+        {
+            char *p = labels[col];
+            if(col < 26)
+            {
+                p[0] = 'A' + col;
+                p[1] = 0;
+            }
+            else if(col < 26 + 26*26)
+            {
+                const int c = col - 26;
+                p[0] = 'A' + c/26;
+                p[1] = 'A' + c%26;
+                p[2] = 0;
+            }
+            else
+            {
+                const int c = col - 26 - 26*26;
+                p[0] = 'A' + c/(26*26);
+                p[1] = 'A' + (c/26)%26;
+                p[2] = 'A' + c%26;
+                p[3] = 0;
+            }
+        }
+    }
+};
+
+static const ColumnLabels &columnLabels()
+{
+    static const ColumnLabels table;
+    return table;
+}
+
+static inline bool isLetter(const QChar &c)
+{
+    const ushort u = c.unicode() | 0x20;
+    return u >= 'a' && u <= 'z';
+}
+
+static inline bool isDigit(const QChar &c)
+{
+    return c.unicode() >= '0' && c.unicode() <= '9';
+}
+
+const char *ExcelAddress::columnLabel(int col)
+{
+    if(col < 0 || col >= MaxColumns) return 0;
+    return columnLabels().labels[col];
+}
+
+int ExcelAddress::writeNumber(int value, char *buf)
+{
+    char tmp[12];
+    int len = 0;
+    int start = 0;
+    unsigned int v = value;
+    if(value < 0)
+    {
+        buf[start++] = '-';
+        v = 0u - v;
+    }
+    do{
+        tmp[len++] = '0' + v%10;
+        v /= 10;
+    }while(v);
+
+    for(int i=0; i<len; i++)
+        buf[start + i] = tmp[len - 1 - i];
+    buf[start + len] = 0;
+    return start + len;
+}
+
+int ExcelAddress::parseNumber(const QChar *s, int len, int *pvalue)
+{
+    int i = 0;
+    int value = 0;
+    // more digits than rows count has are not a number of sheet
+    while(i < len && i < 8 && isDigit(s[i]))
+    {
+        value = value*10 + (s[i].unicode() - '0');
+        i++;
+    }
+    if(i < len && i == 8 && isDigit(s[i])) return 0;
+    *pvalue = value;
+    return i;
+}
+
+/****************************************************************************
+ * @function name: ExcelAddress::formatCell()
+ * @param:
+ *      const Ref &ref - cell
+ *      char *buf - output, at least MaxCellLength chars
+ * @description: writes A1 name of cell, $ for absolute parts
+ * @return: ( int ) length of text, 0 if cell is out of sheet
+ ****************************************************************************/
+int ExcelAddress::formatCell(const Ref &ref, char *buf)
+{
+    const char *label = columnLabel(ref.col);
+    if(label == 0 || ref.row < 0 || ref.row >= MaxRows)
+    {
+        buf[0] = 0;
+        return 0;
+    }
+
+    int len = 0;
+    if(ref.flags & AbsoluteColumn) buf[len++] = '$';
+    while(*label) buf[len++] = *label++;
+    if(ref.flags & AbsoluteRow) buf[len++] = '$';
+    return len + writeNumber(ref.row + 1, buf + len);
+}
+
+/****************************************************************************
+ * @function name: ExcelAddress::formatArea()
+ * @param:
+ *      const Area &area - area, sheet is not written
+ *      char *buf - output, at least MaxAreaLength chars
+ * @description: single cell area is written as cell, "A:C" and "1:3" for
+ *               whole columns and rows
+ * @return: ( int ) length of text, 0 on error
+ ****************************************************************************/
+int ExcelAddress::formatArea(const Area &area, char *buf)
+{
+    int len = 0;
+    if(area.type == Columns)
+    {
+        const char *first = columnLabel(area.first.col);
+        const char *last = columnLabel(area.last.col);
+        if(first == 0 || last == 0) {buf[0] = 0; return 0;}
+        if(area.first.flags & AbsoluteColumn) buf[len++] = '$';
+        while(*first) buf[len++] = *first++;
+        buf[len++] = ':';
+        if(area.last.flags & AbsoluteColumn) buf[len++] = '$';
+        while(*last) buf[len++] = *last++;
+        buf[len] = 0;
+        return len;
+    }
+
+    if(area.type == Rows)
+    {
+        if(area.first.row < 0 || area.last.row >= MaxRows) {buf[0] = 0; return 0;}
+        if(area.first.flags & AbsoluteRow) buf[len++] = '$';
+        len += writeNumber(area.first.row + 1, buf + len);
+        buf[len++] = ':';
+        if(area.last.flags & AbsoluteRow) buf[len++] = '$';
+        return len + writeNumber(area.last.row + 1, buf + len);
+    }
+
+    len = formatCell(area.first, buf);
+    if(len == 0) return 0;
+    if(area.last.col == area.first.col && area.last.row == area.first.row
+            && area.last.flags == area.first.flags) return len;
+
+    buf[len++] = ':';
+    const int last = formatCell(area.last, buf + len);
+    if(last == 0) {buf[0] = 0; return 0;}
+    return len + last;
+}
+
+/****************************************************************************
+ * @function name: ExcelAddress::formatR1C1()
+ * @param:
+ *      const Ref &ref - cell
+ *      char *buf - output, at least MaxR1C1Length chars
+ *      const Ref *pbase - cell relative parts are counted from, 0 - all
+ *                         parts are written absolute
+ * @return: ( int ) length of text
+ ****************************************************************************/
+int ExcelAddress::formatR1C1(const Ref &ref, char *buf, const Ref *pbase)
+{
+    int len = 0;
+    buf[len++] = 'R';
+    if(pbase == 0 || (ref.flags & AbsoluteRow))
+        len += writeNumber(ref.row + 1, buf + len);
+    else if(ref.row != pbase->row)
+    {
+        buf[len++] = '[';
+        len += writeNumber(ref.row - pbase->row, buf + len);
+        buf[len++] = ']';
+    }
+
+    buf[len++] = 'C';
+    if(pbase == 0 || (ref.flags & AbsoluteColumn))
+        len += writeNumber(ref.col + 1, buf + len);
+    else if(ref.col != pbase->col)
+    {
+        buf[len++] = '[';
+        len += writeNumber(ref.col - pbase->col, buf + len);
+        buf[len++] = ']';
+    }
+    buf[len] = 0;
+    return len;
+}
+
+bool ExcelAddress::parseColumn(const QChar *s, int len, int *pcol)
+{
+    if(len < 1 || len > 3) return false;
+    int col = 0;
+    for(int i=0; i<len; i++)
+    {
+        if(!isLetter(s[i])) return false;
+        col = col*26 + ((s[i].unicode() | 0x20) - 'a' + 1);
+    }
+    if(col > MaxColumns) return false;
+    *pcol = col - 1;
+    return true;
+}
+
+bool ExcelAddress::parseRow(const QChar *s, int len, int *prow)
+{
+    int row = 0;
+    if(len < 1 || parseNumber(s, len, &row) != len) return false;
+    if(row < 1 || row > MaxRows) return false;
+    *prow = row - 1;
+    return true;
+}
+
+/****************************************************************************
+ * @function name: ExcelAddress::parseCell()
+ * @param:
+ *      const QChar *s, int len - text "B7", "$B$7", "b$7"
+ *      Ref *pref - output
+ * @return: ( bool ) true if whole text is one cell of sheet
+ ****************************************************************************/
+bool ExcelAddress::parseCell(const QChar *s, int len, Ref *pref)
+{
+    int i = 0;
+    int flags = 0;
+    if(i < len && s[i] == QLatin1Char('$')) {flags |= AbsoluteColumn; i++;}
+
+    const int letters = i;
+    while(i < len && isLetter(s[i])) i++;
+    int col = 0;
+    if(!parseColumn(s + letters, i - letters, &col)) return false;
+
+    if(i < len && s[i] == QLatin1Char('$')) {flags |= AbsoluteRow; i++;}
+    int row = 0;
+    if(!parseRow(s + i, len - i, &row)) return false;
+
+    pref->col = col;
+    pref->row = row;
+    pref->flags = flags;
+    return true;
+}
+
+/****************************************************************************
+ * @function name: ExcelAddress::parseR1C1()
+ * @param:
+ *      const QChar *s, int len - text "R2C3", "R[-1]C", "RC[4]"
+ *      Ref *pref - output, absolute parts get Absolute flags
+ *      const Ref *pbase - cell relative parts are counted from, 0 - A1
+ * @return: ( bool ) true if whole text is one cell of sheet
+ ****************************************************************************/
+bool ExcelAddress::parseR1C1(const QChar *s, int len, Ref *pref, const Ref *pbase)
+{
+    const Ref zero = {0, 0, 0};
+    const Ref &base = pbase ? *pbase : zero;
+    Ref ref = {base.col, base.row, 0};
+
+    int i = 0;
+    for(int part=0; part<2; part++)
+    {
+        const char name = part == 0 ? 'r' : 'c';
+        if(i >= len || (s[i].unicode() | 0x20) != name) return false;
+        i++;
+
+        int *pvalue = part == 0 ? &ref.row : &ref.col;
+        const int absolute = part == 0 ? AbsoluteRow : AbsoluteColumn;
+        const int base_value = part == 0 ? base.row : base.col;
+
+        if(i < len && s[i] == QLatin1Char('['))
+        {
+            i++;
+            bool negative = false;
+            if(i < len && (s[i] == QLatin1Char('-') || s[i] == QLatin1Char('+')))
+            {
+                negative = s[i] == QLatin1Char('-');
+                i++;
+            }
+            int offset = 0;
+            const int digits = parseNumber(s + i, len - i, &offset);
+            if(digits == 0) return false;
+            i += digits;
+            if(i >= len || s[i] != QLatin1Char(']')) return false;
+            i++;
+            *pvalue = base_value + (negative ? -offset : offset);
+        }
+        else if(i < len && isDigit(s[i]))
+        {
+            int value = 0;
+            const int digits = parseNumber(s + i, len - i, &value);
+            if(digits == 0 || value < 1) return false;
+            i += digits;
+            *pvalue = value - 1;
+            ref.flags |= absolute;
+        }
+    }
+
+    if(i != len) return false;
+    if(ref.col < 0 || ref.col >= MaxColumns || ref.row < 0 || ref.row >= MaxRows) return false;
+    *pref = ref;
+    return true;
+}
+
+/****************************************************************************
+ * @function name: ExcelAddress::parseArea()
+ * @param:
+ *      const QChar *s, int len - text "A1", "B2:A1", "$A:$C", "1:3"
+ *      Area *parea - output, corners are ordered first <= last
+ * @return: ( bool ) true if whole text is one area
+ ****************************************************************************/
+bool ExcelAddress::parseArea(const QChar *s, int len, Area *parea)
+{
+    int colon = -1;
+    for(int i=0; i<len; i++)
+    {
+        if(s[i] == QLatin1Char(':'))
+        {
+            if(colon >= 0) return false;
+            colon = i;
+        }
+    }
+
+    Area area;
+    area.sheetBegin = -1;
+    area.sheetLength = 0;
+    area.type = Cells;
+
+    if(colon < 0)
+    {
+        if(!parseCell(s, len, &area.first)) return false;
+        area.last = area.first;
+        *parea = area;
+        return true;
+    }
+
+    const QChar *right = s + colon + 1;
+    const int right_len = len - colon - 1;
+    if(parseCell(s, colon, &area.first) && parseCell(right, right_len, &area.last))
+    {
+        area.type = Cells;
+    }
+    else
+    {
+        // whole columns or whole rows, $ is allowed before each part
+        const QChar *parts[2] = {s, right};
+        int lengths[2] = {colon, right_len};
+        Ref *refs[2] = {&area.first, &area.last};
+        int type = -1;
+        for(int k=0; k<2; k++)
+        {
+            const QChar *p = parts[k];
+            int n = lengths[k];
+            bool fixed = false;
+            if(n > 0 && p[0] == QLatin1Char('$')) {fixed = true; p++; n--;}
+
+            int value = 0;
+            int part_type = -1;
+            if(parseColumn(p, n, &value)) part_type = Columns;
+            else if(parseRow(p, n, &value)) part_type = Rows;
+            if(part_type < 0 || (type >= 0 && part_type != type)) return false;
+            type = part_type;
+
+            if(type == Columns)
+            {
+                refs[k]->col = value;
+                refs[k]->row = k == 0 ? 0 : MaxRows - 1;
+                refs[k]->flags = fixed ? AbsoluteColumn : 0;
+            }
+            else
+            {
+                refs[k]->row = value;
+                refs[k]->col = k == 0 ? 0 : MaxColumns - 1;
+                refs[k]->flags = fixed ? AbsoluteRow : 0;
+            }
+        }
+        area.type = (AreaType)type;
+    }
+
+    // excel orders corners, flags stay with their coordinate
+    if(area.first.col > area.last.col)
+    {
+        qSwap(area.first.col, area.last.col);
+        const int f1 = area.first.flags & AbsoluteColumn;
+        const int f2 = area.last.flags & AbsoluteColumn;
+        area.first.flags = (area.first.flags & ~AbsoluteColumn) | f2;
+        area.last.flags = (area.last.flags & ~AbsoluteColumn) | f1;
+    }
+    if(area.first.row > area.last.row)
+    {
+        qSwap(area.first.row, area.last.row);
+        const int f1 = area.first.flags & AbsoluteRow;
+        const int f2 = area.last.flags & AbsoluteRow;
+        area.first.flags = (area.first.flags & ~AbsoluteRow) | f2;
+        area.last.flags = (area.last.flags & ~AbsoluteRow) | f1;
+    }
+    *parea = area;
+    return true;
+}
+
+/****************************************************************************
+ * @function name: ExcelAddress::parseRange()
+ * @param:
+ *      const QChar *s, int len - text of range
+ *      Area *pareas - output, may be 0
+ *      int max_areas - size of pareas
+ * @description: areas are separated by ','. Each area may be qualified by
+ *               sheet name, quoted when needed: 'My ''Data'''!A1. Sheet
+ *               name position is stored to area, name is not copied.
+ * @return: ( int ) count of areas, -1 on syntax error
+ ****************************************************************************/
+int ExcelAddress::parseRange(const QChar *s, int len, Area *pareas, int max_areas)
+{
+    if(len <= 0) return -1;
+
+    int count = 0;
+    int i = 0;
+    while(i <= len)
+    {
+        int sheet_begin = -1;
+        int sheet_length = 0;
+
+        if(i < len && s[i] == QLatin1Char('\''))
+        {
+            // quoted sheet, '' is a quote inside name
+            int j = i + 1;
+            while(j < len)
+            {
+                if(s[j] == QLatin1Char('\''))
+                {
+                    if(j + 1 < len && s[j+1] == QLatin1Char('\'')) {j += 2; continue;}
+                    break;
+                }
+                j++;
+            }
+            if(j >= len || j == i + 1 || j + 1 >= len || s[j+1] != QLatin1Char('!')) return -1;
+            sheet_begin = i + 1;
+            sheet_length = j - i - 1;
+            i = j + 2;
+        }
+        else
+        {
+            for(int j=i; j<len && s[j] != QLatin1Char(','); j++)
+            {
+                if(s[j] == QLatin1Char('!'))
+                {
+                    if(j == i) return -1;
+                    sheet_begin = i;
+                    sheet_length = j - i;
+                    i = j + 1;
+                    break;
+                }
+            }
+        }
+
+        int end = i;
+        while(end < len && s[end] != QLatin1Char(',')) end++;
+
+        Area area;
+        if(!parseArea(s + i, end - i, &area)) return -1;
+        area.sheetBegin = sheet_begin;
+        area.sheetLength = sheet_length;
+        if(pareas && count < max_areas) pareas[count] = area;
+        count++;
+
+        i = end + 1;
+        if(end == len) break;
+        if(i == len) return -1; // trailing ','
+    }
+    return count;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file:exceladdress.h   -
+ * @description: Parser and formatter of excel cell addresses: A1, $A$1,
+ *               R1C1, areas, multi-area and sheet-qualified references.
+ *               Works on caller buffers, no heap allocation.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#ifndef EXCELADDRESS_H
+#define EXCELADDRESS_H
+
+#include <QtGlobal>
+#include <QChar>
+#include <QString>
+
+class ExcelAddress
+{
+public:
+    enum {
+        MaxColumns = 16384,         // A .. XFD
+        MaxRows = 1048576,
+        MaxCellLength = 16,         // "$XFD$1048576" with terminating zero
+        MaxAreaLength = 32,         // two cells and ':'
+        MaxR1C1Length = 32          // "R[-1048575]C[-16383]" with zero
+    };
+
+    enum {
+        AbsoluteColumn = 1,         // $A
+        AbsoluteRow = 2             // $1
+    };
+
+    enum AreaType {
+        Cells,                      // A1, A1:B2
+        Columns,                    // A:C, rows cover whole sheet
+        Rows                        // 1:3, columns cover whole sheet
+    };
+
+    // cell reference, 0-based
+    struct Ref{
+        int col;
+        int row;
+        int flags;
+    };
+
+    // rectangle of cells, first and last are inclusive
+    struct Area{
+        Ref first;
+        Ref last;
+        AreaType type;
+        int sheetBegin;             // sheet name in parsed text, -1 - none
+        int sheetLength;
+    };
+
+    // count of letters of 0-based column label
+    Q_DECL_CONSTEXPR static inline int columnLabelLength(int col) {
+        return col < 26 ? 1 : (col < 26 + 26*26 ? 2 : 3);
+    }
+
+    // 0-based column of letters "A".."XFD", case insensitive, -1 for empty
+    Q_DECL_CONSTEXPR static inline int columnIndex(const char *letters, int len, int acc = 0) {
+        return len == 0 ? acc - 1 : columnIndex(letters + 1, len - 1, acc*26 + ((letters[0] | 0x20) - 'a' + 1));
+    }
+
+    // zero terminated label of 0-based column from precomputed table, 0 if out of range
+    static const char *columnLabel(int col);
+
+    // formatters write zero terminated text to buf and return its length
+    static int formatCell(const Ref &ref, char *buf);
+    static int formatArea(const Area &area, char *buf);
+    // absolute parts as R1C1, relative parts as offsets to base R[-1]C[2]
+    static int formatR1C1(const Ref &ref, char *buf, const Ref *pbase = 0);
+
+    // parsers of exact text span, false when span is not one reference
+    static bool parseCell(const QChar *s, int len, Ref *pref);
+    static bool parseR1C1(const QChar *s, int len, Ref *pref, const Ref *pbase = 0);
+    static bool parseArea(const QChar *s, int len, Area *parea);
+
+    /* parses "Sheet1!A1:B2,'My Sheet'!C3,D:D". Areas are written to pareas
+       up to max_areas. Returns count of areas in text, -1 on syntax error */
+    static int parseRange(const QChar *s, int len, Area *pareas, int max_areas);
+    static int parseRange(const QString &range, Area *pareas, int max_areas) {
+        return parseRange(range.constData(), range.size(), pareas, max_areas);
+    }
+    static bool isValid(const QString &range) {
+        return parseRange(range, 0, 0) > 0;
+    }
+
+private:
+    static bool parseColumn(const QChar *s, int len, int *pcol);
+    static bool parseRow(const QChar *s, int len, int *prow);
+    static int parseNumber(const QChar *s, int len, int *pvalue);
+    static int writeNumber(int value, char *buf);
+};
+
+#endif // EXCELADDRESS_H
@@ -0,0 +1,222 @@
+/**
+ * @file:exceldecimate.cpp   -
+ * @description: Point decimation of chart series.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#include "exceldecimate.h"
+#include <QtGlobal>
+#include <QByteArray>
+#include <cmath>
+
+
+/****************************************************************************
+ * @function name: ExcelDecimate::decimate()
+ * @param:
+ *      Mode mode - decimation algorithm
+ *      const QVector<double> &x - x values
+ *      const QVector<double> &y - y values, count of points is min of sizes
+ *      int max_points - limit of output points
+ *      QVector<double> *pout_x, *pout_y - output series
+ * @description: series with less than max_points points is copied as is
+ * @return: ( void )
+ ****************************************************************************/
+void ExcelDecimate::decimate(Mode mode, const QVector<double> &x, const QVector<double> &y, int max_points
+                             , QVector<double> *pout_x, QVector<double> *pout_y)
+{
+    switch(mode)
+    {
+    case MinMax:
+        minMax(x, y, max_points, pout_x, pout_y);
+        break;
+    case Lttb:
+        lttb(x, y, max_points, pout_x, pout_y);
+        break;
+    default:
+        copy(x, y, qMin(x.size(), y.size()), pout_x, pout_y);
+        break;
+    }
+}
+
+/****************************************************************************
+ * @function name: ExcelDecimate::literalLength()
+ * @param:
+ *      const QVector<double> &values
+ * @description: excel writes array values with up to 15 significant
+ *               digits, separated by commas and enclosed in braces
+ * @return: ( int ) count of characters
+ ****************************************************************************/
+int ExcelDecimate::literalLength(const QVector<double> &values)
+{
+    int length = 2 + qMax(values.size() - 1, 0);
+    foreach(double v, values)
+        length += QByteArray::number(v, 'g', 15).size();
+    return length;
+}
+
+/****************************************************************************
+ * @function name: ExcelDecimate::decimateToLength()
+ * @param:
+ *      Mode mode - decimation algorithm
+ *      const QVector<double> &x, &y - series
+ *      int max_points - limit of output points
+ *      int max_length - limit of characters of both array literals
+ *      QVector<double> *pout_x, *pout_y - output series
+ * @description: points are reduced in proportion to the overflow until
+ *               literals fit, long values give fewer points
+ * @return: ( void )
+ ****************************************************************************/
+void ExcelDecimate::decimateToLength(Mode mode, const QVector<double> &x, const QVector<double> &y
+                                     , int max_points, int max_length
+                                     , QVector<double> *pout_x, QVector<double> *pout_y)
+{
+    decimate(mode, x, y, max_points, pout_x, pout_y);
+    if(mode == None) return;
+    int length = literalLength(*pout_x) + literalLength(*pout_y);
+    while(length > max_length && pout_x->size() > 3)
+    {
+        const int points = qMax(3, qMin(pout_x->size() - 1, (int)((qint64)pout_x->size()*max_length/length)));
+        decimate(mode, x, y, points, pout_x, pout_y);
+        length = literalLength(*pout_x) + literalLength(*pout_y);
+    }
+}
+
+void ExcelDecimate::copy(const QVector<double> &x, const QVector<double> &y, int count
+                         , QVector<double> *pout_x, QVector<double> *pout_y)
+{
+    *pout_x = x.mid(0, count);
+    *pout_y = y.mid(0, count);
+}
+
+/****************************************************************************
+ * @function name: ExcelDecimate::minMax()
+ * @description: points are split to max_points/2 buckets of equal count,
+ *               min and max of every bucket are kept in original order.
+ *               Single pass over raw arrays, no per point allocation.
+ * @return: ( void )
+ ****************************************************************************/
+void ExcelDecimate::minMax(const QVector<double> &x, const QVector<double> &y, int max_points
+                           , QVector<double> *pout_x, QVector<double> *pout_y)
+{
+    const int count = qMin(x.size(), y.size());
+    if(count <= max_points || max_points < 2)
+    {
+        copy(x, y, count, pout_x, pout_y);
+        return;
+    }
+
+    const int buckets = max_points/2;
+    const double *px = x.constData();
+    const double *py = y.constData();
+
+    pout_x->resize(2*buckets);
+    pout_y->resize(2*buckets);
+    double *ox = pout_x->data();
+    double *oy = pout_y->data();
+    int out = 0;
+
+    for(int b=0; b<buckets; b++)
+    {
+        const int first = (int)((qint64)b*count/buckets);
+        const int last = (int)((qint64)(b+1)*count/buckets);
+
+        int imin = first, imax = first;
+        double vmin = py[first], vmax = py[first];
+        for(int i=first+1; i<last; i++)
+        {
+            const double v = py[i];
+            if(v < vmin) {vmin = v; imin = i;}
+            if(v > vmax) {vmax = v; imax = i;}
+        }
+
+        const int i1 = qMin(imin, imax);
+        const int i2 = qMax(imin, imax);
+        ox[out] = px[i1]; oy[out] = py[i1]; out++;
+        if(i2 != i1){
+            ox[out] = px[i2]; oy[out] = py[i2]; out++;
+        }
+    }
+    pout_x->resize(out);
+    pout_y->resize(out);
+}
+
+/****************************************************************************
+ * @function name: ExcelDecimate::lttb()
+ * @description: Largest-Triangle-Three-Buckets. First and last points are
+ *               kept, from every bucket between them the point forming the
+ *               largest triangle with previous kept point and average of
+ *               next bucket is kept.
+ * @return: ( void )
+ ****************************************************************************/
+void ExcelDecimate::lttb(const QVector<double> &x, const QVector<double> &y, int max_points
+                         , QVector<double> *pout_x, QVector<double> *pout_y)
+{
+    const int count = qMin(x.size(), y.size());
+    if(count <= max_points || max_points < 3)
+    {
+        copy(x, y, count, pout_x, pout_y);
+        return;
+    }
+
+    const double *px = x.constData();
+    const double *py = y.constData();
+
+    pout_x->resize(max_points);
+    pout_y->resize(max_points);
+    double *ox = pout_x->data();
+    double *oy = pout_y->data();
+
+    const double every = (double)(count - 2)/(max_points - 2);
+    int a = 0;
+    ox[0] = px[0]; oy[0] = py[0];
+
+    for(int i=0; i<max_points-2; i++)
+    {
+        // average of next bucket
+        const int avg_first = (int)std::floor((i+1)*every) + 1;
+        const int avg_last = qMin((int)std::floor((i+2)*every) + 1, count);
+        double avg_x = 0, avg_y = 0;
+        for(int j=avg_first; j<avg_last; j++)
+        {
+            avg_x += px[j];
+            avg_y += py[j];
+        }
+        const int avg_count = avg_last - avg_first;
+        if(avg_count > 0){
+            avg_x /= avg_count;
+            avg_y /= avg_count;
+        }
+        else {
+            avg_x = px[count-1];
+            avg_y = py[count-1];
+        }
+
+        // current bucket
+        const int first = (int)std::floor(i*every) + 1;
+        const int last = (int)std::floor((i+1)*every) + 1;
+        const double ax = px[a], ay = py[a];
+        const double dx = ax - avg_x;
+        const double dy = avg_y - ay;
+
+        double max_area = -1;
+        int next = first;
+        for(int j=first; j<last; j++)
+        {
+            // doubled triangle area, constant factor does not change the choice
+            const double area = std::fabs(dx*(py[j] - ay) - (ax - px[j])*dy);
+            if(area > max_area){
+                max_area = area;
+                next = j;
+            }
+        }
+
+        ox[i+1] = px[next];
+        oy[i+1] = py[next];
+        a = next;
+    }
+
+    ox[max_points-1] = px[count-1];
+    oy[max_points-1] = py[count-1];
+}
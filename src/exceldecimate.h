@@ -0,0 +1,54 @@
+/**
+ * @file:exceldecimate.h   -
+ * @description: Point decimation of chart series. Pure computation,
+ *               no ActiveX calls, so it can be used and measured alone.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#ifndef EXCELDECIMATE_H
+#define EXCELDECIMATE_H
+
+#include <QVector>
+
+class ExcelDecimate
+{
+public:
+    enum Mode{
+        None,   // all points are kept
+        MinMax, // min and max of every bucket, keeps peaks and noise band
+        Lttb    // largest triangle three buckets, keeps visual shape
+    };
+    enum {
+        // x and y array literals of one SERIES formula, excel refuses
+        // formulas of about 8K characters
+        MaxSeriesLiteral = 7680
+    };
+
+    // reduce series (x,y) to at most max_points points, x is expected sorted
+    // for Lttb. Result is written to pout_x, pout_y.
+    static void decimate(Mode mode, const QVector<double> &x, const QVector<double> &y, int max_points
+                         , QVector<double> *pout_x, QVector<double> *pout_y);
+
+    static void minMax(const QVector<double> &x, const QVector<double> &y, int max_points
+                       , QVector<double> *pout_x, QVector<double> *pout_y);
+
+    static void lttb(const QVector<double> &x, const QVector<double> &y, int max_points
+                     , QVector<double> *pout_x, QVector<double> *pout_y);
+
+    // characters of array literal "{1,2.5,...}" of values, 15 significant digits
+    static int literalLength(const QVector<double> &values);
+
+    // decimate() to at most max_points points whose x and y literals take
+    // max_length characters together. None keeps all points.
+    static void decimateToLength(Mode mode, const QVector<double> &x, const QVector<double> &y
+                                 , int max_points, int max_length
+                                 , QVector<double> *pout_x, QVector<double> *pout_y);
+
+private:
+    static void copy(const QVector<double> &x, const QVector<double> &y, int count
+                     , QVector<double> *pout_x, QVector<double> *pout_y);
+};
+
+#endif // EXCELDECIMATE_H
@@ -180,6 +180,52 @@ enum XlBorderWeight{
     ,xlThick =4
 };
 
+enum XlBordersIndex{
+    xlDiagonalDown	=	5	//Border running from the upper-left corner to the lower-right of each cell in the range.
+    ,xlDiagonalUp	=	6	//Border running from the lower-left corner to the upper-right of each cell in the range.
+    ,xlEdgeLeft	=	7	//Border at the left edge of the range.
+    ,xlEdgeTop	=	8	//Border at the top of the range.
+    ,xlEdgeBottom	=	9	//Border at the bottom of the range.
+    ,xlEdgeRight	=	10	//Border at the right edge of the range.
+    ,xlInsideVertical	=	11	//Vertical borders for all the cells in the range except borders on the outside of the range.
+    ,xlInsideHorizontal	=	12	//Horizontal borders for all cells in the range except borders on the outside of the range.
+};
+
+enum XlLineStyle{
+    xlContinuous	=	1	//Continuous line.
+    ,xlDash	=	-4115	//Dashed line.
+    ,xlDashDot	=	4	//Alternating dashes and dots.
+    ,xlDashDotDot	=	5	//Dash followed by two dots.
+    ,xlDot	=	-4118	//Dotted line.
+    ,xlDouble	=	-4119	//Double line.
+    ,xlSlantDashDot	=	13	//Slanted dashes.
+    ,xlLineStyleNone	=	-4142	//No line.
+};
+
+enum XlFormatConditionType{
+    xlCellValue	=	1	//Cell value.
+    ,xlExpression	=	2	//Expression.
+    ,xlColorScale	=	3	//Color scale.
+    ,xlDatabar	=	4	//Databar.
+};
+
+enum XlFormatConditionOperator{
+    xlBetween	=	1	//Between. Can be used only if two formulas are provided.
+    ,xlNotBetween	=	2	//Not between. Can be used only if two formulas are provided.
+    ,xlEqual	=	3	//Equal.
+    ,xlNotEqual	=	4	//Not equal.
+    ,xlGreater	=	5	//Greater than.
+    ,xlLess	=	6	//Less than.
+    ,xlGreaterEqual	=	7	//Greater than or equal to.
+    ,xlLessEqual	=	8	//Less than or equal to.
+};
+
+enum XlRangeValueDataType{
+    xlRangeValueDefault	=	10	//Default.
+    ,xlRangeValueXMLSpreadsheet	=	11	//Returns the values, formatting, formulas, and names of the specified Range object in the XML Spreadsheet format.
+    ,xlRangeValueMSPersistXML	=	12	//Returns the recordset representation of the specified Range object in an XML format.
+};
+
 enum XlChartType{
     xl3DArea	=	-4098	,
     xl3DAreaStacked	=	78	,
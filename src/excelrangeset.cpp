@@ -0,0 +1,417 @@
+/**
+ * @file:excelrangeset.cpp   -
+ * @description: Set of sheet cells kept as canonical rectangle bands.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#include "excelrangeset.h"
+#include "exceladdress.h"
+#include <QHash>
+#include <QVarLengthArray>
+#include <algorithm>
+
+
+static bool cellRowMajorLess(const Excel::Cell &a, const Excel::Cell &b)
+{
+    return a.y() < b.y() || (a.y() == b.y() && a.x() < b.x());
+}
+
+ExcelRangeSet::ExcelRangeSet(const Excel::Rect &rect)
+{
+    if(rect.width() > 0 && rect.height() > 0)
+    {
+        QVector<int> xs;
+        xs << rect.x() << rect.x() + rect.width();
+        appendBand(rect.y(), rect.y() + rect.height(), xs);
+    }
+}
+
+/****************************************************************************
+ * @function name: ExcelRangeSet::fromCells()
+ * @param:
+ *      QList<Excel::Cell> cells - cells in any order, duplicates allowed
+ * @description: cells are sorted once and row runs are built directly in
+ *               canonical form, no set operation per cell
+ * @return: ( ExcelRangeSet )
+ ****************************************************************************/
+ExcelRangeSet ExcelRangeSet::fromCells(QList<Excel::Cell> cells)
+{
+    ExcelRangeSet set;
+    std::sort(cells.begin(), cells.end(), cellRowMajorLess);
+
+    QVector<int> xs;
+    int i = 0;
+    while(i < cells.count())
+    {
+        const int y = cells[i].y();
+        xs.clear();
+        while(i < cells.count() && cells[i].y() == y)
+        {
+            const int x0 = cells[i].x();
+            int x1 = x0 + 1;
+            ++i;
+            // duplicates are skipped, adjacent cells extend the run
+            while(i < cells.count() && cells[i].y() == y && cells[i].x() <= x1)
+            {
+                if(cells[i].x() == x1) x1++;
+                ++i;
+            }
+            xs << x0 << x1;
+        }
+        set.appendBand(y, y + 1, xs);
+    }
+    return set;
+}
+
+ExcelRangeSet ExcelRangeSet::fromRange(const QString &range)
+{
+    ExcelRangeSet set;
+    const int count = ExcelAddress::parseRange(range, 0, 0);
+    if(count <= 0) return set;
+
+    QVarLengthArray<ExcelAddress::Area, 16> areas(count);
+    ExcelAddress::parseRange(range, areas.data(), count);
+    for(int i=0; i<count; i++)
+    {
+        const ExcelAddress::Area &area = areas[i];
+        set |= ExcelRangeSet(Excel::Rect(area.first.col, area.first.row
+                                         , area.last.col - area.first.col + 1
+                                         , area.last.row - area.first.row + 1));
+    }
+    return set;
+}
+
+// band is joined with previous one when adjacent and equal
+void ExcelRangeSet::appendBand(int y0, int y1, const QVector<int> &xs)
+{
+    if(xs.isEmpty() || y1 <= y0) return;
+    if(!m_bands.isEmpty() && m_bands.last().y1 == y0 && m_bands.last().xs == xs)
+    {
+        m_bands.last().y1 = y1;
+        return;
+    }
+    Band band;
+    band.y0 = y0;
+    band.y1 = y1;
+    band.xs = xs;
+    m_bands.append(band);
+}
+
+qint64 ExcelRangeSet::cellCount() const
+{
+    qint64 count = 0;
+    foreach(const Band &band, m_bands)
+    {
+        qint64 width = 0;
+        for(int i=0; i<band.xs.size(); i+=2)
+            width += band.xs[i+1] - band.xs[i];
+        count += width*(band.y1 - band.y0);
+    }
+    return count;
+}
+
+bool ExcelRangeSet::contains(int x, int y) const
+{
+    foreach(const Band &band, m_bands)
+    {
+        if(y < band.y0) return false;
+        if(y >= band.y1) continue;
+        for(int i=0; i<band.xs.size(); i+=2)
+            if(x >= band.xs[i] && x < band.xs[i+1]) return true;
+        return false;
+    }
+    return false;
+}
+
+Excel::Rect ExcelRangeSet::boundingRect() const
+{
+    if(m_bands.isEmpty()) return Excel::Rect();
+    int x0 = m_bands.first().xs.first();
+    int x1 = m_bands.first().xs.last();
+    foreach(const Band &band, m_bands)
+    {
+        x0 = qMin(x0, band.xs.first());
+        x1 = qMax(x1, band.xs.last());
+    }
+    return Excel::Rect(x0, m_bands.first().y0, x1 - x0, m_bands.last().y1 - m_bands.first().y0);
+}
+
+ExcelRangeSet ExcelRangeSet::united(const ExcelRangeSet &other) const
+{
+    if(other.isEmpty()) return *this;
+    if(isEmpty()) return other;
+    return combine(*this, other, Unite);
+}
+
+ExcelRangeSet ExcelRangeSet::subtracted(const ExcelRangeSet &other) const
+{
+    if(isEmpty() || other.isEmpty()) return *this;
+    return combine(*this, other, Subtract);
+}
+
+ExcelRangeSet ExcelRangeSet::intersected(const ExcelRangeSet &other) const
+{
+    if(isEmpty() || other.isEmpty()) return ExcelRangeSet();
+    return combine(*this, other, Intersect);
+}
+
+bool ExcelRangeSet::operator==(const ExcelRangeSet &other) const
+{
+    return m_bands == other.m_bands;
+}
+
+/****************************************************************************
+ * @function name: ExcelRangeSet::combine()
+ * @description: rows are cut at every band edge of both sets, intervals of
+ *               each slab are combined and equal adjacent slabs joined
+ * @return: ( ExcelRangeSet ) canonical result
+ ****************************************************************************/
+ExcelRangeSet ExcelRangeSet::combine(const ExcelRangeSet &a, const ExcelRangeSet &b, Operation op)
+{
+    QVector<int> ys;
+    ys.reserve(2*(a.m_bands.size() + b.m_bands.size()));
+    foreach(const Band &band, a.m_bands) ys << band.y0 << band.y1;
+    foreach(const Band &band, b.m_bands) ys << band.y0 << band.y1;
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+    ExcelRangeSet result;
+    const QVector<int> none;
+    QVector<int> xs;
+    int ia = 0, ib = 0;
+    for(int k=0; k+1<ys.size(); k++)
+    {
+        const int y = ys[k];
+        while(ia < a.m_bands.size() && a.m_bands[ia].y1 <= y) ia++;
+        while(ib < b.m_bands.size() && b.m_bands[ib].y1 <= y) ib++;
+
+        const QVector<int> &xa = (ia < a.m_bands.size() && a.m_bands[ia].y0 <= y) ? a.m_bands[ia].xs : none;
+        const QVector<int> &xb = (ib < b.m_bands.size() && b.m_bands[ib].y0 <= y) ? b.m_bands[ib].xs : none;
+
+        combineIntervals(xa, xb, op, &xs);
+        result.appendBand(y, ys[k+1], xs);
+    }
+    return result;
+}
+
+// sweep over interval edges of both lists, edge is kept where result changes
+void ExcelRangeSet::combineIntervals(const QVector<int> &a, const QVector<int> &b, Operation op, QVector<int> *pout)
+{
+    pout->clear();
+    bool in_a = false, in_b = false, in = false;
+    int ia = 0, ib = 0;
+    while(ia < a.size() || ib < b.size())
+    {
+        int x;
+        if(ib >= b.size() || (ia < a.size() && a[ia] <= b[ib])) x = a[ia];
+        else x = b[ib];
+
+        if(ia < a.size() && a[ia] == x) {in_a = !in_a; ia++;}
+        if(ib < b.size() && b[ib] == x) {in_b = !in_b; ib++;}
+
+        bool now;
+        switch(op)
+        {
+        case Unite: now = in_a || in_b; break;
+        case Subtract: now = in_a && !in_b; break;
+        default: now = in_a && in_b; break;
+        }
+        if(now != in)
+        {
+            pout->append(x);
+            in = now;
+        }
+    }
+}
+
+QList<Excel::Rect> ExcelRangeSet::rects() const
+{
+    QList<Excel::Rect> rects;
+    // intervals of previous band, (x0<<32|x1) -> index in rects
+    QHash<quint64, int> open;
+    QHash<quint64, int> next;
+    int last_y1 = -1;
+    foreach(const Band &band, m_bands)
+    {
+        next.clear();
+        for(int i=0; i<band.xs.size(); i+=2)
+        {
+            const int x0 = band.xs[i];
+            const int x1 = band.xs[i+1];
+            const quint64 key = (quint64(x0) << 32) | quint32(x1);
+            int index = (last_y1 == band.y0) ? open.value(key, -1) : -1;
+            if(index >= 0){
+                rects[index].setHeight(band.y1 - rects[index].y());
+            }
+            else{
+                index = rects.count();
+                rects.append(Excel::Rect(x0, band.y0, x1 - x0, band.y1 - band.y0));
+            }
+            next.insert(key, index);
+        }
+        open = next;
+        last_y1 = band.y1;
+    }
+    return rects;
+}
+
+QStringList ExcelRangeSet::toRanges(int max_length) const
+{
+    return Excel::Rects_To_Ranges(rects(), max_length);
+}
+
+
+ExcelRectMerger::ExcelRectMerger(int reach)
+{
+    m_reach = qBound(1, reach, 1024);
+    // buckets are not made smaller than a tile, big boxes touch few of them
+    m_bucket = qMax(16, m_reach);
+    m_stamp = 0;
+}
+
+void ExcelRectMerger::insert(int id)
+{
+    const Excel::Rect &rect = m_rects[id];
+    for(int by=rect.y()/m_bucket; by<=(rect.y() + rect.height() - 1)/m_bucket; by++)
+        for(int bx=rect.x()/m_bucket; bx<=(rect.x() + rect.width() - 1)/m_bucket; bx++)
+            m_grid[(quint64(by) << 32) | quint32(bx)].append(id);
+}
+
+void ExcelRectMerger::remove(int id)
+{
+    m_alive[id] = false;
+    const Excel::Rect &rect = m_rects[id];
+    for(int by=rect.y()/m_bucket; by<=(rect.y() + rect.height() - 1)/m_bucket; by++)
+        for(int bx=rect.x()/m_bucket; bx<=(rect.x() + rect.width() - 1)/m_bucket; bx++)
+        {
+            QHash<quint64, QVector<int> >::iterator it = m_grid.find((quint64(by) << 32) | quint32(bx));
+            if(it == m_grid.end()) continue;
+            const int i = it->indexOf(id);
+            if(i >= 0) it->remove(i);
+        }
+}
+
+QVector<int> ExcelRectMerger::query(const Excel::Rect &area) const
+{
+    QVector<int> result;
+    if(++m_stamp == 0)
+    {
+        m_seen.fill(0);
+        m_stamp = 1;
+    }
+    for(int by=area.y()/m_bucket; by<=(area.y() + area.height() - 1)/m_bucket; by++)
+    {
+        for(int bx=area.x()/m_bucket; bx<=(area.x() + area.width() - 1)/m_bucket; bx++)
+        {
+            QHash<quint64, QVector<int> >::const_iterator it = m_grid.constFind((quint64(by) << 32) | quint32(bx));
+            if(it == m_grid.constEnd()) continue;
+            foreach(int id, it.value())
+            {
+                if(m_seen[id] == m_stamp) continue;
+                m_seen[id] = m_stamp;
+                if(m_alive[id] && area.intersects(m_rects[id])) result.append(id);
+            }
+        }
+    }
+    return result;
+}
+
+qint64 ExcelRectMerger::evaluate(const Excel::Rect &box) const
+{
+    qint64 inside = 0;
+    int count = 0;
+    bool cuts = false;
+    foreach(int id, query(box))
+    {
+        if(box.contains(m_rects[id]))
+        {
+            inside += m_rects[id].area();
+            count++;
+        }
+        else cuts = true;
+    }
+    return gain(box, inside, count, cuts);
+}
+
+void ExcelRectMerger::pushPairs(int id, bool later_only, QVector<Candidate> *pheap) const
+{
+    const Excel::Rect &rect = m_rects[id];
+    const int x0 = qMax(0, rect.x() - m_reach);
+    const int y0 = qMax(0, rect.y() - m_reach);
+    const Excel::Rect around(x0, y0, rect.x() + rect.width() + m_reach - x0
+                             , rect.y() + rect.height() + m_reach - y0);
+    foreach(int other, query(around))
+    {
+        if(other == id || (later_only && other < id)) continue;
+        const qint64 value = evaluate(rect.united(m_rects[other]));
+        if(value <= 0) continue;
+        const Candidate candidate = {value, id, other};
+        pheap->append(candidate);
+        std::push_heap(pheap->begin(), pheap->end());
+    }
+}
+
+/****************************************************************************
+ * @function name: ExcelRectMerger::merge()
+ * @param:
+ *      const QList<Excel::Rect> &rects - disjoint rectangles
+ * @description: pair of best gain is merged, rectangles inside its box are
+ *               absorbed and pairs of the box with its neighbours join the
+ *               heap. Stale pair whose gain dropped below next one is put
+ *               back with its current gain.
+ * @return: ( QList<Excel::Rect> ) rectangles after merges
+ ****************************************************************************/
+QList<Excel::Rect> ExcelRectMerger::merge(const QList<Excel::Rect> &rects)
+{
+    m_rects.clear();
+    m_alive.clear();
+    m_grid.clear();
+    foreach(const Excel::Rect &rect, rects)
+    {
+        if(rect.width() <= 0 || rect.height() <= 0) continue;
+        m_rects.append(rect);
+        m_alive.append(true);
+        insert(m_rects.count() - 1);
+    }
+    m_seen = QVector<int>(m_rects.count(), 0);
+    m_stamp = 0;
+
+    QVector<Candidate> heap;
+    for(int id=0; id<m_rects.count(); id++)
+        pushPairs(id, true, &heap);
+
+    while(!heap.isEmpty())
+    {
+        std::pop_heap(heap.begin(), heap.end());
+        Candidate top = heap.last();
+        heap.removeLast();
+        if(!m_alive[top.a] || !m_alive[top.b]) continue;
+
+        const Excel::Rect box = m_rects[top.a].united(m_rects[top.b]);
+        const qint64 value = evaluate(box);
+        if(value <= 0) continue;
+        if(value < top.gain && !heap.isEmpty() && value < heap.first().gain)
+        {
+            top.gain = value;
+            heap.append(top);
+            std::push_heap(heap.begin(), heap.end());
+            continue;
+        }
+
+        foreach(int id, query(box))
+            if(box.contains(m_rects[id])) remove(id);
+
+        m_rects.append(box);
+        m_alive.append(true);
+        m_seen.append(0);
+        insert(m_rects.count() - 1);
+        pushPairs(m_rects.count() - 1, false, &heap);
+    }
+
+    QList<Excel::Rect> result;
+    for(int id=0; id<m_rects.count(); id++)
+        if(m_alive[id]) result.append(m_rects[id]);
+    return result;
+}
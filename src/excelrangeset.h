@@ -0,0 +1,121 @@
+/**
+ * @file:excelrangeset.h   -
+ * @description: Set of sheet cells kept as canonical rectangle bands,
+ *               with union, subtraction and intersection.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#ifndef EXCELRANGESET_H
+#define EXCELRANGESET_H
+
+#include "excel.h"
+#include <QVector>
+#include <QList>
+#include <QStringList>
+
+/* Cells are stored as bands of rows [y0,y1) having the same sorted disjoint
+   column intervals [x0,x1). Adjacent bands always differ, so equal sets have
+   equal representation and operations are linear in count of bands. */
+class ExcelRangeSet
+{
+public:
+    ExcelRangeSet() {}
+    ExcelRangeSet(const Excel::Rect &rect);
+
+    static ExcelRangeSet fromCells(QList<Excel::Cell> cells);
+    // "A1:B4,D1:D9", sheet names are ignored, empty set on syntax error
+    static ExcelRangeSet fromRange(const QString &range);
+
+    bool isEmpty() const {return m_bands.isEmpty();}
+    void clear() {m_bands.clear();}
+    qint64 cellCount() const;
+    bool contains(int x, int y) const;
+    Excel::Rect boundingRect() const;
+
+    ExcelRangeSet united(const ExcelRangeSet &other) const;
+    ExcelRangeSet subtracted(const ExcelRangeSet &other) const;
+    ExcelRangeSet intersected(const ExcelRangeSet &other) const;
+
+    void addRect(const Excel::Rect &rect) {*this = united(ExcelRangeSet(rect));}
+    void addCell(const Excel::Cell &cell) {addRect(Excel::Rect(cell.x(), cell.y(), 1, 1));}
+
+    ExcelRangeSet operator|(const ExcelRangeSet &other) const {return united(other);}
+    ExcelRangeSet operator-(const ExcelRangeSet &other) const {return subtracted(other);}
+    ExcelRangeSet operator&(const ExcelRangeSet &other) const {return intersected(other);}
+    ExcelRangeSet &operator|=(const ExcelRangeSet &other) {return *this = united(other);}
+    ExcelRangeSet &operator-=(const ExcelRangeSet &other) {return *this = subtracted(other);}
+    ExcelRangeSet &operator&=(const ExcelRangeSet &other) {return *this = intersected(other);}
+    bool operator==(const ExcelRangeSet &other) const;
+    bool operator!=(const ExcelRangeSet &other) const {return !(*this == other);}
+
+    // rectangles covering set, equal intervals of adjacent bands are joined
+    QList<Excel::Rect> rects() const;
+    // multi-area ranges not longer than max_length
+    QStringList toRanges(int max_length = 255) const;
+
+private:
+    enum Operation {Unite, Subtract, Intersect};
+
+    struct Band{
+        int y0;
+        int y1;
+        QVector<int> xs; // x0,x1,x0,x1,... sorted
+        bool operator==(const Band &other) const {
+            return y0 == other.y0 && y1 == other.y1 && xs == other.xs;
+        }
+    };
+
+    static ExcelRangeSet combine(const ExcelRangeSet &a, const ExcelRangeSet &b, Operation op);
+    static void combineIntervals(const QVector<int> &a, const QVector<int> &b, Operation op, QVector<int> *pout);
+    void appendBand(int y0, int y1, const QVector<int> &xs);
+
+    QVector<Band> m_bands;
+};
+
+
+/* Greedy merge of disjoint rectangles into bounding boxes. Pairs of near
+   rectangles wait in a heap ordered by gain, rectangles are indexed in a
+   grid of buckets, so evaluation of a box looks only at rectangles around
+   it. Gain is evaluated again when pair is taken from heap, since merges
+   around may have changed it. Subclass decides gain of a box. */
+class ExcelRectMerger
+{
+public:
+    // pairs closer than reach cells are candidates
+    explicit ExcelRectMerger(int reach);
+    virtual ~ExcelRectMerger() {}
+
+    QList<Excel::Rect> merge(const QList<Excel::Rect> &rects);
+
+protected:
+    /* box would replace count rectangles inside it having inside cells,
+       cuts - box partly overlaps other rectangle. No merge when <= 0 */
+    virtual qint64 gain(const Excel::Rect &box, qint64 inside, int count, bool cuts) const = 0;
+
+private:
+    struct Candidate{
+        qint64 gain;
+        int a;
+        int b;
+        bool operator<(const Candidate &other) const {return gain < other.gain;}
+    };
+
+    void insert(int id);
+    void remove(int id);
+    // live rectangles intersecting area
+    QVector<int> query(const Excel::Rect &area) const;
+    qint64 evaluate(const Excel::Rect &box) const;
+    void pushPairs(int id, bool later_only, QVector<Candidate> *pheap) const;
+
+    int m_reach;
+    int m_bucket;       // grid cell size
+    QVector<Excel::Rect> m_rects;
+    QVector<bool> m_alive;
+    QHash<quint64, QVector<int> > m_grid;   // (bucket row << 32 | bucket col) -> ids
+    mutable QVector<int> m_seen;            // query stamp per id
+    mutable int m_stamp;
+};
+
+#endif // EXCELRANGESET_H
@@ -0,0 +1,292 @@
+/**
+ * @file:excelsheetmodel.cpp   -
+ * @description: In-memory sparse model of sheet values.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#include "excelsheetmodel.h"
+#include "excelrangeset.h"
+#include <QElapsedTimer>
+
+
+ExcelSheetModel::ExcelSheetModel(Excel *pexcel, const QString &sheetname)
+{
+    mp_excel = pexcel;
+    m_sheetName = sheetname;
+    m_flushing = false;
+    if(mp_excel)
+    {
+        if(m_sheetName.isEmpty()) m_sheetName = mp_excel->currentSheetName();
+        mp_excel->m_models.append(this);
+    }
+    m_dirtyCount = 0;
+    m_callCost = 64;
+    m_flushTime = 0;
+    m_rectsEmitted = 0;
+    m_cellsWritten = 0;
+    m_cellsRewritten = 0;
+}
+
+ExcelSheetModel::~ExcelSheetModel()
+{
+    if(mp_excel) mp_excel->m_models.removeAll(this);
+}
+
+void ExcelSheetModel::sheetChanged()
+{
+    if(m_flushing) return;
+    QHash<quint64, Tile>::iterator it = m_tiles.begin();
+    while(it != m_tiles.end())
+    {
+        Tile &t = it.value();
+        bool empty = true;
+        for(int ty=0; ty<TileSize; ty++)
+        {
+            quint32 stale = t.known[ty] & ~t.dirty[ty];
+            t.known[ty] = t.dirty[ty];
+            for(int tx=0; stale; tx++, stale >>= 1)
+                if(stale & 1) t.values[ty*TileSize + tx] = QVariant();
+            if(t.dirty[ty]) empty = false;
+        }
+        if(empty) it = m_tiles.erase(it);
+        else ++it;
+    }
+}
+
+const ExcelSheetModel::Tile *ExcelSheetModel::tile(int x, int y) const
+{
+    QHash<quint64, Tile>::const_iterator it = m_tiles.constFind(tileKey(x, y));
+    return it == m_tiles.constEnd() ? 0 : &it.value();
+}
+
+ExcelSheetModel::Tile *ExcelSheetModel::tile(int x, int y)
+{
+    return &m_tiles[tileKey(x, y)];
+}
+
+void ExcelSheetModel::store(int x, int y, const QVariant &data, bool dirty)
+{
+    Tile *ptile = tile(x, y);
+    const int tx = x % TileSize;
+    const int ty = y % TileSize;
+    const quint32 bit = 1u << tx;
+
+    ptile->values[ty*TileSize + tx] = data;
+    ptile->known[ty] |= bit;
+    if(dirty && !(ptile->dirty[ty] & bit))
+    {
+        ptile->dirty[ty] |= bit;
+        m_dirtyCount++;
+    }
+}
+
+void ExcelSheetModel::setValue(qint32 row, qint32 col, const QVariant &data)
+{
+    if(row <= 0 || col <= 0) return;
+    store(col - 1, row - 1, data, true);
+}
+
+QVariant ExcelSheetModel::value(qint32 row, qint32 col) const
+{
+    if(row <= 0 || col <= 0) return QVariant();
+    const Tile *ptile = tile(col - 1, row - 1);
+    if(ptile == 0) return QVariant();
+    return ptile->values[((row - 1) % TileSize)*TileSize + (col - 1) % TileSize];
+}
+
+bool ExcelSheetModel::isKnown(qint32 row, qint32 col) const
+{
+    if(row <= 0 || col <= 0) return false;
+    const Tile *ptile = tile(col - 1, row - 1);
+    return ptile && (ptile->known[(row - 1) % TileSize] & (1u << ((col - 1) % TileSize)));
+}
+
+bool ExcelSheetModel::isDirty(qint32 row, qint32 col) const
+{
+    if(row <= 0 || col <= 0) return false;
+    const Tile *ptile = tile(col - 1, row - 1);
+    return ptile && (ptile->dirty[(row - 1) % TileSize] & (1u << ((col - 1) % TileSize)));
+}
+
+/****************************************************************************
+ * @function name: ExcelSheetModel::load()
+ * @param:
+ *      const Excel::Rect &rect - area of model's sheet
+ * @description: values and formulas are read by one call each, values of
+ *               constant cells are stored as known clean cells. Formula
+ *               cells stay unknown, cells changed locally keep their values
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool ExcelSheetModel::load(const Excel::Rect &rect)
+{
+    if(mp_excel == 0 || mp_excel->object() == 0 || rect.width() <= 0 || rect.height() <= 0) return false;
+    const AxObject::Class sheet = mp_excel->sheetHandle(m_sheetName);
+    if(sheet == 0) return false;
+
+    QVariant values, formulas;
+    const QString range = rect.toRange();
+    mp_excel->object()->clearBag();
+    if(!mp_excel->object()->property(sheet, QString("Range(\"%1\").Value").arg(range), &values)
+            || !mp_excel->object()->property(sheet, QString("Range(\"%1\").Formula").arg(range), &formulas))
+        return false;
+    // one cell is scalar, area is list of rows
+    QVariantList rows = values.toList();
+    QVariantList formulaRows = formulas.toList();
+    if(rect.width() == 1 && rect.height() == 1)
+    {
+        rows = QVariantList() << QVariant(QVariantList() << values);
+        formulaRows = QVariantList() << QVariant(QVariantList() << formulas);
+    }
+
+    for(int y=0; y<rect.height() && y<rows.count() && y<formulaRows.count(); y++)
+    {
+        const QVariantList cols = rows[y].toList();
+        const QVariantList texts = formulaRows[y].toList();
+        for(int x=0; x<rect.width() && x<cols.count() && x<texts.count(); x++)
+        {
+            if(texts[x].toString().startsWith(QLatin1Char('='))) continue;
+            if(!isDirty(rect.y() + y + 1, rect.x() + x + 1))
+                store(rect.x() + x, rect.y() + y, cols[x], false);
+        }
+    }
+    return true;
+}
+
+void ExcelSheetModel::clear()
+{
+    m_tiles.clear();
+    m_dirtyCount = 0;
+}
+
+// every cell of rect has value in model
+bool ExcelSheetModel::rectKnown(const Excel::Rect &rect) const
+{
+    for(int y=rect.y(); y<rect.y()+rect.height(); y++)
+    {
+        int x = rect.x();
+        while(x < rect.x() + rect.width())
+        {
+            const int tx = x % TileSize;
+            const int count = qMin(TileSize - tx, rect.x() + rect.width() - x);
+            const quint32 mask = (count == 32 ? 0xFFFFFFFFu : ((1u << count) - 1)) << tx;
+            const Tile *ptile = tile(x, y);
+            if(ptile == 0 || (ptile->known[y % TileSize] & mask) != mask) return false;
+            x += count;
+        }
+    }
+    return true;
+}
+
+// box adding least clean cells wins, added cells must be known and not
+// more than call cost, box must not cut other rectangle
+class ExcelSheetModel::Cover : public ExcelRectMerger
+{
+public:
+    explicit Cover(const ExcelSheetModel *pmodel)
+        : ExcelRectMerger(pmodel->m_callCost), mp_model(pmodel) {}
+
+protected:
+    qint64 gain(const Excel::Rect &box, qint64 inside, int count, bool cuts) const
+    {
+        if(cuts || count < 2) return 0;
+        const qint64 extra = box.area() - inside;
+        if(extra > mp_model->m_callCost) return 0;
+        if(extra > 0 && !mp_model->rectKnown(box)) return 0;
+        return mp_model->m_callCost + 1 - extra;
+    }
+
+private:
+    const ExcelSheetModel *mp_model;
+};
+
+/****************************************************************************
+ * @function name: ExcelSheetModel::cover()
+ * @param:
+ *      QList<Excel::Rect> rects - disjoint exact cover of dirty cells
+ * @description: greedy merge of rectangles closer than call cost, box of
+ *               least added clean cells first. Rectangles inside the box
+ *               are absorbed, result stays disjoint.
+ * @return: ( QList<Excel::Rect> ) disjoint rectangles
+ ****************************************************************************/
+QList<Excel::Rect> ExcelSheetModel::cover(QList<Excel::Rect> rects)
+{
+    if(m_callCost <= 0 || rects.count() < 2) return rects;
+    Cover merger(this);
+    return merger.merge(rects);
+}
+
+/****************************************************************************
+ * @function name: ExcelSheetModel::flush()
+ * @description: dirty cells are covered by rectangles, each rectangle is
+ *               one block write of model values to model's sheet
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool ExcelSheetModel::flush()
+{
+    QElapsedTimer timer;
+    timer.start();
+    m_rectsEmitted = 0;
+    m_cellsWritten = 0;
+    m_cellsRewritten = 0;
+    if(mp_excel == 0) return false;
+    if(m_dirtyCount == 0) {m_flushTime = 0; return true;}
+
+    QList<Excel::Cell> cells;
+    cells.reserve(m_dirtyCount);
+    for(QHash<quint64, Tile>::const_iterator it = m_tiles.constBegin(); it != m_tiles.constEnd(); ++it)
+    {
+        const int x0 = int(it.key() & 0xFFFFFFFF)*TileSize;
+        const int y0 = int(it.key() >> 32)*TileSize;
+        for(int ty=0; ty<TileSize; ty++)
+        {
+            quint32 mask = it.value().dirty[ty];
+            for(int tx=0; mask; tx++, mask >>= 1)
+                if(mask & 1) cells.append(Excel::Cell(x0 + tx, y0 + ty));
+        }
+    }
+
+    const QList<Excel::Rect> rects = cover(ExcelRangeSet::fromCells(cells).rects());
+
+    bool result = true;
+    foreach(const Excel::Rect &rect, rects)
+    {
+        QVariantList block;
+        block.reserve(rect.width()*rect.height());
+        for(int y=rect.y(); y<rect.y()+rect.height(); y++)
+            for(int x=rect.x(); x<rect.x()+rect.width(); x++)
+                block.append(value(y + 1, x + 1));
+
+        // held writes of others land first and drop known cells
+        mp_excel->flushCombined();
+        m_flushing = true;
+        const bool written = mp_excel->SetDataToRange(m_sheetName, rect, block);
+        m_flushing = false;
+        if(!written)
+        {
+            result = false;
+            continue;
+        }
+
+        for(int y=rect.y(); y<rect.y()+rect.height(); y++)
+        {
+            for(int x=rect.x(); x<rect.x()+rect.width(); x++)
+            {
+                Tile *ptile = tile(x, y);
+                const quint32 bit = 1u << (x % TileSize);
+                if(ptile->dirty[y % TileSize] & bit)
+                {
+                    ptile->dirty[y % TileSize] &= ~bit;
+                    m_dirtyCount--;
+                }
+                else m_cellsRewritten++;
+            }
+        }
+        m_rectsEmitted++;
+        m_cellsWritten += block.count();
+    }
+
+    m_flushTime = timer.elapsed();
+    return result;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file:excelsheetmodel.h   -
+ * @description: In-memory sparse model of sheet values. Writes are kept
+ *               locally and dirty cells are sent as few block writes.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#ifndef EXCELSHEETMODEL_H
+#define EXCELSHEETMODEL_H
+
+#include "excel.h"
+#include <QHash>
+#include <QVector>
+#include <QVariant>
+
+/* Cells are stored in tiles of TileSize x TileSize with bit masks of known
+   and dirty cells per tile row. flush() covers dirty cells by rectangles,
+   rectangles are merged when the clean cells rewritten by the merge are
+   known and cheaper than one more call. Formula cells are never known, so
+   merges do not overwrite them by values. Model is bound to the sheet named
+   at construction and registered with excel: writes of excel to that sheet
+   (write, post, upsertRows, ...) drop known clean cells, dirty cells stay.
+   Model is detached when excel is destroyed. */
+class ExcelSheetModel
+{
+public:
+    enum {TileSize = 32};
+
+    // sheetname empty - sheet current at construction
+    explicit ExcelSheetModel(Excel *pexcel, const QString &sheetname = QString());
+    ~ExcelSheetModel();
+
+    QString sheetName() const {return m_sheetName;}
+
+    // row, col are 1-based like Excel::write
+    void setValue(qint32 row, qint32 col, const QVariant &data);
+    QVariant value(qint32 row, qint32 col) const;
+    bool isKnown(qint32 row, qint32 col) const;
+    bool isDirty(qint32 row, qint32 col) const;
+    int dirtyCount() const {return m_dirtyCount;}
+
+    /* values of sheet rect are read once so flush may rewrite them, cells
+       with formula are left unknown */
+    bool load(const Excel::Rect &rect);
+    void clear();
+
+    /* clean cells one call is worth; merge of two rectangles is done when
+       it rewrites at most this count of clean cells, 0 - no merge */
+    void setCallCost(int cells) {m_callCost = cells;}
+    int callCost() const {return m_callCost;}
+
+    bool flush();
+
+    // statistics of last flush
+    qint64 flushTime() const {return m_flushTime;}
+    int rectsEmitted() const {return m_rectsEmitted;}
+    int cellsWritten() const {return m_cellsWritten;}
+    int cellsRewritten() const {return m_cellsRewritten;}
+
+private:
+    friend class Excel;
+    class Cover;
+
+    struct Tile{
+        Tile() : values(TileSize*TileSize) {
+            for(int i=0; i<TileSize; i++) {known[i] = 0; dirty[i] = 0;}
+        }
+        QVector<QVariant> values;
+        quint32 known[TileSize];    // bit per column of tile row
+        quint32 dirty[TileSize];
+    };
+
+    static quint64 tileKey(int x, int y) {
+        return (quint64(y/TileSize) << 32) | quint32(x/TileSize);
+    }
+    const Tile *tile(int x, int y) const;
+    Tile *tile(int x, int y);
+    void store(int x, int y, const QVariant &data, bool dirty);
+    bool rectKnown(const Excel::Rect &rect) const;
+    QList<Excel::Rect> cover(QList<Excel::Rect> rects);
+    // sheet was written by others, known clean cells are stale
+    void sheetChanged();
+
+    Excel *mp_excel;
+    QString m_sheetName;
+    bool m_flushing;    // own writes do not drop known cells
+    QHash<quint64, Tile> m_tiles;   // (tile row << 32 | tile col) -> tile
+    int m_dirtyCount;
+    int m_callCost;
+
+    qint64 m_flushTime;
+    int m_rectsEmitted;
+    int m_cellsWritten;
+    int m_cellsRewritten;
+};
+
+#endif // EXCELSHEETMODEL_H
@@ -0,0 +1,255 @@
+/**
+ * @file:excelupsert.cpp   -
+ * @description: Row hashing and update plan of table refresh.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#include "excelupsert.h"
+#include <QDateTime>
+#include <QLocale>
+#include <QHash>
+
+
+QVariant ExcelUpsert::storedValue(const QVariant &data)
+{
+    static const QDateTime epoch(QDate(1899, 12, 30), QTime(0, 0));
+    switch(data.type())
+    {
+    case QVariant::Date:
+        return double(epoch.date().daysTo(data.toDate()));
+    case QVariant::DateTime:
+    {
+        const QDateTime time = data.toDateTime();
+        return epoch.date().daysTo(time.date()) + QTime(0, 0).msecsTo(time.time())/86400000.0;
+    }
+    case QVariant::Time:
+        return QTime(0, 0).msecsTo(data.toTime())/86400000.0;
+    case QVariant::String:
+    {
+        const QString text = data.toString();
+        if(text.startsWith(QLatin1Char('\''))) return text.mid(1);
+        const QString trimmed = text.trimmed();
+        if(trimmed.isEmpty()) return text;
+        bool ok = false;
+        double value = QLocale::c().toDouble(trimmed, &ok);
+        if(!ok) value = QLocale::system().toDouble(trimmed, &ok);
+        if(ok && qIsFinite(value)) return value;
+        if(trimmed.compare("TRUE", Qt::CaseInsensitive) == 0) return true;
+        if(trimmed.compare("FALSE", Qt::CaseInsensitive) == 0) return false;
+        return text;
+    }
+    default:
+        return data;
+    }
+}
+
+// FNV-1a over canonical cell values, numbers of any type hash alike and
+// empty string as empty cell so Value2 read back matches written data
+quint64 ExcelUpsert::rowHash(const QVariantList &row, int width)
+{
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    const quint64 prime = Q_UINT64_C(1099511628211);
+    for(int i=0; i<width; i++)
+    {
+        const QVariant data = i < row.count() ? row[i] : QVariant();
+        uchar tag;
+        QByteArray bytes;
+        switch(data.type())
+        {
+        case QVariant::Invalid:
+            tag = 0;
+            break;
+        case QVariant::Bool:
+            tag = 1;
+            bytes.append(char(data.toBool()));
+            break;
+        case QVariant::Double:
+        case QVariant::Int:
+        case QVariant::UInt:
+        case QVariant::LongLong:
+        case QVariant::ULongLong:
+        {
+            tag = 2;
+            const double number = data.toDouble();
+            bytes = QByteArray(reinterpret_cast<const char *>(&number), sizeof(number));
+            break;
+        }
+        default:
+        {
+            const QString text = data.toString();
+            tag = text.isEmpty() ? 0 : 3;
+            bytes = QByteArray(reinterpret_cast<const char *>(text.utf16()), text.size()*2);
+            break;
+        }
+        }
+        hash = (hash ^ tag)*prime;
+        for(int b=0; b<bytes.size(); b++)
+            hash = (hash ^ uchar(bytes[b]))*prime;
+        // cell separator, "ab","" differs from "a","b"
+        hash = (hash ^ 0xFF)*prime;
+    }
+    return hash;
+}
+
+qint64 ExcelUpsert::variantBytes(const QVariant &data)
+{
+    // VARIANT and BSTR length prefix, terminator and utf-16 text
+    if(data.type() == QVariant::String) return 16 + 6 + 2*data.toString().size();
+    return 16;
+}
+
+/****************************************************************************
+ * @function name: ExcelUpsert::match()
+ * @param:
+ *      const QVector<quint64> &old_hashes, &new_hashes
+ * @description: new rows take next old row of equal hash in order. A match
+ *               skipping old rows is taken only when the run of equal rows
+ *               starting there is as long as the skip (up to MaxRunCheck),
+ *               so a row moved far does not cut off the rows in between.
+ *               Accepted run is matched whole.
+ * @return: ( QVector<int> ) old row of every new row, -1 - none
+ ****************************************************************************/
+QVector<int> ExcelUpsert::match(const QVector<quint64> &old_hashes, const QVector<quint64> &new_hashes)
+{
+    enum {MaxRunCheck = 256};
+    const int old_count = old_hashes.size();
+    const int new_count = new_hashes.size();
+    QVector<int> result(new_count, -1);
+
+    QHash<quint64, QVector<int> > positions;   // hash -> old rows ascending
+    for(int j=0; j<old_count; j++) positions[old_hashes[j]].append(j);
+    QHash<quint64, int> cursor;                // hash -> first index to try
+
+    int last = -1;
+    int i = 0;
+    while(i < new_count)
+    {
+        const quint64 hash = new_hashes[i];
+        QHash<quint64, QVector<int> >::const_iterator it = positions.constFind(hash);
+        if(it == positions.constEnd()) {i++; continue;}
+        const QVector<int> &rows = it.value();
+        int k = cursor.value(hash, 0);
+        while(k < rows.size() && rows[k] <= last) k++;
+        cursor[hash] = k;
+        if(k == rows.size()) {i++; continue;}
+
+        int j = rows[k];
+        const int need = qMin(j - last - 1, (int)MaxRunCheck);
+        int run = 1;
+        while(run < need && i + run < new_count && j + run < old_count
+              && new_hashes[i + run] == old_hashes[j + run])
+            run++;
+        if(run < need) {i++; continue;}
+
+        while(i < new_count && j < old_count && new_hashes[i] == old_hashes[j])
+        {
+            result[i] = j;
+            last = j;
+            i++;
+            j++;
+        }
+    }
+    return result;
+}
+
+/****************************************************************************
+ * @function name: ExcelUpsert::plan()
+ * @param:
+ *      const QVector<quint64> &old_hashes - rows on sheet
+ *      const QVector<quint64> &new_hashes - new rows as stored
+ *      int width - cells per row
+ *      int call_cost - unchanged cells one call is worth
+ * @description: matched runs at same position stay, runs at other position
+ *               are moved when longer than call_cost cells, written
+ *               otherwise. Upward moves go top to bottom, downward moves
+ *               bottom to top, so no move lands on a source not yet moved.
+ *               Write runs are joined over gaps cheaper than a call. Rows
+ *               still holding old data afterwards are cleared.
+ * @return: ( Plan )
+ ****************************************************************************/
+ExcelUpsert::Plan ExcelUpsert::plan(const QVector<quint64> &old_hashes, const QVector<quint64> &new_hashes
+                                    , int width, int call_cost)
+{
+    Plan plan;
+    const int old_count = old_hashes.size();
+    const int new_count = new_hashes.size();
+    const QVector<int> matched = match(old_hashes, new_hashes);
+
+    enum {Stale, Empty, Done};
+    QVector<char> state(qMax(old_count, new_count), Empty);
+    for(int p=0; p<old_count; p++) state[p] = Stale;
+
+    QVector<bool> write(new_count, false);
+    QList<Move> downward;
+    int i = 0;
+    while(i < new_count)
+    {
+        if(matched[i] < 0)
+        {
+            write[i] = true;
+            i++;
+            continue;
+        }
+        int end = i + 1;
+        while(end < new_count && matched[end] == matched[end-1] + 1) end++;
+        const int count = end - i;
+        if(matched[i] == i)
+        {
+            plan.rowsUnchanged += count;
+            for(int p=i; p<end; p++) state[p] = Done;
+        }
+        else if(qint64(count)*width > call_cost)
+        {
+            const Move move = {matched[i], i, count};
+            if(move.from > move.to) plan.moves.append(move);
+            else downward.prepend(move);
+            plan.rowsMoved += count;
+        }
+        else
+        {
+            for(int p=i; p<end; p++) write[p] = true;
+        }
+        i = end;
+    }
+    plan.moves += downward;
+
+    foreach(const Move &move, plan.moves)
+    {
+        for(int p=move.from; p<move.from + move.count; p++) state[p] = Empty;
+        for(int p=move.to; p<move.to + move.count; p++) state[p] = Done;
+    }
+
+    // run is extended over gaps cheaper than a call
+    int r = 0;
+    while(r < new_count)
+    {
+        if(!write[r]) {r++; continue;}
+        int end = r + 1;
+        while(true)
+        {
+            while(end < new_count && write[end]) end++;
+            int next = end;
+            while(next < new_count && !write[next]) next++;
+            if(next >= new_count || qint64(next - end)*width >= call_cost) break;
+            end = next;
+        }
+        const Run run = {r, end - r};
+        plan.writes.append(run);
+        for(int p=r; p<end; p++) state[p] = Done;
+        r = end;
+    }
+
+    int p = 0;
+    while(p < state.size())
+    {
+        if(state[p] != Stale) {p++; continue;}
+        int end = p + 1;
+        while(end < state.size() && state[end] == Stale) end++;
+        const Run run = {p, end - p};
+        plan.clears.append(run);
+        p = end;
+    }
+    return plan;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file:excelupsert.h   -
+ * @description: Row hashing and update plan of table refresh. Pure
+ *               computation, no ActiveX calls, so it can be used and
+ *               measured alone.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#ifndef EXCELUPSERT_H
+#define EXCELUPSERT_H
+
+#include <QVariant>
+#include <QVector>
+#include <QList>
+
+/* Old rows on sheet and new rows are matched by hash in order, so an
+   inserted or deleted row does not change the rows after it. Matched runs
+   at other position are moved by one cut when that is cheaper than
+   writing them, rows without match are written, stale rows are cleared. */
+class ExcelUpsert
+{
+public:
+    // rows relative to first table row
+    struct Move{
+        int from;
+        int to;
+        int count;
+    };
+    struct Run{
+        int first;
+        int count;
+    };
+    struct Plan{
+        Plan() {rowsUnchanged = 0; rowsMoved = 0;}
+        QList<Move> moves;      // in order of execution, before writes
+        QList<Run> writes;      // rows of new data
+        QList<Run> clears;      // stale rows after moves and writes
+        int rowsUnchanged;      // matched at same position, not written
+        int rowsMoved;
+    };
+
+    // value as Value2 returns it after write: dates are day serials, texts
+    // parsed by excel are numbers or booleans, apostrophe keeps text as is
+    static QVariant storedValue(const QVariant &data);
+    static quint64 rowHash(const QVariantList &row, int width);
+    // approximate VARIANT payload of value
+    static qint64 variantBytes(const QVariant &data);
+
+    /* old_hashes - rows on sheet, new_hashes - new rows as excel stores
+       them. Moves and writes are worth call_cost cells per call, width is
+       cells per row */
+    static Plan plan(const QVector<quint64> &old_hashes, const QVector<quint64> &new_hashes
+                     , int width, int call_cost);
+
+private:
+    static QVector<int> match(const QVector<quint64> &old_hashes, const QVector<quint64> &new_hashes);
+};
+
+#endif // EXCELUPSERT_H
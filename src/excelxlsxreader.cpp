@@ -0,0 +1,969 @@
+/**
+ * @file:excelxlsxreader.cpp   -
+ * @description: Reader of xlsx files without Excel.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#include "excelxlsxreader.h"
+#include "exceladdress.h"
+#include <QXmlStreamReader>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <qmath.h>
+#include <string.h>
+
+
+static const char *relNs = "http://schemas.openxmlformats.org/officeDocument/2006/relationships";
+
+static quint32 le16(const char *p)
+{
+    return quint32(uchar(p[0])) | quint32(uchar(p[1])) << 8;
+}
+
+static quint32 le32(const char *p)
+{
+    return le16(p) | le16(p + 2) << 16;
+}
+
+
+//*********************************************************************
+//                              CLASS
+//
+//          Data of one zip entry, stored or inflated chunk by chunk
+//*********************************************************************
+class ExcelXlsxReader::EntryStream
+{
+public:
+    EntryStream(QFile *pfile, const Entry &entry);
+
+    bool isValid() const {return !m_error;}
+    bool atEnd() const {return m_done;}
+    // next data of about max bytes, empty at end or on error
+    QByteArray read(int max);
+
+private:
+    enum {FastBits = 9, WindowSize = 32768};
+    enum Mode {Header, Stored, Codes};
+
+    // canonical code: counts of lengths, symbols ordered by code and table
+    // of codes up to FastBits long, symbol | length << 12, 0 - longer code
+    struct Huffman{
+        quint16 count[16];
+        quint16 symbol[320];
+        quint16 fast[1 << FastBits];
+    };
+
+    bool fill();
+    bool need(int count);
+    int bits(int count);
+    int decode(const Huffman &h);
+    bool readTables();
+    static bool build(Huffman *ph, const quint8 *lengths, int n);
+
+    QFile *mp_file;
+    qint64 m_pos;       // file position of next input chunk
+    qint64 m_left;      // compressed bytes not read yet
+    QByteArray m_in;
+    int m_inPos;
+    quint64 m_bitBuf;
+    int m_bitCount;
+
+    bool m_deflate;
+    bool m_done;
+    bool m_error;
+    bool m_final;
+    Mode m_mode;
+    int m_stored;       // bytes left of stored block
+    Huffman m_lit;
+    Huffman m_dist;
+    QByteArray m_window;
+    quint32 m_windowPos;
+    qint64 m_total;
+};
+
+ExcelXlsxReader::EntryStream::EntryStream(QFile *pfile, const Entry &entry)
+{
+    mp_file = pfile;
+    m_pos = 0;
+    m_left = 0;
+    m_inPos = 0;
+    m_bitBuf = 0;
+    m_bitCount = 0;
+    m_deflate = entry.method == 8;
+    m_done = false;
+    m_error = true;
+    m_final = false;
+    m_mode = Header;
+    m_stored = 0;
+    m_windowPos = 0;
+    m_total = 0;
+
+    // data follow local header, its name and extra lengths may differ from directory
+    if(entry.method != 0 && entry.method != 8) return;
+    if(!mp_file->seek(entry.offset)) return;
+    const QByteArray head = mp_file->read(30);
+    if(head.size() != 30 || le32(head.constData()) != 0x04034b50) return;
+    m_pos = qint64(entry.offset) + 30 + le16(head.constData() + 26) + le16(head.constData() + 28);
+    m_left = entry.compressedSize;
+    if(m_deflate) m_window.fill(0, WindowSize);
+    m_error = false;
+}
+
+bool ExcelXlsxReader::EntryStream::fill()
+{
+    if(m_left <= 0 || !mp_file->seek(m_pos)) return false;
+    m_in = mp_file->read(qMin(m_left, Q_INT64_C(1) << 16));
+    m_inPos = 0;
+    if(m_in.isEmpty()) return false;
+    m_pos += m_in.size();
+    m_left -= m_in.size();
+    return true;
+}
+
+bool ExcelXlsxReader::EntryStream::need(int count)
+{
+    while(m_bitCount < count)
+    {
+        if(m_inPos >= m_in.size() && !fill()) return false;
+        m_bitBuf |= quint64(uchar(m_in.constData()[m_inPos++])) << m_bitCount;
+        m_bitCount += 8;
+    }
+    return true;
+}
+
+int ExcelXlsxReader::EntryStream::bits(int count)
+{
+    if(!need(count))
+    {
+        m_error = true;
+        return 0;
+    }
+    const int value = int(m_bitBuf & ((quint64(1) << count) - 1));
+    m_bitBuf >>= count;
+    m_bitCount -= count;
+    return value;
+}
+
+int ExcelXlsxReader::EntryStream::decode(const Huffman &h)
+{
+    // bit buffer is kept full, short codes are one table look-up
+    while(m_bitCount <= 56)
+    {
+        if(m_inPos >= m_in.size() && !fill()) break;
+        m_bitBuf |= quint64(uchar(m_in.constData()[m_inPos++])) << m_bitCount;
+        m_bitCount += 8;
+    }
+    const quint16 entry = h.fast[m_bitBuf & ((1 << FastBits) - 1)];
+    if(entry && (entry >> 12) <= m_bitCount)
+    {
+        m_bitBuf >>= entry >> 12;
+        m_bitCount -= entry >> 12;
+        return entry & 0xFFF;
+    }
+
+    // long code bit by bit, codes are sent most significant bit first
+    int code = 0, first = 0, index = 0;
+    for(int len=1; len<16; len++)
+    {
+        code |= bits(1);
+        if(m_error) return -1;
+        const int count = h.count[len];
+        if(code - count < first) return h.symbol[index + (code - first)];
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    m_error = true;
+    return -1;
+}
+
+bool ExcelXlsxReader::EntryStream::build(Huffman *ph, const quint8 *lengths, int n)
+{
+    memset(ph->count, 0, sizeof(ph->count));
+    memset(ph->fast, 0, sizeof(ph->fast));
+    for(int sym=0; sym<n; sym++) ph->count[lengths[sym]]++;
+    if(ph->count[0] == n) return true;
+
+    // over-subscribed set of lengths is no code
+    int left = 1;
+    for(int len=1; len<16; len++)
+    {
+        left <<= 1;
+        left -= ph->count[len];
+        if(left < 0) return false;
+    }
+
+    quint16 offsets[16];
+    offsets[1] = 0;
+    for(int len=1; len<15; len++) offsets[len + 1] = offsets[len] + ph->count[len];
+    for(int sym=0; sym<n; sym++)
+        if(lengths[sym]) ph->symbol[offsets[lengths[sym]]++] = sym;
+
+    // table is indexed by bits as they come, code bits reversed
+    int code = 0, index = 0;
+    for(int len=1; len<16; len++)
+    {
+        for(int k=0; k<ph->count[len]; k++, code++)
+        {
+            const int sym = ph->symbol[index++];
+            if(len > FastBits) continue;
+            int reversed = 0;
+            for(int b=0; b<len; b++)
+                reversed |= ((code >> b) & 1) << (len - 1 - b);
+            for(int fill=reversed; fill<(1 << FastBits); fill+=(1 << len))
+                ph->fast[fill] = quint16(sym | (len << 12));
+        }
+        code <<= 1;
+    }
+    return true;
+}
+
+bool ExcelXlsxReader::EntryStream::readTables()
+{
+    static const quint8 order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+    quint8 lengths[320];
+    memset(lengths, 0, sizeof(lengths));
+
+    const int nlen = bits(5) + 257;
+    const int ndist = bits(5) + 1;
+    const int ncode = bits(4) + 4;
+    if(m_error || nlen > 286 || ndist > 30) return false;
+
+    for(int i=0; i<ncode; i++) lengths[order[i]] = quint8(bits(3));
+    Huffman lencode;
+    if(m_error || !build(&lencode, lengths, 19)) return false;
+
+    int index = 0;
+    while(index < nlen + ndist)
+    {
+        int sym = decode(lencode);
+        if(sym < 0) return false;
+        if(sym < 16)
+        {
+            lengths[index++] = quint8(sym);
+            continue;
+        }
+        quint8 len = 0;
+        if(sym == 16)
+        {
+            if(index == 0) return false;
+            len = lengths[index - 1];
+            sym = 3 + bits(2);
+        }
+        else if(sym == 17) sym = 3 + bits(3);
+        else sym = 11 + bits(7);
+        if(m_error || index + sym > nlen + ndist) return false;
+        while(sym--) lengths[index++] = len;
+    }
+    if(lengths[256] == 0) return false;
+    return build(&m_lit, lengths, nlen) && build(&m_dist, lengths + nlen, ndist);
+}
+
+/****************************************************************************
+ * @function name: ExcelXlsxReader::EntryStream::read()
+ * @param:
+ *      int max - chunk size, may be exceeded by one match
+ * @description: deflate blocks are decoded until chunk is full, state is
+ *               kept between symbols so next call continues
+ * @return: ( QByteArray ) data, empty at end or on error
+ ****************************************************************************/
+QByteArray ExcelXlsxReader::EntryStream::read(int max)
+{
+    QByteArray out;
+    if(m_done || m_error) return out;
+
+    if(!m_deflate)
+    {
+        if(!fill())
+        {
+            m_done = m_left <= 0;
+            m_error = !m_done;
+            return out;
+        }
+        return m_in;
+    }
+
+    static const quint16 lbase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                      35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const quint8 lext[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const quint16 dbase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                      257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                      8193, 12289, 16385, 24577};
+    static const quint8 dext[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+    const quint32 mask = WindowSize - 1;
+
+    out.resize(max + 258);
+    char *dst = out.data();
+    char *window = m_window.data();
+    int n = 0;
+    while(n < max && !m_error)
+    {
+        if(m_mode == Header)
+        {
+            if(m_final)
+            {
+                m_done = true;
+                break;
+            }
+            m_final = bits(1);
+            const int type = bits(2);
+            if(m_error) break;
+            if(type == 0)
+            {
+                // stored block starts at byte boundary
+                m_bitBuf >>= m_bitCount & 7;
+                m_bitCount -= m_bitCount & 7;
+                const int len = bits(16);
+                const int nlen = bits(16);
+                if(m_error || len != (~nlen & 0xFFFF)) m_error = true;
+                m_stored = len;
+                m_mode = Stored;
+            }
+            else if(type == 1)
+            {
+                quint8 lengths[320];
+                int sym = 0;
+                for(; sym<144; sym++) lengths[sym] = 8;
+                for(; sym<256; sym++) lengths[sym] = 9;
+                for(; sym<280; sym++) lengths[sym] = 7;
+                for(; sym<288; sym++) lengths[sym] = 8;
+                for(; sym<288 + 30; sym++) lengths[sym] = 5;
+                build(&m_lit, lengths, 288);
+                build(&m_dist, lengths + 288, 30);
+                m_mode = Codes;
+            }
+            else if(type == 2)
+            {
+                if(!readTables()) m_error = true;
+                m_mode = Codes;
+            }
+            else m_error = true;
+        }
+        else if(m_mode == Stored)
+        {
+            while(m_stored > 0 && n < max)
+            {
+                const char c = char(bits(8));
+                if(m_error) break;
+                dst[n++] = c;
+                window[m_windowPos++ & mask] = c;
+                m_total++;
+                m_stored--;
+            }
+            if(m_stored == 0) m_mode = Header;
+        }
+        else
+        {
+            int sym = decode(m_lit);
+            if(sym < 0) break;
+            if(sym < 256)
+            {
+                dst[n++] = char(sym);
+                window[m_windowPos++ & mask] = char(sym);
+                m_total++;
+                continue;
+            }
+            if(sym == 256)
+            {
+                m_mode = Header;
+                continue;
+            }
+            sym -= 257;
+            if(sym >= 29)
+            {
+                m_error = true;
+                break;
+            }
+            const int len = lbase[sym] + bits(lext[sym]);
+            const int dsym = decode(m_dist);
+            if(dsym < 0 || dsym >= 30)
+            {
+                m_error = true;
+                break;
+            }
+            const quint32 dist = dbase[dsym] + bits(dext[dsym]);
+            if(m_error || dist > m_total)
+            {
+                m_error = true;
+                break;
+            }
+            // overlapping copy repeats bytes just written
+            for(int i=0; i<len; i++)
+            {
+                const char c = window[(m_windowPos - dist) & mask];
+                dst[n++] = c;
+                window[m_windowPos++ & mask] = c;
+            }
+            m_total += len;
+        }
+    }
+    if(m_error) n = 0;
+    out.resize(n);
+    return out;
+}
+
+
+ExcelXlsxReader::ExcelXlsxReader(const QString &filename)
+{
+    m_filename = filename;
+    m_opened = false;
+    m_current = -1;
+    m_xmlBytes = 0;
+    m_time = 0;
+}
+
+ExcelXlsxReader::~ExcelXlsxReader()
+{
+    close();
+}
+
+bool ExcelXlsxReader::fail(const QString &text)
+{
+    if(m_error.isEmpty()) m_error = text;
+    return false;
+}
+
+bool ExcelXlsxReader::open()
+{
+    if(m_opened) return true;
+    m_error.clear();
+    m_file.setFileName(m_filename);
+    if(!m_file.open(QIODevice::ReadOnly)) return fail(m_file.errorString());
+    if(readDirectory() && readWorkbook() && readStyles())
+    {
+        m_current = m_sheets.isEmpty() ? -1 : 0;
+        m_opened = true;
+        return true;
+    }
+    close();
+    return false;
+}
+
+void ExcelXlsxReader::close()
+{
+    m_file.close();
+    m_entries.clear();
+    m_sheets.clear();
+    m_dateStyles.clear();
+    m_strings.clear();
+    m_stringsPath.clear();
+    m_stylesPath.clear();
+    m_current = -1;
+    m_opened = false;
+}
+
+QStringList ExcelXlsxReader::sheetsList() const
+{
+    QStringList result;
+    foreach(const Sheet &sheet, m_sheets)
+        result += sheet.name;
+    return result;
+}
+
+int ExcelXlsxReader::sheetIndex(const QString &sheetname) const
+{
+    for(int i=0; i<m_sheets.count(); i++)
+        if(m_sheets[i].name.compare(sheetname, Qt::CaseInsensitive) == 0) return i;
+    return -1;
+}
+
+bool ExcelXlsxReader::setCurrentSheet(const QString &sheetname)
+{
+    const int index = sheetIndex(sheetname);
+    if(index < 0) return false;
+    m_current = index;
+    return true;
+}
+
+QString ExcelXlsxReader::currentSheet() const
+{
+    return m_current >= 0 ? m_sheets[m_current].name : QString();
+}
+
+double ExcelXlsxReader::megabytesPerSecond() const
+{
+    if(m_time == 0) return 0;
+    return 1e9*m_xmlBytes/m_time/(1024.0*1024.0);
+}
+
+// end of central directory is searched from the end, zip comment may follow it
+bool ExcelXlsxReader::readDirectory()
+{
+    const qint64 size = m_file.size();
+    if(size < 22) return fail("not a zip file");
+    const qint64 tail = qMin(size, Q_INT64_C(22 + 65535));
+    if(!m_file.seek(size - tail)) return fail(m_file.errorString());
+    const QByteArray end = m_file.read(tail);
+
+    int pos = end.size() - 22;
+    while(pos >= 0 && le32(end.constData() + pos) != 0x06054b50) pos--;
+    if(pos < 0) return fail("not a zip file");
+
+    const int count = le16(end.constData() + pos + 10);
+    const quint32 dir_size = le32(end.constData() + pos + 12);
+    const quint32 dir_offset = le32(end.constData() + pos + 16);
+    if(!m_file.seek(dir_offset)) return fail("bad zip directory");
+    const QByteArray dir = m_file.read(dir_size);
+    if(dir.size() != int(dir_size)) return fail("bad zip directory");
+
+    const char *p = dir.constData();
+    int offset = 0;
+    for(int i=0; i<count; i++)
+    {
+        if(offset + 46 > dir.size() || le32(p + offset) != 0x02014b50) return fail("bad zip directory");
+        Entry entry;
+        entry.method = quint16(le16(p + offset + 10));
+        entry.compressedSize = le32(p + offset + 20);
+        entry.size = le32(p + offset + 24);
+        entry.offset = le32(p + offset + 42);
+        const int name_length = le16(p + offset + 28);
+        const int next = offset + 46 + name_length + le16(p + offset + 30) + le16(p + offset + 32);
+        if(next > dir.size()) return fail("bad zip directory");
+        m_entries.insert(QString::fromUtf8(p + offset + 46, name_length), entry);
+        offset = next;
+    }
+    return true;
+}
+
+bool ExcelXlsxReader::nextToken(EntryStream *pstream, QXmlStreamReader *preader)
+{
+    while(true)
+    {
+        preader->readNext();
+        if(!preader->hasError()) return preader->tokenType() != QXmlStreamReader::EndDocument;
+        if(preader->error() != QXmlStreamReader::PrematureEndOfDocumentError) return fail(preader->errorString());
+
+        const QByteArray chunk = pstream->read(1 << 16);
+        if(chunk.isEmpty()) return fail(pstream->isValid() ? "truncated xml" : "corrupt zip entry");
+        m_xmlBytes += chunk.size();
+        preader->addData(chunk);
+    }
+}
+
+// sheet parts are found through workbook relationships
+bool ExcelXlsxReader::readWorkbook()
+{
+    const QString rels_path("xl/_rels/workbook.xml.rels");
+    if(!m_entries.contains(rels_path) || !m_entries.contains("xl/workbook.xml")) return fail("not a workbook");
+
+    QHash<QString, QString> targets;
+    {
+        EntryStream stream(&m_file, m_entries.value(rels_path));
+        QXmlStreamReader reader;
+        while(nextToken(&stream, &reader))
+        {
+            if(reader.tokenType() != QXmlStreamReader::StartElement || reader.name() != QLatin1String("Relationship"))
+                continue;
+            const QXmlStreamAttributes attrs = reader.attributes();
+            QString target = attrs.value(QLatin1String("Target")).toString();
+            target = target.startsWith('/') ? target.mid(1) : "xl/" + target;
+            const QString type = attrs.value(QLatin1String("Type")).toString();
+            if(type.endsWith("/sharedStrings")) m_stringsPath = target;
+            else if(type.endsWith("/styles")) m_stylesPath = target;
+            targets.insert(attrs.value(QLatin1String("Id")).toString(), target);
+        }
+        if(!m_error.isEmpty()) return false;
+    }
+
+    EntryStream stream(&m_file, m_entries.value("xl/workbook.xml"));
+    QXmlStreamReader reader;
+    while(nextToken(&stream, &reader))
+    {
+        if(reader.tokenType() != QXmlStreamReader::StartElement || reader.name() != QLatin1String("sheet"))
+            continue;
+        const QXmlStreamAttributes attrs = reader.attributes();
+        Sheet sheet;
+        sheet.name = attrs.value(QLatin1String("name")).toString();
+        sheet.path = targets.value(attrs.value(QLatin1String(relNs), QLatin1String("id")).toString());
+        if(m_entries.contains(sheet.path)) m_sheets.append(sheet);
+    }
+    return m_error.isEmpty();
+}
+
+// cell formats with date number format
+bool ExcelXlsxReader::readStyles()
+{
+    if(m_stylesPath.isEmpty() || !m_entries.contains(m_stylesPath)) return true;
+
+    QHash<int, QString> codes;
+    bool cell_formats = false;
+    EntryStream stream(&m_file, m_entries.value(m_stylesPath));
+    QXmlStreamReader reader;
+    while(nextToken(&stream, &reader))
+    {
+        if(reader.tokenType() == QXmlStreamReader::EndElement && reader.name() == QLatin1String("cellXfs"))
+            break;
+        if(reader.tokenType() != QXmlStreamReader::StartElement) continue;
+
+        const QStringRef name = reader.name();
+        const QXmlStreamAttributes attrs = reader.attributes();
+        if(name == QLatin1String("numFmt"))
+            codes.insert(attrs.value(QLatin1String("numFmtId")).toString().toInt()
+                         , attrs.value(QLatin1String("formatCode")).toString());
+        else if(name == QLatin1String("cellXfs"))
+            cell_formats = true;
+        else if(cell_formats && name == QLatin1String("xf"))
+        {
+            const int id = attrs.value(QLatin1String("numFmtId")).toString().toInt();
+            m_dateStyles.append(isDateFormat(id, codes.value(id)));
+        }
+    }
+    return m_error.isEmpty();
+}
+
+bool ExcelXlsxReader::isDateFormat(int id, const QString &code)
+{
+    if((id >= 14 && id <= 22) || (id >= 27 && id <= 36) || (id >= 45 && id <= 47) || (id >= 50 && id <= 58))
+        return true;
+    if(id < 164 || code.isEmpty()) return false;
+
+    // date and time letters outside quoted texts, escapes and [colors]
+    for(int i=0; i<code.size(); i++)
+    {
+        const QChar c = code[i].toLower();
+        if(c == '"')
+        {
+            i = code.indexOf('"', i + 1);
+            if(i < 0) break;
+        }
+        else if(c == '\\' || c == '_' || c == '*') i++;
+        else if(c == '[')
+        {
+            const int close = code.indexOf(']', i + 1);
+            if(close < 0) break;
+            // [h]:mm elapsed time
+            const QString inner = code.mid(i + 1, close - i - 1).toLower();
+            if(!inner.isEmpty() && inner.count(inner[0]) == inner.size()
+                    && (inner[0] == 'h' || inner[0] == 'm' || inner[0] == 's')) return true;
+            i = close;
+        }
+        else if(c == 'd' || c == 'm' || c == 'y' || c == 'h' || c == 's') return true;
+    }
+    return false;
+}
+
+// serial days since 1899-12-30 like OLE dates
+QVariant ExcelXlsxReader::numberValue(const QString &text, int style) const
+{
+    bool ok = false;
+    const double number = text.toDouble(&ok);
+    if(!ok) return QVariant();
+    if(style <= 0 || style >= m_dateStyles.size() || !m_dateStyles[style]) return number;
+
+    qint64 days = qint64(qFloor(number));
+    qint64 msec = qRound64((number - days)*86400000.0);
+    if(msec >= 86400000) {days++; msec -= 86400000;}
+    return QDateTime(QDate(1899, 12, 30).addDays(days), QTime(0, 0).addMSecs(int(msec)));
+}
+
+/****************************************************************************
+ * @function name: ExcelXlsxReader::parseSheet()
+ * @param:
+ *      const Sheet &sheet
+ *      const QRect &rect - 0-based cells
+ *      QVector<QVariant> *pcells - row-major values of rect
+ *      QHash<int, QList<int> > *ppending - shared string -> cells using it
+ * @description: rows before rect are passed without reading cells, parsing
+ *               stops at first row after rect
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool ExcelXlsxReader::parseSheet(const Sheet &sheet, const QRect &rect, QVector<QVariant> *pcells
+                                 , QHash<int, QList<int> > *ppending)
+{
+    const int x0 = rect.x(), x1 = rect.x() + rect.width() - 1;
+    const int y0 = rect.y(), y1 = rect.y() + rect.height() - 1;
+
+    EntryStream stream(&m_file, m_entries.value(sheet.path));
+    QXmlStreamReader reader;
+    int row = -1, col = -1;
+    bool in_row = false;    // row of rect
+    bool in_cell = false;   // cell of rect
+    bool in_text = false;
+    int phonetic = 0;
+    int style = 0;
+    bool has_text = false;
+    QString type;
+    QString text;
+
+    while(nextToken(&stream, &reader))
+    {
+        const QXmlStreamReader::TokenType token = reader.tokenType();
+        if(token == QXmlStreamReader::Characters)
+        {
+            if(in_text)
+            {
+                text += reader.text();
+                has_text = true;
+            }
+            continue;
+        }
+
+        const QStringRef name = reader.name();
+        if(token == QXmlStreamReader::StartElement)
+        {
+            if(name == QLatin1String("row"))
+            {
+                const QStringRef r = reader.attributes().value(QLatin1String("r"));
+                row = r.isEmpty() ? row + 1 : r.toString().toInt() - 1;
+                if(row > y1) break;
+                in_row = row >= y0;
+                col = -1;
+            }
+            else if(in_row && name == QLatin1String("c"))
+            {
+                const QXmlStreamAttributes attrs = reader.attributes();
+                const QStringRef r = attrs.value(QLatin1String("r"));
+                ExcelAddress::Ref ref;
+                if(!r.isEmpty() && ExcelAddress::parseCell(r.constData(), r.size(), &ref)) col = ref.col;
+                else col++;
+                in_cell = col >= x0 && col <= x1;
+                if(in_cell)
+                {
+                    type = attrs.value(QLatin1String("t")).toString();
+                    style = attrs.value(QLatin1String("s")).toString().toInt();
+                    text.clear();
+                    has_text = false;
+                    phonetic = 0;
+                }
+            }
+            else if(in_cell)
+            {
+                if(name == QLatin1String("rPh")) phonetic++;
+                else if(name == QLatin1String("v") || (name == QLatin1String("t") && phonetic == 0)) in_text = true;
+            }
+        }
+        else if(token == QXmlStreamReader::EndElement)
+        {
+            if(name == QLatin1String("v") || name == QLatin1String("t")) in_text = false;
+            else if(name == QLatin1String("rPh")) phonetic--;
+            else if(name == QLatin1String("c") && in_cell)
+            {
+                in_cell = false;
+                const int index = (row - y0)*rect.width() + col - x0;
+                if(type == QLatin1String("s"))
+                {
+                    bool ok = false;
+                    const int id = text.toInt(&ok);
+                    if(!ok) continue;
+                    QHash<int, QString>::const_iterator it = m_strings.constFind(id);
+                    if(it != m_strings.constEnd()) (*pcells)[index] = it.value();
+                    else (*ppending)[id].append(index);
+                }
+                else if(type == QLatin1String("str") || type == QLatin1String("inlineStr")) (*pcells)[index] = text;
+                else if(type == QLatin1String("b")) (*pcells)[index] = text.trimmed() == QLatin1String("1");
+                else if(type == QLatin1String("d")) (*pcells)[index] = QDateTime::fromString(text, Qt::ISODate);
+                else if(type != QLatin1String("e") && has_text) (*pcells)[index] = numberValue(text, style);
+            }
+            else if(name == QLatin1String("row")) in_row = false;
+            else if(name == QLatin1String("sheetData")) break;
+        }
+    }
+    return m_error.isEmpty();
+}
+
+/****************************************************************************
+ * @function name: ExcelXlsxReader::resolveStrings()
+ * @param:
+ *      const QHash<int, QList<int> > &pending - shared string -> cells
+ *      QVector<QVariant> *pcells
+ * @description: shared strings part is read once up to the last needed
+ *               string, only needed strings are kept
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool ExcelXlsxReader::resolveStrings(const QHash<int, QList<int> > &pending, QVector<QVariant> *pcells)
+{
+    if(pending.isEmpty()) return true;
+    if(m_stringsPath.isEmpty() || !m_entries.contains(m_stringsPath)) return fail("no shared strings");
+
+    EntryStream stream(&m_file, m_entries.value(m_stringsPath));
+    QXmlStreamReader reader;
+    int index = -1;
+    int found = 0;
+    int phonetic = 0;
+    bool in_text = false;
+    bool wanted = false;
+    QString text;
+    while(found < pending.size() && nextToken(&stream, &reader))
+    {
+        const QXmlStreamReader::TokenType token = reader.tokenType();
+        if(token == QXmlStreamReader::Characters)
+        {
+            if(in_text && wanted) text += reader.text();
+            continue;
+        }
+        const QStringRef name = reader.name();
+        if(token == QXmlStreamReader::StartElement)
+        {
+            if(name == QLatin1String("si"))
+            {
+                index++;
+                wanted = pending.contains(index);
+                text.clear();
+                phonetic = 0;
+            }
+            else if(name == QLatin1String("rPh")) phonetic++;
+            else if(name == QLatin1String("t") && phonetic == 0) in_text = true;
+        }
+        else if(token == QXmlStreamReader::EndElement)
+        {
+            if(name == QLatin1String("t")) in_text = false;
+            else if(name == QLatin1String("rPh")) phonetic--;
+            else if(name == QLatin1String("si") && wanted)
+            {
+                m_strings.insert(index, text);
+                foreach(int cell, pending.value(index))
+                    (*pcells)[cell] = text;
+                found++;
+            }
+        }
+    }
+    if(!m_error.isEmpty()) return false;
+    return found == pending.size() || fail("missing shared string");
+}
+
+// dimension element or, when missing, bounding box of cells
+bool ExcelXlsxReader::scanDimension(const Sheet &sheet, QRect *prect)
+{
+    EntryStream stream(&m_file, m_entries.value(sheet.path));
+    QXmlStreamReader reader;
+    int x0 = ExcelAddress::MaxColumns, y0 = ExcelAddress::MaxRows, x1 = -1, y1 = -1;
+    int row = -1, col = -1;
+    while(nextToken(&stream, &reader))
+    {
+        if(reader.tokenType() != QXmlStreamReader::StartElement) continue;
+        const QStringRef name = reader.name();
+        const QStringRef r = reader.attributes().value(QLatin1String("r"));
+        if(name == QLatin1String("dimension"))
+        {
+            const QStringRef ref = reader.attributes().value(QLatin1String("ref"));
+            ExcelAddress::Area area;
+            if(ExcelAddress::parseArea(ref.constData(), ref.size(), &area) && area.type == ExcelAddress::Cells
+                    && !(area.first.col == 0 && area.first.row == 0 && area.last.col == 0 && area.last.row == 0))
+            {
+                *prect = QRect(area.first.col, area.first.row
+                               , area.last.col - area.first.col + 1, area.last.row - area.first.row + 1);
+                return true;
+            }
+        }
+        else if(name == QLatin1String("row"))
+        {
+            row = r.isEmpty() ? row + 1 : r.toString().toInt() - 1;
+            col = -1;
+        }
+        else if(name == QLatin1String("c"))
+        {
+            ExcelAddress::Ref ref;
+            if(!r.isEmpty() && ExcelAddress::parseCell(r.constData(), r.size(), &ref)) col = ref.col;
+            else col++;
+            x0 = qMin(x0, col);
+            x1 = qMax(x1, col);
+            y0 = qMin(y0, row);
+            y1 = qMax(y1, row);
+        }
+    }
+    if(!m_error.isEmpty()) return false;
+    // A1 for empty sheet like Excel
+    *prect = x1 < 0 ? QRect(0, 0, 1, 1) : QRect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+    return true;
+}
+
+QString ExcelXlsxReader::usedRange(const QString &sheetname)
+{
+    m_error.clear();
+    const int index = sheetname.isEmpty() ? m_current : sheetIndex(sheetname);
+    if(!m_opened || index < 0) return QString();
+    QRect rect;
+    if(!scanDimension(m_sheets[index], &rect)) return QString();
+
+    ExcelAddress::Area area;
+    area.first.col = rect.x();
+    area.first.row = rect.y();
+    area.first.flags = 0;
+    area.last.col = rect.x() + rect.width() - 1;
+    area.last.row = rect.y() + rect.height() - 1;
+    area.last.flags = 0;
+    area.type = ExcelAddress::Cells;
+    area.sheetBegin = -1;
+    area.sheetLength = 0;
+    char buf[ExcelAddress::MaxAreaLength];
+    ExcelAddress::formatArea(area, buf);
+    return QString::fromLatin1(buf);
+}
+
+/****************************************************************************
+ * @function name: ExcelXlsxReader::readRange()
+ * @param:
+ *      const QString &range
+ *      QVariantList *presult - list of rows, each a list of values
+ * @description: cells of range are read from sheet xml, shared strings of
+ *               range are resolved after
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool ExcelXlsxReader::readRange(const QString &range, QVariantList *presult)
+{
+    m_error.clear();
+    m_xmlBytes = 0;
+    m_time = 0;
+    if(presult) presult->clear();
+    if(!m_opened) return fail("not open");
+
+    QElapsedTimer timer;
+    timer.start();
+    ExcelAddress::Area area;
+    if(ExcelAddress::parseRange(range, &area, 1) <= 0) return fail("invalid range");
+
+    int index = m_current;
+    if(area.sheetBegin >= 0)
+        index = sheetIndex(range.mid(area.sheetBegin, area.sheetLength).replace("''", "'"));
+    if(index < 0) return fail("no sheet");
+    const Sheet &sheet = m_sheets[index];
+
+    QRect rect(area.first.col, area.first.row, area.last.col - area.first.col + 1, area.last.row - area.first.row + 1);
+    if(area.type != ExcelAddress::Cells)
+    {
+        // whole rows or columns are cut to used range
+        QRect used;
+        if(!scanDimension(sheet, &used)) return false;
+        rect = rect.intersected(used);
+        if(rect.isEmpty()) return true;
+    }
+
+    QVector<QVariant> cells(rect.width()*rect.height());
+    QHash<int, QList<int> > pending;
+    if(!parseSheet(sheet, rect, &cells, &pending) || !resolveStrings(pending, &cells)) return false;
+
+    if(presult)
+    {
+        for(int y=0; y<rect.height(); y++)
+        {
+            QVariantList row;
+            row.reserve(rect.width());
+            for(int x=0; x<rect.width(); x++)
+                row.append(cells[y*rect.width() + x]);
+            presult->append(QVariant(row));
+        }
+    }
+    m_time = timer.nsecsElapsed();
+    return true;
+}
+
+bool ExcelXlsxReader::read(qint32 row, qint32 col, QVariant &data)
+{
+    if(row <= 0 || col <= 0) return false;
+    ExcelAddress::Ref ref;
+    ref.col = col - 1;
+    ref.row = row - 1;
+    ref.flags = 0;
+    char buf[ExcelAddress::MaxCellLength];
+    ExcelAddress::formatCell(ref, buf);
+
+    QVariantList rows;
+    if(!readRange(QString::fromLatin1(buf), &rows)) return false;
+    data = rows.isEmpty() ? QVariant() : rows[0].toList().value(0);
+    return true;
+}
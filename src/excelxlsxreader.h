@@ -0,0 +1,107 @@
+/**
+ * @file:excelxlsxreader.h   -
+ * @description: Reader of xlsx files without Excel. Sheet xml is inflated
+ *               from zip and parsed while streaming.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#ifndef EXCELXLSXREADER_H
+#define EXCELXLSXREADER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+#include <QList>
+#include <QHash>
+#include <QRect>
+#include <QFile>
+
+class QXmlStreamReader;
+
+/* Zip entries are read through own inflate with 32k window, xml is fed to
+   QXmlStreamReader in chunks. Rows before range are skipped, parsing stops
+   after last row of range. Shared strings are read after sheet, only the
+   ones used by range, and kept for next reads.
+   Values are like Excel::readRange: rows of columns, numbers are double,
+   texts QString, booleans bool, empty and error cells invalid. Cells with
+   date number format are QDateTime (readRange drops VT_DATE), one cell is
+   returned as one row of one value. */
+class ExcelXlsxReader
+{
+public:
+    explicit ExcelXlsxReader(const QString &filename = QString());
+    ~ExcelXlsxReader();
+
+    QString fileName() const {return m_filename;}
+    // reads zip directory, sheet list and number formats
+    bool open();
+    bool isOpen() const {return m_opened;}
+    void close();
+    QString errorString() const {return m_error;}
+
+    QStringList sheetsList() const;
+    int sheetsCount() const {return m_sheets.count();}
+    bool setCurrentSheet(const QString &sheetname);
+    QString currentSheet() const;
+
+    /* range of current sheet "A1:C10", sheet-qualified "Data!A1:C10" or
+       whole columns and rows, these are limited to used range. First area
+       of multi-area range is read */
+    bool readRange(const QString &range, QVariantList *presult);
+    bool read(qint32 row, qint32 col, QVariant &data);
+    // dimension of sheet, from sheet header or by scanning cells
+    QString usedRange(const QString &sheetname = QString());
+
+    // statistics of last read, xml bytes and inflated megabytes per second
+    qint64 xmlBytes() const {return m_xmlBytes;}
+    double megabytesPerSecond() const;
+
+private:
+    class EntryStream;
+
+    struct Entry{
+        quint16 method;     // 0 stored, 8 deflate
+        quint32 compressedSize;
+        quint32 size;
+        quint32 offset;     // of local header
+    };
+
+    struct Sheet{
+        QString name;
+        QString path;       // zip entry
+    };
+
+    bool readDirectory();
+    bool readWorkbook();
+    bool readStyles();
+    bool resolveStrings(const QHash<int, QList<int> > &pending, QVector<QVariant> *pcells);
+    bool parseSheet(const Sheet &sheet, const QRect &rect, QVector<QVariant> *pcells, QHash<int, QList<int> > *ppending);
+    bool scanDimension(const Sheet &sheet, QRect *prect);
+    /* next xml token, entry is inflated into reader as needed. False at end
+       of document and on error, error text is set then */
+    bool nextToken(EntryStream *pstream, QXmlStreamReader *preader);
+    QVariant numberValue(const QString &text, int style) const;
+    static bool isDateFormat(int id, const QString &code);
+    int sheetIndex(const QString &sheetname) const;
+    bool fail(const QString &text);
+
+    QString m_filename;
+    bool m_opened;
+    QString m_error;
+    QFile m_file;
+    QHash<QString, Entry> m_entries;
+    QList<Sheet> m_sheets;
+    int m_current;
+    QString m_stringsPath;
+    QString m_stylesPath;
+    QVector<bool> m_dateStyles;    // cell format -> date
+    QHash<int, QString> m_strings; // resolved shared strings
+
+    qint64 m_xmlBytes;
+    qint64 m_time;      // nsec
+};
+
+#endif // EXCELXLSXREADER_H
@@ -0,0 +1,883 @@
+/**
+ * @file:excelxlsxwriter.cpp   -
+ * @description: Writer of xlsx files without Excel.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#include "excelxlsxwriter.h"
+#include "exceladdress.h"
+#include <QFile>
+#include <QTemporaryFile>
+#include <QDir>
+#include <QDateTime>
+
+
+static const char *xmlHeader = "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n";
+static const char *mainNs = "http://schemas.openxmlformats.org/spreadsheetml/2006/main";
+static const char *relNs = "http://schemas.openxmlformats.org/officeDocument/2006/relationships";
+
+static void put16(QByteArray *pout, quint16 value)
+{
+    pout->append(char(value & 0xFF));
+    pout->append(char(value >> 8));
+}
+
+static void put32(QByteArray *pout, quint32 value)
+{
+    put16(pout, value & 0xFFFF);
+    put16(pout, value >> 16);
+}
+
+static QByteArray rgbText(const QColor &color)
+{
+    return QByteArray("FF") + QByteArray::number(color.rgb() & 0xFFFFFF, 16).rightJustified(6, '0').toUpper();
+}
+
+
+void ExcelXlsxWriter::Style::merge(const Style &other)
+{
+    if(other.hasFont()) setFont(other.font());
+    if(other.hasBackground()) setBackground(other.background());
+    if(other.hasForeground()) setForeground(other.foreground());
+    if(other.hasNumberFormat()) setNumberFormat(other.numberFormat());
+    for(int i=0; i<4; i++)
+        if(other.m_borders[i] != LineNone) m_borders[i] = other.m_borders[i];
+}
+
+bool ExcelXlsxWriter::Style::hasBorders() const
+{
+    for(int i=0; i<4; i++)
+        if(m_borders[i] != LineNone) return true;
+    return false;
+}
+
+bool ExcelXlsxWriter::Style::operator==(const Style &other) const
+{
+    for(int i=0; i<4; i++)
+        if(m_borders[i] != other.m_borders[i]) return false;
+    return m_flags == other.m_flags
+            && (!hasFont() || m_font.key() == other.m_font.key())
+            && (!hasBackground() || m_background == other.m_background)
+            && (!hasForeground() || m_foreground == other.m_foreground)
+            && (!hasNumberFormat() || m_numberFormat == other.m_numberFormat);
+}
+
+uint ExcelXlsxWriter::Style::hash() const
+{
+    uint h = m_flags;
+    if(hasFont()) h = h*31 + qHash(m_font.key());
+    if(hasBackground()) h = h*31 + m_background.rgba();
+    if(hasForeground()) h = h*31 + m_foreground.rgba();
+    if(hasNumberFormat()) h = h*31 + m_numberFormat;
+    for(int i=0; i<4; i++) h = h*7 + m_borders[i];
+    return h;
+}
+
+
+ExcelXlsxWriter::ExcelXlsxWriter(const QString &filename)
+{
+    m_filename = filename;
+    m_opened = false;
+    m_current = -1;
+    m_rowWindow = 1024;
+    m_dosTime = 0;
+    m_dosDate = 0;
+    m_cellsWritten = 0;
+    m_lateWrites = 0;
+    m_time = 0;
+}
+
+ExcelXlsxWriter::~ExcelXlsxWriter()
+{
+    close();
+}
+
+bool ExcelXlsxWriter::open()
+{
+    if(m_opened) return true;
+    m_styles.clear();
+    m_styleIndex.clear();
+    m_strings.clear();
+    m_stringIndex.clear();
+    // style 0 is default of cells without style
+    styleIndex(Style());
+    m_cellsWritten = 0;
+    m_lateWrites = 0;
+    m_time = 0;
+    m_opened = true;
+    return true;
+}
+
+void ExcelXlsxWriter::close()
+{
+    for(int i=0; i<m_sheets.count(); i++)
+        delete m_sheets[i].pfile;
+    m_sheets.clear();
+    m_current = -1;
+    m_opened = false;
+}
+
+bool ExcelXlsxWriter::addSheet(const QString &sheetname)
+{
+    if(!m_opened || sheetname.isEmpty() || sheetname.size() > 31) return false;
+    const QString invalid("[]:*?/\\");
+    for(int i=0; i<sheetname.size(); i++)
+        if(invalid.contains(sheetname[i])) return false;
+    if(sheetsList().contains(sheetname, Qt::CaseInsensitive)) return false;
+
+    Sheet sheet;
+    sheet.name = sheetname;
+    sheet.pfile = new QTemporaryFile(QDir::temp().filePath("AxXlsx_XXXXXX.xml"));
+    if(!sheet.pfile->open())
+    {
+        delete sheet.pfile;
+        return false;
+    }
+    QByteArray head(xmlHeader);
+    head += QByteArray("<worksheet xmlns=\"") + mainNs + "\" xmlns:r=\"" + relNs + "\"><sheetData>";
+    sheet.pfile->write(head);
+
+    m_sheets.append(sheet);
+    m_current = m_sheets.count() - 1;
+    return true;
+}
+
+bool ExcelXlsxWriter::setCurrentSheet(const QString &sheetname)
+{
+    for(int i=0; i<m_sheets.count(); i++)
+    {
+        if(m_sheets[i].name.compare(sheetname, Qt::CaseInsensitive) == 0)
+        {
+            m_current = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+QString ExcelXlsxWriter::currentSheet() const
+{
+    return m_current >= 0 ? m_sheets[m_current].name : QString();
+}
+
+QStringList ExcelXlsxWriter::sheetsList() const
+{
+    QStringList result;
+    foreach(const Sheet &sheet, m_sheets)
+        result += sheet.name;
+    return result;
+}
+
+double ExcelXlsxWriter::cellsPerSecond() const
+{
+    if(m_time == 0) return 0;
+    return 1e9*m_cellsWritten/m_time;
+}
+
+// workbook needs one sheet at least, it is added on first use
+ExcelXlsxWriter::Sheet *ExcelXlsxWriter::sheet()
+{
+    if(m_current < 0 && !addSheet("Sheet1")) return 0;
+    return &m_sheets[m_current];
+}
+
+ExcelXlsxWriter::CellData *ExcelXlsxWriter::cell(int x, int y)
+{
+    Sheet *psheet = sheet();
+    if(psheet == 0) return 0;
+    if(y < psheet->flushedRows)
+    {
+        m_lateWrites++;
+        return 0;
+    }
+    psheet->lastRow = qMax(psheet->lastRow, y);
+    return &psheet->rows[y][x];
+}
+
+// rect is inside sheet and its rows are not written yet
+bool ExcelXlsxWriter::checkRect(const QRect &rect)
+{
+    if(!m_opened || rect.width() <= 0 || rect.height() <= 0 || rect.x() < 0 || rect.y() < 0
+            || rect.x() + rect.width() > ExcelAddress::MaxColumns
+            || rect.y() + rect.height() > ExcelAddress::MaxRows) return false;
+    Sheet *psheet = sheet();
+    if(psheet == 0) return false;
+    if(rect.y() < psheet->flushedRows)
+    {
+        m_lateWrites += qint64(rect.width())*rect.height();
+        return false;
+    }
+    return true;
+}
+
+void ExcelXlsxWriter::trimRows(Sheet *psheet)
+{
+    const int below = psheet->lastRow - m_rowWindow + 1;
+    if(below > psheet->flushedRows) flushRows(psheet, below);
+}
+
+bool ExcelXlsxWriter::write(qint32 row, qint32 col, const QVariant &data)
+{
+    if(!m_opened || row <= 0 || col <= 0 || row > ExcelAddress::MaxRows || col > ExcelAddress::MaxColumns)
+        return false;
+    QElapsedTimer timer;
+    timer.start();
+    CellData *pcell = cell(col - 1, row - 1);
+    if(pcell == 0) return false;
+
+    pcell->value = data;
+    if(data.type() == QVariant::Date || data.type() == QVariant::DateTime)
+    {
+        Style style = m_styles[pcell->style];
+        style.setNumberFormat(data.type() == QVariant::Date ? 14 : 22);
+        pcell->style = styleIndex(style);
+    }
+    m_cellsWritten++;
+    trimRows(sheet());
+    m_time += timer.nsecsElapsed();
+    return true;
+}
+
+/****************************************************************************
+ * @function name: ExcelXlsxWriter::writeBlock()
+ * @param:
+ *      const QRect &rect - 0-based cells
+ *      const QVariantList &data - row-major values, missing are empty
+ * @description: rows of block leaving row window are written to sheet file
+ *               while block is stored
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool ExcelXlsxWriter::writeBlock(const QRect &rect, const QVariantList &data)
+{
+    if(!checkRect(rect)) return false;
+    QElapsedTimer timer;
+    timer.start();
+    Sheet *psheet = sheet();
+    int i = 0;
+    for(int y=rect.y(); y<rect.y()+rect.height(); y++)
+    {
+        Row &row = psheet->rows[y];
+        for(int x=rect.x(); x<rect.x()+rect.width(); x++, i++)
+        {
+            CellData &cell = row[x];
+            cell.value = i < data.count() ? data[i] : QVariant();
+            const QVariant::Type type = cell.value.type();
+            if(type == QVariant::Date || type == QVariant::DateTime)
+            {
+                Style style = m_styles[cell.style];
+                style.setNumberFormat(type == QVariant::Date ? 14 : 22);
+                cell.style = styleIndex(style);
+            }
+        }
+        psheet->lastRow = qMax(psheet->lastRow, y);
+        trimRows(psheet);
+    }
+    m_cellsWritten += qint64(rect.width())*rect.height();
+    m_time += timer.nsecsElapsed();
+    return true;
+}
+
+// style is merged into present style of every cell, equal results share one index
+bool ExcelXlsxWriter::applyStyle(const QRect &rect, const Style &style)
+{
+    if(!checkRect(rect)) return false;
+    Sheet *psheet = sheet();
+    QHash<int, int> merged; // present style -> merged style
+    for(int y=rect.y(); y<rect.y()+rect.height(); y++)
+    {
+        Row &row = psheet->rows[y];
+        for(int x=rect.x(); x<rect.x()+rect.width(); x++)
+        {
+            CellData &cell = row[x];
+            QHash<int, int>::const_iterator it = merged.constFind(cell.style);
+            if(it == merged.constEnd())
+            {
+                Style next = m_styles[cell.style];
+                next.merge(style);
+                it = merged.insert(cell.style, styleIndex(next));
+            }
+            cell.style = it.value();
+        }
+    }
+    // styles keep row window in place, tall frame or colour over a table
+    // drawn before its data must not flush the rows to be filled
+    return true;
+}
+
+bool ExcelXlsxWriter::setColor(const QRect &rect, const QColor &background, const QColor &foreground)
+{
+    Style style;
+    style.setBackground(background);
+    style.setForeground(foreground);
+    return applyStyle(rect, style);
+}
+
+bool ExcelXlsxWriter::setFont(const QRect &rect, const QFont &font)
+{
+    Style style;
+    style.setFont(font);
+    return applyStyle(rect, style);
+}
+
+bool ExcelXlsxWriter::setBorders(const QRect &rect, const int outer[4], int horizontal, int vertical)
+{
+    if(!checkRect(rect)) return false;
+    const int x1 = rect.x() + rect.width() - 1;
+    const int y1 = rect.y() + rect.height() - 1;
+    bool result = true;
+
+    // each cell line is stored once, inner lines as bottom and right sides
+    for(int y=rect.y(); y<=y1; y++)
+    {
+        Style left, right, middle;
+        left.setBorder(Left, outer[Left]);
+        right.setBorder(Right, outer[Right]);
+        if(y == rect.y())
+        {
+            left.setBorder(Top, outer[Top]);
+            right.setBorder(Top, outer[Top]);
+            middle.setBorder(Top, outer[Top]);
+        }
+        const int bottom = y == y1 ? outer[Bottom] : horizontal;
+        left.setBorder(Bottom, bottom);
+        right.setBorder(Bottom, bottom);
+        middle.setBorder(Bottom, bottom);
+        if(rect.width() > 1)
+        {
+            left.setBorder(Right, vertical);
+            middle.setBorder(Right, vertical);
+        }
+        else left.setBorder(Right, outer[Right]);
+
+        result &= applyStyle(QRect(rect.x(), y, 1, 1), left);
+        if(rect.width() > 2) result &= applyStyle(QRect(rect.x() + 1, y, rect.width() - 2, 1), middle);
+        if(rect.width() > 1) result &= applyStyle(QRect(x1, y, 1, 1), right);
+    }
+    return result;
+}
+
+bool ExcelXlsxWriter::mergeCells(const QRect &rect)
+{
+    if(!m_opened || rect.width() <= 0 || rect.height() <= 0) return false;
+    Sheet *psheet = sheet();
+    if(psheet == 0) return false;
+    ExcelAddress::Area area;
+    area.first.col = rect.x();
+    area.first.row = rect.y();
+    area.first.flags = 0;
+    area.last.col = rect.x() + rect.width() - 1;
+    area.last.row = rect.y() + rect.height() - 1;
+    area.last.flags = 0;
+    area.type = ExcelAddress::Cells;
+    area.sheetBegin = -1;
+    area.sheetLength = 0;
+    char buf[ExcelAddress::MaxAreaLength];
+    if(ExcelAddress::formatArea(area, buf) <= 0) return false;
+    psheet->merges.append(QString::fromLatin1(buf));
+    return true;
+}
+
+int ExcelXlsxWriter::styleIndex(const Style &style)
+{
+    QHash<Style, int>::const_iterator it = m_styleIndex.constFind(style);
+    if(it != m_styleIndex.constEnd()) return it.value();
+    m_styles.append(style);
+    m_styleIndex.insert(style, m_styles.count() - 1);
+    return m_styles.count() - 1;
+}
+
+int ExcelXlsxWriter::stringIndex(const QString &text)
+{
+    QHash<QString, int>::const_iterator it = m_stringIndex.constFind(text);
+    if(it != m_stringIndex.constEnd()) return it.value();
+    m_strings.append(text);
+    m_stringIndex.insert(text, m_strings.count() - 1);
+    return m_strings.count() - 1;
+}
+
+// text is escaped for xml, characters not allowed in xml 1.0 are dropped
+void ExcelXlsxWriter::appendEscaped(QByteArray *pout, const QString &text)
+{
+    QString escaped;
+    escaped.reserve(text.size());
+    for(int i=0; i<text.size(); i++)
+    {
+        const ushort c = text[i].unicode();
+        switch(c)
+        {
+        case '&': escaped += "&amp;"; break;
+        case '<': escaped += "&lt;"; break;
+        case '>': escaped += "&gt;"; break;
+        case '"': escaped += "&quot;"; break;
+        default:
+            if((c < 0x20 && c != '\t' && c != '\n' && c != '\r') || c == 0xFFFE || c == 0xFFFF) break;
+            escaped += text[i];
+        }
+    }
+    pout->append(escaped.toUtf8());
+}
+
+/****************************************************************************
+ * @function name: ExcelXlsxWriter::flushRows()
+ * @param:
+ *      Sheet *psheet
+ *      int below - 0-based row, pending rows above it are written
+ * @description: rows are appended to sheet file as SpreadsheetML and freed
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool ExcelXlsxWriter::flushRows(Sheet *psheet, int below)
+{
+    QByteArray xml;
+    char ref[ExcelAddress::MaxCellLength];
+    bool result = true;
+
+    QMap<int, Row>::iterator it = psheet->rows.begin();
+    while(it != psheet->rows.end() && it.key() < below)
+    {
+        xml.clear();
+        xml += "<row r=\"" + QByteArray::number(it.key() + 1) + "\">";
+        for(Row::const_iterator c = it.value().constBegin(); c != it.value().constEnd(); ++c)
+        {
+            const CellData &cell = c.value();
+            const QVariant &value = cell.value;
+            QVariant::Type type = value.type();
+            // empty string clears cell like in Excel
+            if(type == QVariant::String && value.toString().isEmpty()) type = QVariant::Invalid;
+            if(type == QVariant::Invalid && cell.style == 0) continue;
+
+            ExcelAddress::Ref cell_ref;
+            cell_ref.col = c.key();
+            cell_ref.row = it.key();
+            cell_ref.flags = 0;
+            ExcelAddress::formatCell(cell_ref, ref);
+            xml += "<c r=\"";
+            xml += ref;
+            xml += '"';
+            if(cell.style) xml += " s=\"" + QByteArray::number(cell.style) + '"';
+
+            switch(type)
+            {
+            case QVariant::Invalid:
+                xml += "/>";
+                break;
+            case QVariant::Bool:
+                xml += " t=\"b\"><v>";
+                xml += value.toBool() ? '1' : '0';
+                xml += "</v></c>";
+                break;
+            case QVariant::Int:
+            case QVariant::UInt:
+            case QVariant::LongLong:
+            case QVariant::ULongLong:
+            case QVariant::Double:
+            {
+                const double number = value.toDouble();
+                if(qIsFinite(number))
+                {
+                    xml += "><v>" + QByteArray::number(number, 'g', 17) + "</v></c>";
+                    break;
+                }
+                xml += " t=\"e\"><v>#NUM!</v></c>";
+                break;
+            }
+            case QVariant::Date:
+            case QVariant::DateTime:
+            {
+                // serial days since 1899-12-30, fraction is time of day
+                const QDateTime dt = value.toDateTime();
+                const double serial = QDate(1899, 12, 30).daysTo(dt.date())
+                        + QTime(0, 0).msecsTo(dt.time())/86400000.0;
+                xml += "><v>" + QByteArray::number(serial, 'g', 17) + "</v></c>";
+                break;
+            }
+            default:
+                xml += " t=\"s\"><v>" + QByteArray::number(stringIndex(value.toString())) + "</v></c>";
+                break;
+            }
+        }
+        xml += "</row>";
+        result &= psheet->pfile->write(xml) == xml.size();
+        it = psheet->rows.erase(it);
+    }
+    psheet->flushedRows = qMax(psheet->flushedRows, qMin(below, psheet->lastRow + 1));
+    return result;
+}
+
+bool ExcelXlsxWriter::save()
+{
+    return saveAs(m_filename);
+}
+
+/****************************************************************************
+ * @function name: ExcelXlsxWriter::saveAs()
+ * @param:
+ *      const QString &filename
+ * @description: pending rows of all sheets are written, parts are stored in
+ *               zip, sheet files are copied in chunks
+ * @return: ( bool ) success = true
+ ****************************************************************************/
+bool ExcelXlsxWriter::saveAs(const QString &filename)
+{
+    if(!m_opened || filename.isEmpty()) return false;
+    QElapsedTimer timer;
+    timer.start();
+    if(sheet() == 0) return false;
+    m_filename = filename;
+
+    bool result = true;
+    for(int i=0; i<m_sheets.count(); i++)
+        result &= flushRows(&m_sheets[i], ExcelAddress::MaxRows);
+
+    QFile zip(filename);
+    if(!zip.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+    const QDateTime now = QDateTime::currentDateTime();
+    m_dosTime = quint16((now.time().hour() << 11) | (now.time().minute() << 5) | (now.time().second()/2));
+    m_dosDate = quint16(((qMax(1980, now.date().year()) - 1980) << 9) | (now.date().month() << 5) | now.date().day());
+    m_entries.clear();
+
+    QByteArray rels(xmlHeader);
+    rels += "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+            "<Relationship Id=\"rId1\" Type=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships/officeDocument\""
+            " Target=\"xl/workbook.xml\"/></Relationships>";
+
+    result &= writePart(&zip, "[Content_Types].xml", contentTypesXml());
+    result &= writePart(&zip, "_rels/.rels", rels);
+    result &= writePart(&zip, "xl/workbook.xml", workbookXml());
+    result &= writePart(&zip, "xl/_rels/workbook.xml.rels", workbookRelsXml());
+    result &= writePart(&zip, "xl/styles.xml", stylesXml());
+    for(int i=0; i<m_sheets.count() && result; i++)
+        result &= writeSheetPart(&zip, QString("xl/worksheets/sheet%1.xml").arg(i + 1), &m_sheets[i]);
+    // strings are complete after sheets
+    result &= writePart(&zip, "xl/sharedStrings.xml", sharedStringsXml());
+    result &= writeCentralDirectory(&zip);
+
+    // no zip64, sizes and offsets are 32 bit
+    if(zip.size() > Q_INT64_C(0xFFFFFFFF)) result = false;
+    zip.close();
+    if(!result) zip.remove();
+    m_time += timer.nsecsElapsed();
+    return result;
+}
+
+// local header with zero crc and sizes, patched by endEntry()
+bool ExcelXlsxWriter::beginEntry(QFile *pzip, const QString &name, qint64 *pheader)
+{
+    Entry entry;
+    entry.name = name.toUtf8();
+    entry.crc = 0;
+    entry.size = 0;
+    entry.offset = quint32(pzip->pos());
+    *pheader = pzip->pos();
+
+    QByteArray head;
+    put32(&head, 0x04034b50);
+    put16(&head, 20);           // version needed
+    put16(&head, 0x0800);       // utf-8 names
+    put16(&head, 0);            // stored
+    put16(&head, m_dosTime);
+    put16(&head, m_dosDate);
+    put32(&head, 0);            // crc
+    put32(&head, 0);            // compressed size
+    put32(&head, 0);            // size
+    put16(&head, entry.name.size());
+    put16(&head, 0);            // extra
+    head += entry.name;
+
+    m_entries.append(entry);
+    return pzip->write(head) == head.size();
+}
+
+bool ExcelXlsxWriter::endEntry(QFile *pzip, qint64 header, quint32 crc, qint64 size)
+{
+    if(size > Q_INT64_C(0xFFFFFFFF)) return false;
+    m_entries.last().crc = crc;
+    m_entries.last().size = quint32(size);
+
+    QByteArray sizes;
+    put32(&sizes, crc);
+    put32(&sizes, quint32(size));
+    put32(&sizes, quint32(size));
+    const qint64 end = pzip->pos();
+    bool result = pzip->seek(header + 14) && pzip->write(sizes) == sizes.size();
+    return pzip->seek(end) && result;
+}
+
+bool ExcelXlsxWriter::writePart(QFile *pzip, const QString &name, const QByteArray &data)
+{
+    qint64 header;
+    if(!beginEntry(pzip, name, &header)) return false;
+    if(pzip->write(data) != data.size()) return false;
+    return endEntry(pzip, header, crc32(0, data.constData(), data.size()), data.size());
+}
+
+bool ExcelXlsxWriter::writeSheetPart(QFile *pzip, const QString &name, Sheet *psheet)
+{
+    qint64 header;
+    if(!beginEntry(pzip, name, &header)) return false;
+
+    QByteArray tail("</sheetData>");
+    if(!psheet->merges.isEmpty())
+    {
+        tail += "<mergeCells count=\"" + QByteArray::number(psheet->merges.count()) + "\">";
+        foreach(const QString &merge, psheet->merges)
+            tail += "<mergeCell ref=\"" + merge.toLatin1() + "\"/>";
+        tail += "</mergeCells>";
+    }
+    tail += "</worksheet>";
+
+    // sheet file stays open for rows written later
+    quint32 crc = 0;
+    qint64 size = 0;
+    QFile *pfile = psheet->pfile;
+    const qint64 end = pfile->pos();
+    if(!pfile->flush() || !pfile->seek(0)) return false;
+    QByteArray chunk;
+    while(size < end)
+    {
+        chunk = pfile->read(qMin(end - size, Q_INT64_C(1) << 20));
+        if(chunk.isEmpty() || pzip->write(chunk) != chunk.size()) return false;
+        crc = crc32(crc, chunk.constData(), chunk.size());
+        size += chunk.size();
+    }
+    if(!pfile->seek(end)) return false;
+
+    if(pzip->write(tail) != tail.size()) return false;
+    crc = crc32(crc, tail.constData(), tail.size());
+    return endEntry(pzip, header, crc, size + tail.size());
+}
+
+bool ExcelXlsxWriter::writeCentralDirectory(QFile *pzip)
+{
+    const qint64 start = pzip->pos();
+    QByteArray dir;
+    foreach(const Entry &entry, m_entries)
+    {
+        put32(&dir, 0x02014b50);
+        put16(&dir, 20);        // version made by
+        put16(&dir, 20);        // version needed
+        put16(&dir, 0x0800);
+        put16(&dir, 0);
+        put16(&dir, m_dosTime);
+        put16(&dir, m_dosDate);
+        put32(&dir, entry.crc);
+        put32(&dir, entry.size);
+        put32(&dir, entry.size);
+        put16(&dir, entry.name.size());
+        put16(&dir, 0);         // extra
+        put16(&dir, 0);         // comment
+        put16(&dir, 0);         // disk
+        put16(&dir, 0);         // internal attributes
+        put32(&dir, 0);         // external attributes
+        put32(&dir, entry.offset);
+        dir += entry.name;
+    }
+    const quint32 dir_size = quint32(dir.size());
+    put32(&dir, 0x06054b50);
+    put16(&dir, 0);
+    put16(&dir, 0);
+    put16(&dir, m_entries.count());
+    put16(&dir, m_entries.count());
+    put32(&dir, dir_size);
+    put32(&dir, quint32(start));
+    put16(&dir, 0);
+    return pzip->write(dir) == dir.size();
+}
+
+quint32 ExcelXlsxWriter::crc32(quint32 crc, const char *data, qint64 size)
+{
+    static quint32 table[256];
+    static bool ready = false;
+    if(!ready)
+    {
+        for(quint32 i=0; i<256; i++)
+        {
+            quint32 c = i;
+            for(int k=0; k<8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        ready = true;
+    }
+    crc = ~crc;
+    for(qint64 i=0; i<size; i++)
+        crc = table[(crc ^ uchar(data[i])) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+QByteArray ExcelXlsxWriter::contentTypesXml() const
+{
+    QByteArray xml(xmlHeader);
+    xml += "<Types xmlns=\"http://schemas.openxmlformats.org/package/2006/content-types\">"
+           "<Default Extension=\"rels\" ContentType=\"application/vnd.openxmlformats-package.relationships+xml\"/>"
+           "<Default Extension=\"xml\" ContentType=\"application/xml\"/>"
+           "<Override PartName=\"/xl/workbook.xml\""
+           " ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.sheet.main+xml\"/>";
+    for(int i=0; i<m_sheets.count(); i++)
+        xml += "<Override PartName=\"/xl/worksheets/sheet" + QByteArray::number(i + 1) + ".xml\""
+               " ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.worksheet+xml\"/>";
+    xml += "<Override PartName=\"/xl/styles.xml\""
+           " ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.styles+xml\"/>"
+           "<Override PartName=\"/xl/sharedStrings.xml\""
+           " ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.sharedStrings+xml\"/>"
+           "</Types>";
+    return xml;
+}
+
+QByteArray ExcelXlsxWriter::workbookXml() const
+{
+    QByteArray xml(xmlHeader);
+    xml += QByteArray("<workbook xmlns=\"") + mainNs + "\" xmlns:r=\"" + relNs + "\"><sheets>";
+    for(int i=0; i<m_sheets.count(); i++)
+    {
+        xml += "<sheet name=\"";
+        appendEscaped(&xml, m_sheets[i].name);
+        xml += "\" sheetId=\"" + QByteArray::number(i + 1) + "\" r:id=\"rId" + QByteArray::number(i + 1) + "\"/>";
+    }
+    xml += "</sheets></workbook>";
+    return xml;
+}
+
+QByteArray ExcelXlsxWriter::workbookRelsXml() const
+{
+    const QByteArray type = QByteArray(relNs) + "/";
+    const int count = m_sheets.count();
+    QByteArray xml(xmlHeader);
+    xml += "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">";
+    for(int i=0; i<count; i++)
+        xml += "<Relationship Id=\"rId" + QByteArray::number(i + 1) + "\" Type=\"" + type + "worksheet\""
+               " Target=\"worksheets/sheet" + QByteArray::number(i + 1) + ".xml\"/>";
+    xml += "<Relationship Id=\"rId" + QByteArray::number(count + 1) + "\" Type=\"" + type + "styles\" Target=\"styles.xml\"/>";
+    xml += "<Relationship Id=\"rId" + QByteArray::number(count + 2) + "\" Type=\"" + type + "sharedStrings\""
+           " Target=\"sharedStrings.xml\"/>";
+    xml += "</Relationships>";
+    return xml;
+}
+
+/****************************************************************************
+ * @function name: ExcelXlsxWriter::stylesXml()
+ * @description: fonts, fills and borders of styles are deduplicated by their
+ *               xml, cell format i is style i
+ * @return: ( QByteArray ) styles part
+ ****************************************************************************/
+QByteArray ExcelXlsxWriter::stylesXml() const
+{
+    static const char *lines[] = {"", "hair", "thin", "medium", "thick", "double"};
+    static const char *sides[] = {"left", "right", "top", "bottom"};
+
+    QList<QByteArray> fonts, fills, borders;
+    QHash<QByteArray, int> fontIndex, fillIndex, borderIndex;
+    fonts << "<font><sz val=\"11\"/><name val=\"Calibri\"/><family val=\"2\"/></font>";
+    fills << "<fill><patternFill patternType=\"none\"/></fill>"
+          << "<fill><patternFill patternType=\"gray125\"/></fill>";
+    borders << "<border><left/><right/><top/><bottom/><diagonal/></border>";
+    fontIndex.insert(fonts[0], 0);
+    fillIndex.insert(fills[0], 0);
+    borderIndex.insert(borders[0], 0);
+
+    QByteArray xfs;
+    foreach(const Style &style, m_styles)
+    {
+        int font = 0, fill = 0, border = 0;
+        if(style.hasFont() || style.hasForeground())
+        {
+            QByteArray xml("<font>");
+            QString family("Calibri");
+            double size = 11;
+            if(style.hasFont())
+            {
+                const QFont f = style.font();
+                if(f.bold()) xml += "<b/>";
+                if(f.italic()) xml += "<i/>";
+                if(f.strikeOut()) xml += "<strike/>";
+                if(f.underline()) xml += "<u/>";
+                if(f.pointSizeF() > 0) size = f.pointSizeF();
+                if(!f.family().isEmpty()) family = f.family();
+            }
+            xml += "<sz val=\"" + QByteArray::number(size) + "\"/>";
+            if(style.hasForeground()) xml += "<color rgb=\"" + rgbText(style.foreground()) + "\"/>";
+            xml += "<name val=\"";
+            appendEscaped(&xml, family);
+            xml += "\"/></font>";
+            font = fontIndex.value(xml, -1);
+            if(font < 0)
+            {
+                font = fonts.count();
+                fonts << xml;
+                fontIndex.insert(xml, font);
+            }
+        }
+        if(style.hasBackground())
+        {
+            const QByteArray xml = "<fill><patternFill patternType=\"solid\"><fgColor rgb=\""
+                    + rgbText(style.background()) + "\"/><bgColor indexed=\"64\"/></patternFill></fill>";
+            fill = fillIndex.value(xml, -1);
+            if(fill < 0)
+            {
+                fill = fills.count();
+                fills << xml;
+                fillIndex.insert(xml, fill);
+            }
+        }
+        if(style.hasBorders())
+        {
+            QByteArray xml("<border>");
+            for(int side=0; side<4; side++)
+            {
+                const int line = style.border(side);
+                if(line == LineNone) xml += "<" + QByteArray(sides[side]) + "/>";
+                else xml += "<" + QByteArray(sides[side]) + " style=\"" + lines[line] + "\"><color auto=\"1\"/></"
+                        + sides[side] + ">";
+            }
+            xml += "<diagonal/></border>";
+            border = borderIndex.value(xml, -1);
+            if(border < 0)
+            {
+                border = borders.count();
+                borders << xml;
+                borderIndex.insert(xml, border);
+            }
+        }
+
+        xfs += "<xf numFmtId=\"" + QByteArray::number(style.numberFormat()) + "\" fontId=\"" + QByteArray::number(font)
+                + "\" fillId=\"" + QByteArray::number(fill) + "\" borderId=\"" + QByteArray::number(border) + "\" xfId=\"0\"";
+        if(style.hasNumberFormat()) xfs += " applyNumberFormat=\"1\"";
+        if(font) xfs += " applyFont=\"1\"";
+        if(fill) xfs += " applyFill=\"1\"";
+        if(border) xfs += " applyBorder=\"1\"";
+        xfs += "/>";
+    }
+
+    QByteArray xml(xmlHeader);
+    xml += QByteArray("<styleSheet xmlns=\"") + mainNs + "\">";
+    xml += "<fonts count=\"" + QByteArray::number(fonts.count()) + "\">";
+    foreach(const QByteArray &font, fonts) xml += font;
+    xml += "</fonts><fills count=\"" + QByteArray::number(fills.count()) + "\">";
+    foreach(const QByteArray &fill, fills) xml += fill;
+    xml += "</fills><borders count=\"" + QByteArray::number(borders.count()) + "\">";
+    foreach(const QByteArray &border, borders) xml += border;
+    xml += "</borders>"
+           "<cellStyleXfs count=\"1\"><xf numFmtId=\"0\" fontId=\"0\" fillId=\"0\" borderId=\"0\"/></cellStyleXfs>";
+    xml += "<cellXfs count=\"" + QByteArray::number(m_styles.count()) + "\">" + xfs + "</cellXfs>";
+    xml += "<cellStyles count=\"1\"><cellStyle name=\"Normal\" xfId=\"0\" builtinId=\"0\"/></cellStyles>"
+           "</styleSheet>";
+    return xml;
+}
+
+QByteArray ExcelXlsxWriter::sharedStringsXml() const
+{
+    QByteArray xml(xmlHeader);
+    xml += QByteArray("<sst xmlns=\"") + mainNs + "\" uniqueCount=\"" + QByteArray::number(m_strings.count()) + "\">";
+    foreach(const QString &text, m_strings)
+    {
+        // leading and trailing spaces are kept only with preserve
+        const bool preserve = !text.isEmpty() && (text[0].isSpace() || text[text.size() - 1].isSpace());
+        xml += preserve ? "<si><t xml:space=\"preserve\">" : "<si><t>";
+        appendEscaped(&xml, text);
+        xml += "</t></si>";
+    }
+    xml += "</sst>";
+    return xml;
+}
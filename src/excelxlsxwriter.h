@@ -0,0 +1,216 @@
+/**
+ * @file:excelxlsxwriter.h   -
+ * @description: Writer of xlsx files without Excel. SpreadsheetML parts
+ *               are streamed into zip container with stored entries.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#ifndef EXCELXLSXWRITER_H
+#define EXCELXLSXWRITER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+#include <QList>
+#include <QHash>
+#include <QMap>
+#include <QRect>
+#include <QFont>
+#include <QColor>
+#include <QElapsedTimer>
+
+class QFile;
+class QTemporaryFile;
+
+/* Rows of every sheet are kept in memory until they leave the row window
+   below the last written row, then written to sheet temporary file and
+   freed. Writes to written rows fail. Strings go to one shared string
+   table, styles are deduplicated by content. save() finishes pending rows
+   and builds the zip, writing may continue after it.
+   Cells are 0-based in rects like Excel::Rect, row and col of write() are
+   1-based like Excel::write(). */
+class ExcelXlsxWriter
+{
+public:
+    enum {
+        LineNone,
+        LineHair,
+        LineThin,
+        LineMedium,
+        LineThick,
+        LineDouble
+    };// border style
+
+    enum {
+        Left,
+        Right,
+        Top,
+        Bottom
+    };// side
+
+    class Style
+    {
+    public:
+        enum {
+            HasFont = 1,
+            HasBackground = 2,
+            HasForeground = 4,
+            HasNumberFormat = 8
+        };
+
+        Style() {m_flags = 0; m_numberFormat = 0; for(int i=0; i<4; i++) m_borders[i] = LineNone;}
+
+        void setFont(const QFont &font) {m_font = font; m_flags |= HasFont;}
+        void setBackground(const QColor &color) {m_background = color; m_flags |= HasBackground;}
+        void setForeground(const QColor &color) {m_foreground = color; m_flags |= HasForeground;}
+        // built-in format id, 14 date, 22 date and time
+        void setNumberFormat(int id) {m_numberFormat = id; m_flags |= HasNumberFormat;}
+        void setBorder(int side, int line) {m_borders[side] = line;}
+        // attributes of other override ours
+        void merge(const Style &other);
+
+        bool hasFont() const {return m_flags & HasFont;}
+        bool hasBackground() const {return m_flags & HasBackground;}
+        bool hasForeground() const {return m_flags & HasForeground;}
+        bool hasNumberFormat() const {return m_flags & HasNumberFormat;}
+        bool hasBorders() const;
+        bool isEmpty() const {return m_flags == 0 && !hasBorders();}
+
+        QFont font() const {return m_font;}
+        QColor background() const {return m_background;}
+        QColor foreground() const {return m_foreground;}
+        int numberFormat() const {return m_numberFormat;}
+        int border(int side) const {return m_borders[side];}
+
+        bool operator==(const Style &other) const;
+        bool operator!=(const Style &other) const {return !(*this == other);}
+        uint hash() const;
+
+    private:
+        quint32 m_flags;
+        QFont m_font;
+        QColor m_background;
+        QColor m_foreground;
+        int m_numberFormat;
+        int m_borders[4];
+    };
+
+    explicit ExcelXlsxWriter(const QString &filename = QString());
+    ~ExcelXlsxWriter();
+
+    QString fileName() const {return m_filename;}
+    // empty workbook, first sheet is added by addSheet() or first write
+    bool open();
+    bool isOpen() const {return m_opened;}
+    // pending data are dropped, call save() before
+    void close();
+    bool save();
+    bool saveAs(const QString &filename);
+
+    bool addSheet(const QString &sheetname);
+    bool setCurrentSheet(const QString &sheetname);
+    QString currentSheet() const;
+    QStringList sheetsList() const;
+    int sheetsCount() const {return m_sheets.count();}
+
+    /* rows kept in memory below the last row written with a value, styles
+       do not move the window */
+    void setRowWindow(int rows) {m_rowWindow = qMax(1, rows);}
+    int rowWindow() const {return m_rowWindow;}
+
+    bool write(qint32 row, qint32 col, const QVariant &data);
+    // row-major values, missing are empty
+    bool writeBlock(const QRect &rect, const QVariantList &data);
+    bool applyStyle(const QRect &rect, const Style &style);
+    bool setColor(const QRect &rect, const QColor &background, const QColor &foreground);
+    bool setFont(const QRect &rect, const QFont &font);
+    /* lines of rect: outer sides as Left, Right, Top, Bottom and inner
+       horizontal, vertical lines, LineNone keeps present border */
+    bool setBorders(const QRect &rect, const int outer[4], int horizontal = LineNone, int vertical = LineNone);
+    bool mergeCells(const QRect &rect);
+
+    // statistics
+    qint64 cellsWritten() const {return m_cellsWritten;}
+    qint64 lateWrites() const {return m_lateWrites;}
+    int sharedStrings() const {return m_strings.count();}
+    int stylesCount() const {return m_styles.count();}
+    // cells per second of time spent in writer calls and save
+    double cellsPerSecond() const;
+
+private:
+    struct CellData{
+        CellData() {style = 0;}
+        QVariant value;
+        int style;      // index in m_styles
+    };
+    typedef QMap<int, CellData> Row;   // 0-based column -> cell
+
+    struct Sheet{
+        Sheet() {pfile = 0; flushedRows = 0; lastRow = -1;}
+        QString name;
+        QTemporaryFile *pfile;      // rows written so far
+        QMap<int, Row> rows;        // 0-based row -> pending cells
+        int flushedRows;            // rows below are in file
+        int lastRow;
+        QStringList merges;
+    };
+
+    Sheet *sheet();
+    CellData *cell(int x, int y);
+    bool checkRect(const QRect &rect);
+    void trimRows(Sheet *psheet);
+    bool flushRows(Sheet *psheet, int below);
+    int styleIndex(const Style &style);
+    int stringIndex(const QString &text);
+
+    bool writePart(QFile *pzip, const QString &name, const QByteArray &data);
+    bool writeSheetPart(QFile *pzip, const QString &name, Sheet *psheet);
+    bool beginEntry(QFile *pzip, const QString &name, qint64 *pheader);
+    bool endEntry(QFile *pzip, qint64 header, quint32 crc, qint64 size);
+    bool writeCentralDirectory(QFile *pzip);
+
+    QByteArray contentTypesXml() const;
+    QByteArray workbookXml() const;
+    QByteArray workbookRelsXml() const;
+    QByteArray stylesXml() const;
+    QByteArray sharedStringsXml() const;
+
+    static quint32 crc32(quint32 crc, const char *data, qint64 size);
+    static void appendEscaped(QByteArray *pout, const QString &text);
+
+    struct Entry{
+        QByteArray name;
+        quint32 crc;
+        quint32 size;
+        quint32 offset;
+    };
+
+    QString m_filename;
+    bool m_opened;
+    QList<Sheet> m_sheets;
+    int m_current;
+    int m_rowWindow;
+
+    QHash<QString, int> m_stringIndex;
+    QStringList m_strings;
+    QVector<Style> m_styles;
+    QHash<Style, int> m_styleIndex;
+
+    QList<Entry> m_entries;
+    quint16 m_dosTime;
+    quint16 m_dosDate;
+
+    qint64 m_cellsWritten;
+    qint64 m_lateWrites;
+    qint64 m_time;      // nsec
+};
+
+inline uint qHash(const ExcelXlsxWriter::Style &style)
+{
+    return style.hash();
+}
+
+#endif // EXCELXLSXWRITER_H
@@ -0,0 +1,18 @@
+# address engine is pure QtCore, no ActiveX needed
+QT += testlib
+QT -= gui
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_exceladdress
+TEMPLATE = app
+
+INCLUDEPATH += $$PWD/../../src
+
+HEADERS += \
+    $$PWD/../../src/exceladdress.h
+
+SOURCES += \
+    $$PWD/../../src/exceladdress.cpp \
+    $$PWD/tst_exceladdress.cpp
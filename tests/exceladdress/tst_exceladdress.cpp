@@ -0,0 +1,253 @@
+/**
+ * @file:tst_exceladdress.cpp   -
+ * @description: Round trip of ExcelAddress formatters and parsers over all
+ *               columns of sheet, and timing of them.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#include <QtTest>
+#include <string.h>
+#include "exceladdress.h"
+
+
+// column label computed the plain way, reference for the label table
+static QString referenceLabel(int col)
+{
+    QString label;
+    for(int n = col + 1; n > 0; n = (n - 1)/26)
+        label.prepend(QChar('A' + (n - 1)%26));
+    return label;
+}
+
+class TestExcelAddress : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void columnLabels();
+    void cellRoundTrip();
+    void cellLimits();
+    void r1c1RoundTrip();
+    void areas();
+    void ranges();
+
+    void benchmarkFormatCell();
+    void benchmarkParseCell();
+};
+
+void TestExcelAddress::columnLabels()
+{
+    for(int col=0; col<ExcelAddress::MaxColumns; col++)
+    {
+        const char *label = ExcelAddress::columnLabel(col);
+        QVERIFY(label != 0);
+        const int len = int(strlen(label));
+        QCOMPARE(QString::fromLatin1(label), referenceLabel(col));
+        QCOMPARE(ExcelAddress::columnLabelLength(col), len);
+        QCOMPARE(ExcelAddress::columnIndex(label, len), col);
+        QCOMPARE(ExcelAddress::columnIndex(QByteArray(label).toLower().constData(), len), col);
+    }
+    QVERIFY(ExcelAddress::columnLabel(-1) == 0);
+    QVERIFY(ExcelAddress::columnLabel(ExcelAddress::MaxColumns) == 0);
+    QCOMPARE(QString::fromLatin1(ExcelAddress::columnLabel(ExcelAddress::MaxColumns - 1)), QString("XFD"));
+}
+
+void TestExcelAddress::cellRoundTrip()
+{
+    const int rows[] = {0, 1, 8, 9, 99, 999, 65535, 65536, ExcelAddress::MaxRows - 1};
+    char buf[ExcelAddress::MaxCellLength];
+
+    for(int col=0; col<ExcelAddress::MaxColumns; col++)
+    {
+        for(unsigned int r=0; r<sizeof(rows)/sizeof(rows[0]); r++)
+        {
+            for(int flags=0; flags<4; flags++)
+            {
+                const ExcelAddress::Ref ref = {col, rows[r], flags};
+                const int len = ExcelAddress::formatCell(ref, buf);
+                QVERIFY(len > 0 && len < ExcelAddress::MaxCellLength);
+                QCOMPARE(int(strlen(buf)), len);
+
+                const QString text = QString::fromLatin1(buf, len);
+                QString expected = referenceLabel(col) + QString::number(rows[r] + 1);
+                if(flags & ExcelAddress::AbsoluteRow) expected.insert(referenceLabel(col).size(), '$');
+                if(flags & ExcelAddress::AbsoluteColumn) expected.prepend('$');
+                QCOMPARE(text, expected);
+
+                ExcelAddress::Ref parsed = {-1, -1, -1};
+                QVERIFY(ExcelAddress::parseCell(text.constData(), text.size(), &parsed));
+                QCOMPARE(parsed.col, col);
+                QCOMPARE(parsed.row, rows[r]);
+                QCOMPARE(parsed.flags, flags);
+            }
+        }
+    }
+}
+
+void TestExcelAddress::cellLimits()
+{
+    char buf[ExcelAddress::MaxCellLength];
+    const ExcelAddress::Ref outside_col = {ExcelAddress::MaxColumns, 0, 0};
+    const ExcelAddress::Ref outside_row = {0, ExcelAddress::MaxRows, 0};
+    QCOMPARE(ExcelAddress::formatCell(outside_col, buf), 0);
+    QCOMPARE(ExcelAddress::formatCell(outside_row, buf), 0);
+
+    const char *invalid[] = {"", "A", "1", "A0", "XFE1", "A1048577", "AAAA1", "A1B", "$$A1", "A$$1", "A-1", "A 1"};
+    for(unsigned int i=0; i<sizeof(invalid)/sizeof(invalid[0]); i++)
+    {
+        const QString text = QString::fromLatin1(invalid[i]);
+        ExcelAddress::Ref ref;
+        QVERIFY2(!ExcelAddress::parseCell(text.constData(), text.size(), &ref), invalid[i]);
+    }
+}
+
+void TestExcelAddress::r1c1RoundTrip()
+{
+    char buf[ExcelAddress::MaxR1C1Length];
+    const ExcelAddress::Ref base = {100, 1000, 0};
+
+    for(int col=0; col<ExcelAddress::MaxColumns; col++)
+    {
+        const int rows[] = {0, base.row, ExcelAddress::MaxRows - 1};
+        for(unsigned int r=0; r<sizeof(rows)/sizeof(rows[0]); r++)
+        {
+            for(int flags=0; flags<4; flags++)
+            {
+                const ExcelAddress::Ref ref = {col, rows[r], flags};
+
+                // absolute text without base
+                int len = ExcelAddress::formatR1C1(ref, buf);
+                QVERIFY(len > 0 && len < ExcelAddress::MaxR1C1Length);
+                QString text = QString::fromLatin1(buf, len);
+                ExcelAddress::Ref parsed;
+                QVERIFY(ExcelAddress::parseR1C1(text.constData(), text.size(), &parsed));
+                QCOMPARE(parsed.col, col);
+                QCOMPARE(parsed.row, rows[r]);
+                QCOMPARE(parsed.flags, int(ExcelAddress::AbsoluteColumn | ExcelAddress::AbsoluteRow));
+
+                // relative parts as offsets to base
+                len = ExcelAddress::formatR1C1(ref, buf, &base);
+                QVERIFY(len > 0 && len < ExcelAddress::MaxR1C1Length);
+                text = QString::fromLatin1(buf, len);
+                QVERIFY(ExcelAddress::parseR1C1(text.constData(), text.size(), &parsed, &base));
+                QCOMPARE(parsed.col, col);
+                QCOMPARE(parsed.row, rows[r]);
+                QCOMPARE(parsed.flags, flags);
+            }
+        }
+    }
+
+    const QString same("RC");
+    ExcelAddress::Ref parsed;
+    QVERIFY(ExcelAddress::parseR1C1(same.constData(), same.size(), &parsed, &base));
+    QCOMPARE(parsed.col, base.col);
+    QCOMPARE(parsed.row, base.row);
+    const QString outside("R[-1001]C");
+    QVERIFY(!ExcelAddress::parseR1C1(outside.constData(), outside.size(), &parsed, &base));
+}
+
+void TestExcelAddress::areas()
+{
+    struct Case{
+        const char *text;
+        const char *formatted;
+        int type;
+    };
+    const Case cases[] = {
+        {"A1", "A1", ExcelAddress::Cells},
+        {"A1:A1", "A1", ExcelAddress::Cells},
+        {"B2:A1", "A1:B2", ExcelAddress::Cells},
+        {"$B2:A$1", "A$1:$B2", ExcelAddress::Cells},
+        {"xfd1048576:a1", "A1:XFD1048576", ExcelAddress::Cells},
+        {"C:A", "A:C", ExcelAddress::Columns},
+        {"$A:XFD", "$A:XFD", ExcelAddress::Columns},
+        {"3:1", "1:3", ExcelAddress::Rows},
+        {"$1:$1048576", "$1:$1048576", ExcelAddress::Rows}
+    };
+
+    char buf[ExcelAddress::MaxAreaLength];
+    for(unsigned int i=0; i<sizeof(cases)/sizeof(cases[0]); i++)
+    {
+        const QString text = QString::fromLatin1(cases[i].text);
+        ExcelAddress::Area area;
+        QVERIFY2(ExcelAddress::parseArea(text.constData(), text.size(), &area), cases[i].text);
+        QCOMPARE(int(area.type), cases[i].type);
+        const int len = ExcelAddress::formatArea(area, buf);
+        QCOMPARE(QString::fromLatin1(buf, len), QString::fromLatin1(cases[i].formatted));
+    }
+
+    const char *invalid[] = {"A1:", ":A1", "A1:B2:C3", "A:1", "1:A", "A1:C", "XFE:A"};
+    for(unsigned int i=0; i<sizeof(invalid)/sizeof(invalid[0]); i++)
+    {
+        const QString text = QString::fromLatin1(invalid[i]);
+        ExcelAddress::Area area;
+        QVERIFY2(!ExcelAddress::parseArea(text.constData(), text.size(), &area), invalid[i]);
+    }
+}
+
+void TestExcelAddress::ranges()
+{
+    const QString range("Data!A1:B2,'My ''Sheet'''!C3,D:D");
+    ExcelAddress::Area areas[4];
+    QCOMPARE(ExcelAddress::parseRange(range, areas, 4), 3);
+
+    QCOMPARE(range.mid(areas[0].sheetBegin, areas[0].sheetLength), QString("Data"));
+    QCOMPARE(areas[0].last.col, 1);
+    QCOMPARE(areas[0].last.row, 1);
+    QCOMPARE(range.mid(areas[1].sheetBegin, areas[1].sheetLength), QString("My ''Sheet''"));
+    QCOMPARE(areas[1].first.col, 2);
+    QCOMPARE(areas[1].first.row, 2);
+    QCOMPARE(areas[2].sheetBegin, -1);
+    QCOMPARE(int(areas[2].type), int(ExcelAddress::Columns));
+
+    // count is returned also when output is short
+    QCOMPARE(ExcelAddress::parseRange(range, areas, 1), 3);
+    QVERIFY(ExcelAddress::isValid("A1"));
+    QVERIFY(!ExcelAddress::isValid(""));
+    QVERIFY(!ExcelAddress::isValid("A1,"));
+    QVERIFY(!ExcelAddress::isValid("!A1"));
+    QVERIFY(!ExcelAddress::isValid("'Sheet!A1"));
+    QVERIFY(!ExcelAddress::isValid("''!A1"));
+}
+
+void TestExcelAddress::benchmarkFormatCell()
+{
+    char buf[ExcelAddress::MaxCellLength];
+    int total = 0;
+    QBENCHMARK {
+        for(int col=0; col<ExcelAddress::MaxColumns; col++)
+        {
+            const ExcelAddress::Ref ref = {col, col*64, 0};
+            total += ExcelAddress::formatCell(ref, buf);
+        }
+    }
+    QVERIFY(total > 0);
+}
+
+void TestExcelAddress::benchmarkParseCell()
+{
+    QVector<QString> texts;
+    texts.reserve(ExcelAddress::MaxColumns);
+    char buf[ExcelAddress::MaxCellLength];
+    for(int col=0; col<ExcelAddress::MaxColumns; col++)
+    {
+        const ExcelAddress::Ref ref = {col, col*64, 0};
+        texts.append(QString::fromLatin1(buf, ExcelAddress::formatCell(ref, buf)));
+    }
+
+    int total = 0;
+    QBENCHMARK {
+        foreach(const QString &text, texts)
+        {
+            ExcelAddress::Ref ref;
+            if(ExcelAddress::parseCell(text.constData(), text.size(), &ref)) total += ref.col;
+        }
+    }
+    QVERIFY(total > 0);
+}
+
+QTEST_APPLESS_MAIN(TestExcelAddress)
+
+#include "tst_exceladdress.moc"
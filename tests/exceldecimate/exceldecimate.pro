@@ -0,0 +1,18 @@
+# decimation is pure QtCore, no ActiveX needed
+QT += testlib
+QT -= gui
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_exceldecimate
+TEMPLATE = app
+
+INCLUDEPATH += $$PWD/../../src
+
+HEADERS += \
+    $$PWD/../../src/exceldecimate.h
+
+SOURCES += \
+    $$PWD/../../src/exceldecimate.cpp \
+    $$PWD/tst_exceldecimate.cpp
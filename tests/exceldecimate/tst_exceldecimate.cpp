@@ -0,0 +1,185 @@
+/**
+ * @file:tst_exceldecimate.cpp   -
+ * @description: Correctness of MinMax and LTTB chart decimation, fitting of
+ *               series literals to SERIES formula length, and timing.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#include <QtTest>
+#include <cmath>
+#include "exceldecimate.h"
+
+
+// noisy sine with single spikes, x = 0..count-1
+static void makeSeries(int count, QVector<double> *px, QVector<double> *py)
+{
+    px->resize(count);
+    py->resize(count);
+    for(int i=0; i<count; i++)
+    {
+        (*px)[i] = i;
+        (*py)[i] = std::sin(i*0.001) + ((i*7919)%101)*0.001;
+    }
+    if(count > 10)
+    {
+        (*py)[count/3] = 10;
+        (*py)[2*count/3] = -10;
+    }
+}
+
+// out is a subsequence of (x,y) in original order
+static bool isSubsequence(const QVector<double> &x, const QVector<double> &y
+                          , const QVector<double> &out_x, const QVector<double> &out_y)
+{
+    int j = 0;
+    for(int i=0; i<x.size() && j<out_x.size(); i++)
+    {
+        if(x[i] == out_x[j] && y[i] == out_y[j]) j++;
+    }
+    return j == out_x.size();
+}
+
+class TestExcelDecimate : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void shortSeriesCopied();
+    void minMaxKeepsPeaks();
+    void lttbKeepsEnds();
+    void lttbPicksSpike();
+    void literalLength();
+    void fitsSeriesLiteral();
+
+    void benchmarkMinMax();
+    void benchmarkLttb();
+};
+
+void TestExcelDecimate::shortSeriesCopied()
+{
+    QVector<double> x, y, ox, oy;
+    makeSeries(100, &x, &y);
+    ExcelDecimate::decimate(ExcelDecimate::MinMax, x, y, 100, &ox, &oy);
+    QCOMPARE(ox, x);
+    QCOMPARE(oy, y);
+    ExcelDecimate::decimate(ExcelDecimate::Lttb, x, y, 1000, &ox, &oy);
+    QCOMPARE(ox, x);
+    QCOMPARE(oy, y);
+
+    // count of points is min of sizes
+    y.resize(50);
+    ExcelDecimate::decimate(ExcelDecimate::None, x, y, 10, &ox, &oy);
+    QCOMPARE(ox.size(), 50);
+    QCOMPARE(oy, y);
+}
+
+void TestExcelDecimate::minMaxKeepsPeaks()
+{
+    QVector<double> x, y, ox, oy;
+    makeSeries(100000, &x, &y);
+    ExcelDecimate::minMax(x, y, 1000, &ox, &oy);
+
+    QVERIFY(ox.size() <= 1000);
+    QVERIFY(ox.size() >= 500);
+    QCOMPARE(ox.size(), oy.size());
+    QVERIFY(isSubsequence(x, y, ox, oy));
+
+    double vmin = oy[0], vmax = oy[0];
+    foreach(double v, oy)
+    {
+        vmin = qMin(vmin, v);
+        vmax = qMax(vmax, v);
+    }
+    QCOMPARE(vmax, 10.0);
+    QCOMPARE(vmin, -10.0);
+}
+
+void TestExcelDecimate::lttbKeepsEnds()
+{
+    QVector<double> x, y, ox, oy;
+    makeSeries(100000, &x, &y);
+    ExcelDecimate::lttb(x, y, 1000, &ox, &oy);
+
+    QCOMPARE(ox.size(), 1000);
+    QCOMPARE(oy.size(), 1000);
+    QCOMPARE(ox.first(), x.first());
+    QCOMPARE(oy.first(), y.first());
+    QCOMPARE(ox.last(), x.last());
+    QCOMPARE(oy.last(), y.last());
+    QVERIFY(isSubsequence(x, y, ox, oy));
+    for(int i=1; i<ox.size(); i++) QVERIFY(ox[i] > ox[i-1]);
+}
+
+void TestExcelDecimate::lttbPicksSpike()
+{
+    // flat line with one spike, every bucket but the spike's is flat
+    QVector<double> x(1000), y(1000, 0.0), ox, oy;
+    for(int i=0; i<x.size(); i++) x[i] = i;
+    y[517] = 5;
+    ExcelDecimate::lttb(x, y, 20, &ox, &oy);
+    QCOMPARE(ox.size(), 20);
+    QVERIFY(ox.contains(517));
+    QVERIFY(oy.contains(5));
+}
+
+void TestExcelDecimate::literalLength()
+{
+    QCOMPARE(ExcelDecimate::literalLength(QVector<double>()), 2);
+    QVector<double> v;
+    v << 1 << 2.5 << -0.125;
+    QCOMPARE(ExcelDecimate::literalLength(v), int(QString("{1,2.5,-0.125}").size()));
+    v.clear();
+    v << 1.0/3;
+    QCOMPARE(ExcelDecimate::literalLength(v), int(QString("{0.333333333333333}").size()));
+}
+
+void TestExcelDecimate::fitsSeriesLiteral()
+{
+    // full precision values take about 17 characters each
+    QVector<double> x, y, ox, oy;
+    makeSeries(100000, &x, &y);
+    for(int i=0; i<x.size(); i++) x[i] = i/3.0;
+
+    const ExcelDecimate::Mode modes[] = {ExcelDecimate::MinMax, ExcelDecimate::Lttb};
+    for(int k=0; k<2; k++)
+    {
+        ExcelDecimate::decimateToLength(modes[k], x, y, 1000, ExcelDecimate::MaxSeriesLiteral, &ox, &oy);
+        QVERIFY(ox.size() < 1000);
+        QVERIFY(ox.size() > 100);
+        QVERIFY(ExcelDecimate::literalLength(ox) + ExcelDecimate::literalLength(oy)
+                <= ExcelDecimate::MaxSeriesLiteral);
+        QVERIFY(isSubsequence(x, y, ox, oy));
+    }
+
+    // short values keep max_points
+    QVector<double> ix(100000), iy(100000);
+    for(int i=0; i<ix.size(); i++) {ix[i] = i%10; iy[i] = i%7;}
+    ExcelDecimate::decimateToLength(ExcelDecimate::MinMax, ix, iy, 1000, ExcelDecimate::MaxSeriesLiteral, &ox, &oy);
+    QVERIFY(ox.size() > 900);
+}
+
+void TestExcelDecimate::benchmarkMinMax()
+{
+    QVector<double> x, y, ox, oy;
+    makeSeries(1000000, &x, &y);
+    QBENCHMARK {
+        ExcelDecimate::minMax(x, y, 1000, &ox, &oy);
+    }
+    QVERIFY(!ox.isEmpty());
+}
+
+void TestExcelDecimate::benchmarkLttb()
+{
+    QVector<double> x, y, ox, oy;
+    makeSeries(1000000, &x, &y);
+    QBENCHMARK {
+        ExcelDecimate::lttb(x, y, 1000, &ox, &oy);
+    }
+    QCOMPARE(ox.size(), 1000);
+}
+
+QTEST_APPLESS_MAIN(TestExcelDecimate)
+
+#include "tst_exceldecimate.moc"
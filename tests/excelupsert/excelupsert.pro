@@ -0,0 +1,18 @@
+# upsert plan is pure QtCore, no ActiveX needed
+QT += testlib
+QT -= gui
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_excelupsert
+TEMPLATE = app
+
+INCLUDEPATH += $$PWD/../../src
+
+HEADERS += \
+    $$PWD/../../src/excelupsert.h
+
+SOURCES += \
+    $$PWD/../../src/excelupsert.cpp \
+    $$PWD/tst_excelupsert.cpp
@@ -0,0 +1,299 @@
+/**
+ * @file:tst_excelupsert.cpp   -
+ * @description: Stored value and row hash rules of table refresh, update
+ *               plans replayed on a simulated sheet, and timing of plans
+ *               at several change ratios.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#include <QtTest>
+#include "excelupsert.h"
+
+
+// hash of empty row, what a cleared row reads back as
+static quint64 emptyHash(int width)
+{
+    return ExcelUpsert::rowHash(QVariantList(), width);
+}
+
+// rows of single distinct value, hash per row
+static QVector<quint64> hashes(const QList<int> &keys, int width)
+{
+    QVector<quint64> result;
+    foreach(int key, keys)
+    {
+        QVariantList row;
+        for(int c=0; c<width; c++) row << key*100 + c;
+        result.append(ExcelUpsert::rowHash(row, width));
+    }
+    return result;
+}
+
+/* plan is executed on rows of old sheet, excel's cut leaves source empty.
+   Sheet must hold new rows then, and empty rows after them */
+static bool replay(const QVector<quint64> &old_hashes, const QVector<quint64> &new_hashes
+                   , const ExcelUpsert::Plan &plan, int width)
+{
+    const quint64 empty = emptyHash(width);
+    QVector<quint64> sheet = old_hashes;
+    if(sheet.size() < new_hashes.size()) sheet.resize(new_hashes.size());
+    for(int p=old_hashes.size(); p<sheet.size(); p++) sheet[p] = empty;
+
+    foreach(const ExcelUpsert::Move &move, plan.moves)
+    {
+        const QVector<quint64> moved = sheet.mid(move.from, move.count);
+        for(int p=move.from; p<move.from + move.count; p++) sheet[p] = empty;
+        for(int k=0; k<move.count; k++) sheet[move.to + k] = moved[k];
+    }
+    foreach(const ExcelUpsert::Run &run, plan.writes)
+        for(int p=run.first; p<run.first + run.count; p++) sheet[p] = new_hashes[p];
+    foreach(const ExcelUpsert::Run &run, plan.clears)
+        for(int p=run.first; p<run.first + run.count; p++) sheet[p] = empty;
+
+    for(int p=0; p<sheet.size(); p++)
+    {
+        const quint64 expected = p < new_hashes.size() ? new_hashes[p] : empty;
+        if(sheet[p] != expected) return false;
+    }
+    return true;
+}
+
+static int rowsWritten(const ExcelUpsert::Plan &plan)
+{
+    int rows = 0;
+    foreach(const ExcelUpsert::Run &run, plan.writes) rows += run.count;
+    return rows;
+}
+
+// edits, inserts and deletes of ratio of rows, fixed seed
+static QList<int> changed(const QList<int> &keys, double ratio, int *pnext_key)
+{
+    QList<int> result = keys;
+    const int changes = int(keys.count()*ratio);
+    uint seed = 12345;
+    for(int n=0; n<changes && !result.isEmpty(); n++)
+    {
+        seed = seed*1103515245u + 12345u;
+        const int at = int((seed >> 8) % uint(result.count()));
+        switch(n % 3)
+        {
+        case 0: result[at] = (*pnext_key)++; break;
+        case 1: result.insert(at, (*pnext_key)++); break;
+        default: result.removeAt(at); break;
+        }
+    }
+    return result;
+}
+
+class TestExcelUpsert : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void storedValues();
+    void rowHashes();
+    void unchanged();
+    void emptyRegion();
+    void insertDoesNotShift();
+    void deleteDoesNotShift();
+    void truncated();
+    void movedRowDoesNotCutOff();
+    void randomChanges_data();
+    void randomChanges();
+
+    void benchmarkPlan_data();
+    void benchmarkPlan();
+};
+
+void TestExcelUpsert::storedValues()
+{
+    QCOMPARE(ExcelUpsert::storedValue(QString("1.5")), QVariant(1.5));
+    QCOMPARE(ExcelUpsert::storedValue(QString("'007")), QVariant(QString("007")));
+    QCOMPARE(ExcelUpsert::storedValue(QString("true")), QVariant(true));
+    QCOMPARE(ExcelUpsert::storedValue(QString("abc")), QVariant(QString("abc")));
+    QCOMPARE(ExcelUpsert::storedValue(QDate(1900, 1, 1)), QVariant(2.0));
+    QCOMPARE(ExcelUpsert::storedValue(QTime(12, 0)), QVariant(0.5));
+    QCOMPARE(ExcelUpsert::storedValue(42), QVariant(42));
+}
+
+void TestExcelUpsert::rowHashes()
+{
+    QVariantList a, b;
+    a << 1 << QString("x");
+    b << 1.0 << QString("x");
+    QCOMPARE(ExcelUpsert::rowHash(a, 2), ExcelUpsert::rowHash(b, 2));
+
+    // empty text reads back as empty cell, missing cells are empty
+    QVariantList c, d;
+    c << QString("") << QVariant();
+    QCOMPARE(ExcelUpsert::rowHash(c, 2), ExcelUpsert::rowHash(d, 2));
+
+    QVariantList e, f;
+    e << QString("ab") << QString("");
+    f << QString("a") << QString("b");
+    QVERIFY(ExcelUpsert::rowHash(e, 2) != ExcelUpsert::rowHash(f, 2));
+    QVERIFY(ExcelUpsert::rowHash(a, 2) != ExcelUpsert::rowHash(a, 1));
+}
+
+void TestExcelUpsert::unchanged()
+{
+    QList<int> keys;
+    for(int k=0; k<100; k++) keys << k;
+    const QVector<quint64> rows = hashes(keys, 4);
+    const ExcelUpsert::Plan plan = ExcelUpsert::plan(rows, rows, 4, 256);
+    QVERIFY(plan.moves.isEmpty());
+    QVERIFY(plan.writes.isEmpty());
+    QVERIFY(plan.clears.isEmpty());
+    QCOMPARE(plan.rowsUnchanged, 100);
+}
+
+void TestExcelUpsert::emptyRegion()
+{
+    QList<int> keys;
+    for(int k=0; k<10; k++) keys << k;
+    const QVector<quint64> rows = hashes(keys, 3);
+    const ExcelUpsert::Plan plan = ExcelUpsert::plan(QVector<quint64>(), rows, 3, 256);
+    QCOMPARE(plan.writes.count(), 1);
+    QCOMPARE(plan.writes[0].first, 0);
+    QCOMPARE(plan.writes[0].count, 10);
+    QVERIFY(replay(QVector<quint64>(), rows, plan, 3));
+}
+
+void TestExcelUpsert::insertDoesNotShift()
+{
+    QList<int> keys;
+    for(int k=0; k<1000; k++) keys << k;
+    QList<int> inserted = keys;
+    inserted.insert(10, 5000);
+
+    const QVector<quint64> old_rows = hashes(keys, 8);
+    const QVector<quint64> new_rows = hashes(inserted, 8);
+    const ExcelUpsert::Plan plan = ExcelUpsert::plan(old_rows, new_rows, 8, 256);
+    QCOMPARE(rowsWritten(plan), 1);
+    QCOMPARE(plan.moves.count(), 1);
+    QCOMPARE(plan.rowsMoved, 990);
+    QCOMPARE(plan.rowsUnchanged, 10);
+    QVERIFY(replay(old_rows, new_rows, plan, 8));
+}
+
+void TestExcelUpsert::deleteDoesNotShift()
+{
+    QList<int> keys;
+    for(int k=0; k<1000; k++) keys << k;
+    QList<int> deleted = keys;
+    deleted.removeAt(500);
+
+    const QVector<quint64> old_rows = hashes(keys, 8);
+    const QVector<quint64> new_rows = hashes(deleted, 8);
+    const ExcelUpsert::Plan plan = ExcelUpsert::plan(old_rows, new_rows, 8, 256);
+    QCOMPARE(rowsWritten(plan), 0);
+    QCOMPARE(plan.moves.count(), 1);
+    QCOMPARE(plan.rowsMoved, 499);
+    QVERIFY(replay(old_rows, new_rows, plan, 8));
+}
+
+void TestExcelUpsert::truncated()
+{
+    QList<int> keys;
+    for(int k=0; k<100; k++) keys << k;
+    const QVector<quint64> old_rows = hashes(keys, 2);
+    const QVector<quint64> new_rows = hashes(keys.mid(0, 60), 2);
+    const ExcelUpsert::Plan plan = ExcelUpsert::plan(old_rows, new_rows, 2, 256);
+    QVERIFY(plan.writes.isEmpty());
+    QCOMPARE(plan.clears.count(), 1);
+    QCOMPARE(plan.clears[0].first, 60);
+    QCOMPARE(plan.clears[0].count, 40);
+    QVERIFY(replay(old_rows, new_rows, plan, 2));
+}
+
+void TestExcelUpsert::movedRowDoesNotCutOff()
+{
+    // last row moved to top, rows between keep their position
+    QList<int> keys;
+    for(int k=0; k<1000; k++) keys << k;
+    QList<int> moved = keys;
+    moved.prepend(moved.takeLast());
+
+    const QVector<quint64> old_rows = hashes(keys, 8);
+    const QVector<quint64> new_rows = hashes(moved, 8);
+    const ExcelUpsert::Plan plan = ExcelUpsert::plan(old_rows, new_rows, 8, 256);
+    QCOMPARE(rowsWritten(plan), 1);
+    QCOMPARE(plan.rowsMoved, 999);
+    QVERIFY(replay(old_rows, new_rows, plan, 8));
+}
+
+void TestExcelUpsert::randomChanges_data()
+{
+    QTest::addColumn<double>("ratio");
+    QTest::newRow("1%") << 0.01;
+    QTest::newRow("10%") << 0.1;
+    QTest::newRow("50%") << 0.5;
+    QTest::newRow("100%") << 1.0;
+}
+
+void TestExcelUpsert::randomChanges()
+{
+    QFETCH(double, ratio);
+    QList<int> keys;
+    for(int k=0; k<2000; k++) keys << k;
+    int next_key = 100000;
+    const QList<int> new_keys = changed(keys, ratio, &next_key);
+
+    const QVector<quint64> old_rows = hashes(keys, 6);
+    const QVector<quint64> new_rows = hashes(new_keys, 6);
+    const int costs[] = {0, 16, 256, 100000};
+    for(int i=0; i<4; i++)
+    {
+        const ExcelUpsert::Plan plan = ExcelUpsert::plan(old_rows, new_rows, 6, costs[i]);
+        QVERIFY(replay(old_rows, new_rows, plan, 6));
+    }
+}
+
+void TestExcelUpsert::benchmarkPlan_data()
+{
+    QTest::addColumn<double>("ratio");
+    QTest::newRow("0%") << 0.0;
+    QTest::newRow("1%") << 0.01;
+    QTest::newRow("10%") << 0.1;
+    QTest::newRow("50%") << 0.5;
+    QTest::newRow("100%") << 1.0;
+}
+
+// hashing of new rows as stored and plan against 20000 old rows
+void TestExcelUpsert::benchmarkPlan()
+{
+    QFETCH(double, ratio);
+    const int width = 10;
+    QList<int> keys;
+    for(int k=0; k<20000; k++) keys << k;
+    int next_key = 1000000;
+    const QList<int> new_keys = changed(keys, ratio, &next_key);
+    const QVector<quint64> old_rows = hashes(keys, width);
+
+    QList<QVariantList> rows;
+    foreach(int key, new_keys)
+    {
+        QVariantList row;
+        for(int c=0; c<width; c++) row << QString::number(key*100 + c);
+        rows.append(row);
+    }
+
+    ExcelUpsert::Plan plan;
+    QBENCHMARK {
+        QVector<quint64> new_rows(rows.count());
+        for(int r=0; r<rows.count(); r++)
+        {
+            QVariantList stored;
+            foreach(const QVariant &data, rows[r]) stored.append(ExcelUpsert::storedValue(data));
+            new_rows[r] = ExcelUpsert::rowHash(stored, width);
+        }
+        plan = ExcelUpsert::plan(old_rows, new_rows, width, 256);
+    }
+    QVERIFY(rowsWritten(plan) <= new_keys.count());
+}
+
+QTEST_APPLESS_MAIN(TestExcelUpsert)
+
+#include "tst_excelupsert.moc"
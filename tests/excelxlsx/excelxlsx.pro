@@ -0,0 +1,21 @@
+# xlsx writer needs QtGui for fonts and colors, reader QtCore only, no ActiveX
+QT += testlib gui
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_excelxlsx
+TEMPLATE = app
+
+INCLUDEPATH += $$PWD/../../src
+
+HEADERS += \
+    $$PWD/../../src/exceladdress.h \
+    $$PWD/../../src/excelxlsxwriter.h \
+    $$PWD/../../src/excelxlsxreader.h
+
+SOURCES += \
+    $$PWD/../../src/exceladdress.cpp \
+    $$PWD/../../src/excelxlsxwriter.cpp \
+    $$PWD/../../src/excelxlsxreader.cpp \
+    $$PWD/tst_excelxlsx.cpp
@@ -0,0 +1,321 @@
+/**
+ * @file:tst_excelxlsx.cpp   -
+ * @description: Streaming xlsx writer: row window and late writes, writer
+ *               output read back by the xlsx reader, cells per second of
+ *               writing and megabytes per second of reading.
+ * @project: BENCH OnSemiconductor
+ *
+ */
+
+
+#include <QtTest>
+#include <QDir>
+#include <QFile>
+#include "excelxlsxwriter.h"
+#include "excelxlsxreader.h"
+
+
+// file in temp dir, removed on destruction
+class TempXlsx
+{
+public:
+    explicit TempXlsx(const QString &name)
+        : m_path(QDir::temp().filePath(QString("tst_excelxlsx_%1.xlsx").arg(name))) {QFile::remove(m_path);}
+    ~TempXlsx() {QFile::remove(m_path);}
+    QString path() const {return m_path;}
+
+private:
+    QString m_path;
+};
+
+// row of numbers and texts, every third cell a text
+static QVariantList makeRow(int row, int width)
+{
+    QVariantList result;
+    for(int c=0; c<width; c++)
+    {
+        if(c % 3 == 2) result << QString("item %1").arg((row*width + c) % 500);
+        else result << row*0.5 + c;
+    }
+    return result;
+}
+
+// rows of rect as readRange returns them
+static QVariantList readBack(ExcelXlsxReader *preader, const QString &range)
+{
+    QVariantList rows;
+    if(!preader->readRange(range, &rows)) qWarning("%s", qPrintable(preader->errorString()));
+    return rows;
+}
+
+class TestExcelXlsx : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void writerSaves();
+    void columnFillIsLate();
+    void roundTripNumbers();
+    void roundTripDates();
+    void roundTripStrings();
+    void roundTripSparseRows();
+    void roundTripWholeColumns();
+
+    void benchmarkWriter_data();
+    void benchmarkWriter();
+    void benchmarkReader_data();
+    void benchmarkReader();
+};
+
+void TestExcelXlsx::writerSaves()
+{
+    TempXlsx file("saves");
+    ExcelXlsxWriter writer(file.path());
+    QVERIFY(writer.open());
+    QVERIFY(writer.addSheet("Data"));
+    QSet<QString> texts;
+    for(int r=0; r<100; r++)
+    {
+        const QVariantList row = makeRow(r, 6);
+        foreach(const QVariant &data, row)
+            if(data.type() == QVariant::String) texts.insert(data.toString());
+        QVERIFY(writer.writeBlock(QRect(0, r, 6, 1), row));
+    }
+    QVERIFY(writer.write(101, 1, QDate(2020, 5, 17)));
+    QVERIFY(writer.save());
+    QVERIFY(QFile::exists(file.path()));
+    QCOMPARE(writer.cellsWritten(), qint64(601));
+    QCOMPARE(writer.lateWrites(), qint64(0));
+    // equal texts share one entry
+    QCOMPARE(writer.sharedStrings(), texts.count());
+}
+
+void TestExcelXlsx::columnFillIsLate()
+{
+    // second column starts above the window, rows are on disk already
+    TempXlsx file("late");
+    ExcelXlsxWriter writer(file.path());
+    QVERIFY(writer.open());
+    writer.setRowWindow(16);
+    QVariantList column;
+    for(int r=0; r<100; r++) column << r;
+    QVERIFY(writer.writeBlock(QRect(0, 0, 1, 100), column));
+    QVERIFY(!writer.writeBlock(QRect(1, 0, 1, 100), column));
+    QCOMPARE(writer.lateWrites(), qint64(100));
+    QVERIFY(writer.writeBlock(QRect(1, 90, 1, 10), column.mid(90)));
+}
+
+void TestExcelXlsx::roundTripNumbers()
+{
+    TempXlsx file("numbers");
+    ExcelXlsxWriter writer(file.path());
+    QVERIFY(writer.open());
+    QVariantList values;
+    values << 42 << 1.0/3 << -2.5e-300 << 1e15 << 123456789.123 << qint64(1) << 49 << true << false;
+    QVERIFY(writer.writeBlock(QRect(0, 0, 3, 3), values));
+    QVERIFY(writer.save());
+
+    ExcelXlsxReader reader(file.path());
+    QVERIFY(reader.open());
+    const QVariantList rows = readBack(&reader, "A1:C3");
+    QCOMPARE(rows.count(), 3);
+    for(int i=0; i<values.count(); i++)
+    {
+        const QVariant data = rows[i / 3].toList().value(i % 3);
+        // integers come back as double like from Excel
+        if(values[i].type() == QVariant::Bool) QCOMPARE(data, values[i]);
+        else QCOMPARE(data, QVariant(values[i].toDouble()));
+    }
+    QVERIFY(reader.xmlBytes() > 0);
+}
+
+void TestExcelXlsx::roundTripDates()
+{
+    TempXlsx file("dates");
+    ExcelXlsxWriter writer(file.path());
+    QVERIFY(writer.open());
+    const QDate date(2020, 5, 17);
+    const QDateTime time(QDate(1999, 12, 31), QTime(23, 59, 59, 500));
+    QVERIFY(writer.write(1, 1, date));
+    QVERIFY(writer.write(1, 2, time));
+    QVERIFY(writer.write(1, 3, 43968.0));
+    QVERIFY(writer.save());
+
+    ExcelXlsxReader reader(file.path());
+    QVERIFY(reader.open());
+    const QVariantList row = readBack(&reader, "A1:C1").value(0).toList();
+    QCOMPARE(row.count(), 3);
+    QCOMPARE(row[0], QVariant(QDateTime(date, QTime(0, 0))));
+    QCOMPARE(row[1], QVariant(time));
+    // same serial without date format stays a number
+    QCOMPARE(row[2], QVariant(43968.0));
+}
+
+void TestExcelXlsx::roundTripStrings()
+{
+    TempXlsx file("strings");
+    ExcelXlsxWriter writer(file.path());
+    QVERIFY(writer.open());
+    QStringList texts;
+    texts << "plain" << "<a & \"b\">" << "  lead and trail  " << QString::fromUtf8("\xc3\xa9t\xc3\xa9 \xe2\x82\xac")
+          << "plain" << "line\nbreak";
+    QVariantList values;
+    foreach(const QString &text, texts) values << text;
+    values << QString("");
+    QVERIFY(writer.writeBlock(QRect(0, 0, 1, values.count()), values));
+    QVERIFY(writer.save());
+    QCOMPARE(writer.sharedStrings(), texts.count() - 1);
+
+    ExcelXlsxReader reader(file.path());
+    QVERIFY(reader.open());
+    const QVariantList rows = readBack(&reader, QString("A1:A%1").arg(values.count()));
+    QCOMPARE(rows.count(), values.count());
+    for(int i=0; i<texts.count(); i++)
+        QCOMPARE(rows[i].toList().value(0), QVariant(texts[i]));
+    // empty text clears cell
+    QVERIFY(!rows.last().toList().value(0).isValid());
+}
+
+void TestExcelXlsx::roundTripSparseRows()
+{
+    // rows far apart cross the row window, gaps have no row elements
+    TempXlsx file("sparse");
+    ExcelXlsxWriter writer(file.path());
+    QVERIFY(writer.open());
+    QVERIFY(writer.addSheet("Sparse"));
+    QVERIFY(writer.write(1, 1, 1));
+    QVERIFY(writer.write(5, 5, QString("e5")));
+    QVERIFY(writer.write(3000, 2, 3000));
+    QVERIFY(writer.write(3000, 4, QString("d3000")));
+    QVERIFY(writer.save());
+
+    ExcelXlsxReader reader(file.path());
+    QVERIFY(reader.open());
+    QVERIFY(reader.setCurrentSheet("Sparse"));
+    QCOMPARE(reader.usedRange(), QString("A1:E3000"));
+    const QVariantList rows = readBack(&reader, "A1:E3000");
+    QCOMPARE(rows.count(), 3000);
+    int filled = 0;
+    foreach(const QVariant &row, rows)
+        foreach(const QVariant &data, row.toList())
+            if(data.isValid()) filled++;
+    QCOMPARE(filled, 4);
+    QCOMPARE(rows[0].toList()[0], QVariant(1.0));
+    QCOMPARE(rows[4].toList()[4], QVariant(QString("e5")));
+    QCOMPARE(rows[2999].toList()[1], QVariant(3000.0));
+    QCOMPARE(rows[2999].toList()[3], QVariant(QString("d3000")));
+
+    // range inside a gap
+    const QVariantList gap = readBack(&reader, "B100:C101");
+    QCOMPARE(gap.count(), 2);
+    QCOMPARE(gap[0].toList().count(), 2);
+    QVERIFY(!gap[1].toList()[1].isValid());
+
+    QVariant data;
+    QVERIFY(reader.read(3000, 4, data));
+    QCOMPARE(data, QVariant(QString("d3000")));
+}
+
+void TestExcelXlsx::roundTripWholeColumns()
+{
+    TempXlsx file("columns");
+    ExcelXlsxWriter writer(file.path());
+    QVERIFY(writer.open());
+    QVERIFY(writer.addSheet("Data"));
+    for(int r=0; r<50; r++)
+        QVERIFY(writer.writeBlock(QRect(0, r, 4, 1), makeRow(r, 4)));
+    QVERIFY(writer.save());
+
+    ExcelXlsxReader reader(file.path());
+    QVERIFY(reader.open());
+    // whole columns are cut to used range A1:D50
+    const QVariantList rows = readBack(&reader, "B:C");
+    QCOMPARE(rows.count(), 50);
+    for(int r=0; r<50; r++)
+    {
+        const QVariantList expected = makeRow(r, 4).mid(1, 2);
+        const QVariantList row = rows[r].toList();
+        QCOMPARE(row.count(), 2);
+        QCOMPARE(row[0], QVariant(expected[0].toDouble()));
+        QCOMPARE(row[1], expected[1]);
+    }
+
+    const QVariantList qualified = readBack(&reader, "Data!D:D");
+    QCOMPARE(qualified.count(), 50);
+    QCOMPARE(qualified[49].toList()[0], QVariant(makeRow(49, 4)[3].toDouble()));
+
+    // whole rows likewise
+    const QVariantList whole_rows = readBack(&reader, "2:3");
+    QCOMPARE(whole_rows.count(), 2);
+    QCOMPARE(whole_rows[0].toList().count(), 4);
+
+    // columns right of used range are empty
+    QVariantList none;
+    QVERIFY(reader.readRange("F:G", &none));
+    QVERIFY(none.isEmpty());
+}
+
+void TestExcelXlsx::benchmarkWriter_data()
+{
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<int>("width");
+    QTest::newRow("20000x10") << 20000 << 10;
+    QTest::newRow("2000x100") << 2000 << 100;
+}
+
+// rows written one by one and saved, cells per second printed
+void TestExcelXlsx::benchmarkWriter()
+{
+    QFETCH(int, rows);
+    QFETCH(int, width);
+    QList<QVariantList> data;
+    for(int r=0; r<rows; r++) data.append(makeRow(r, width));
+
+    TempXlsx file("bench");
+    double cells_per_second = 0;
+    QBENCHMARK {
+        ExcelXlsxWriter writer(file.path());
+        writer.open();
+        for(int r=0; r<rows; r++) writer.writeBlock(QRect(0, r, width, 1), data[r]);
+        QVERIFY(writer.save());
+        cells_per_second = writer.cellsPerSecond();
+    }
+    qDebug("%.0f cells/s", cells_per_second);
+    QVERIFY(cells_per_second > 0);
+}
+
+void TestExcelXlsx::benchmarkReader_data()
+{
+    QTest::addColumn<QString>("range");
+    QTest::newRow("all") << QString("A1:J50000");
+    QTest::newRow("last rows") << QString("A49901:J50000");
+    QTest::newRow("one column") << QString("C:C");
+}
+
+// 50000 rows of 10 cells, megabytes of sheet xml per second printed
+void TestExcelXlsx::benchmarkReader()
+{
+    QFETCH(QString, range);
+    TempXlsx file("read");
+    {
+        ExcelXlsxWriter writer(file.path());
+        QVERIFY(writer.open());
+        for(int r=0; r<50000; r++) writer.writeBlock(QRect(0, r, 10, 1), makeRow(r, 10));
+        QVERIFY(writer.save());
+    }
+
+    ExcelXlsxReader reader(file.path());
+    QVERIFY(reader.open());
+    QVariantList rows;
+    double megabytes_per_second = 0;
+    QBENCHMARK {
+        QVERIFY(reader.readRange(range, &rows));
+        megabytes_per_second = reader.megabytesPerSecond();
+    }
+    qDebug("%.1f MB/s", megabytes_per_second);
+    QVERIFY(!rows.isEmpty());
+}
+
+QTEST_APPLESS_MAIN(TestExcelXlsx)
+
+#include "tst_excelxlsx.moc"
@@ -0,0 +1,7 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    exceladdress \
+    exceldecimate \
+    excelupsert \
+    excelxlsx